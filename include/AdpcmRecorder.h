@@ -1,14 +1,24 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
-#include <mutex>
+#include <vector>
 
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_partition.h"
+#include "Mic.h"
+#include "sensorhub_core/CapturePlanner.h"
+#include "sensorhub_core/FlacLossless.h"
+#include "sensorhub_core/HistoryRing.h"
 #include "sensorhub_core/ImaAdpcm.h"
+#include "sensorhub_core/PolyphaseDecimator.h"
+#include "sensorhub_core/RecordingSpool.h"
+#include "sensorhub_core/SignalConditioner.h"
+#include "sensorhub_core/SpscEventRing.h"
 
 namespace Mic {
 
@@ -20,26 +30,181 @@ constexpr uint32_t CeilBlocks(uint32_t seconds, uint32_t sampleRateHz,
 }
 
 struct AdpcmConfig {
-    static constexpr uint32_t SampleRateHz = 32000;
-    static constexpr uint32_t PreRollSeconds = 5;
-    static constexpr uint32_t PostRollSeconds = 10;
-    static constexpr uint32_t JitterSlackSeconds = 3;
-
-    static constexpr uint16_t BlockAlign = 256;
-    static constexpr uint16_t SamplesPerBlock = 505;
-
-    static constexpr uint32_t PreRollBlocks =
-        detail::CeilBlocks(PreRollSeconds, SampleRateHz, SamplesPerBlock);
-    static constexpr uint32_t PostRollBlocks =
-        detail::CeilBlocks(PostRollSeconds, SampleRateHz, SamplesPerBlock);
-    static constexpr uint32_t JitterSlackBlocks =
-        detail::CeilBlocks(JitterSlackSeconds, SampleRateHz, SamplesPerBlock);
-    static constexpr uint32_t RingCapacityBlocks =
-        PreRollBlocks + JitterSlackBlocks;
-    static constexpr uint32_t PcmBytesPerBlock =
-        SamplesPerBlock * sizeof(int16_t);
+    // I2S always captures at this rate; recordings may be decimated from it.
+    static constexpr uint32_t CaptureRateHz = 32000;
+    // Older pre-roll is kept at this rate; only the newest FullRateSeconds
+    // of it stay at the recording rate.
+    static constexpr uint32_t HistoryRateHz = 8000;
+    static constexpr uint32_t FullRateSeconds = 2;
+    static constexpr uint32_t ReleaseSeconds = 3;
+
+    // Device config values; 0 selects the default.
+    static constexpr uint32_t DefaultPreRollSeconds = 16;
+    static constexpr uint32_t PreRollSecondsLimit = 120;
+    static constexpr uint32_t DefaultPostRollSeconds = 2;
+    static constexpr uint32_t PostRollSecondsLimit = 60;
+    static constexpr uint32_t DefaultJitterSlackSeconds = 2;
+    static constexpr uint32_t JitterSlackSecondsLimit = 30;
+    static constexpr uint32_t DefaultMaxRecordingSeconds = 60;
+    static constexpr uint32_t MaxRecordingSecondsLimit = 600;
+    static constexpr uint32_t DefaultMemoryBudgetKb = 128;
+
+    // Internal heap left to the rest of the firmware (TLS, HTTP, tasks)
+    // whatever the budget says.
+    static constexpr uint32_t HeapReserveBytes = 64 * 1024;
+
+    // IMA ADPCM block sizes from the device config. Every block costs a
+    // 4-byte header, a ring slot and an HTTP chunk, so larger blocks cut
+    // that overhead, at the price of a larger PCM buffer and of events
+    // that start and end on coarser boundaries.
+    static constexpr uint16_t DefaultBlockAlign = 256;
+    static constexpr uint16_t MaxBlockAlign = 2048;
+
+    // A lossless block is a 16-bit length and one FLAC subframe, in a slot
+    // sized for the subframe's worst case. Its length does not follow the
+    // ADPCM block size.
+    static constexpr uint16_t FlacSamplesPerBlock = 505;
+    static constexpr uint16_t FlacBlockBytes = 1016;
+
+    // ADPCM recordings are DC blocked above DcCutoffHz and get up to
+    // AgcMaxGainDb of gain, which only changes between events. The level
+    // it is set from falls back over AgcReleaseSeconds after loud audio.
+    static constexpr double DcCutoffHz = 20.0;
+    static constexpr int AgcMaxGainDb = 24;
+    static constexpr int32_t AgcTargetPeak = 2048;
+    static constexpr uint32_t AgcReleaseSeconds = 30;
+
+    // Feature-only recording keeps no audio, only a descriptor per event.
+    // Descriptors wait in RAM for the network, this many at most.
+    static constexpr uint32_t DescriptorQueueEvents = 16;
+
+    static constexpr uint16_t MaxBlockBytes = MaxBlockAlign;
+    static constexpr uint32_t MaxSamplesPerBlock =
+        sensorhub::core::ImaSamplesPerBlock(MaxBlockAlign);
 };
 
+static_assert(2 + sensorhub::core::FlacMaxSubframeBytes(
+                      AdpcmConfig::FlacSamplesPerBlock) <=
+                  AdpcmConfig::FlacBlockBytes,
+              "FLAC slot too small for a verbatim subframe");
+static_assert(AdpcmConfig::FlacBlockBytes <= AdpcmConfig::MaxBlockBytes);
+
+// Recording sample rate, codec and block size from the device config. The
+// rate is 32, 16 or 8 kHz, anything else falls back to the capture rate.
+// Lower rates cut the bytes per second, and so the ring for a given
+// pre-roll, by the decimation factor. Lossless blocks take four times the
+// ring space of ADPCM ones, however well they compress. The ADPCM block
+// size is 256, 512, 1024 or 2048 bytes, anything else falls back to 256.
+class AdpcmFormat {
+   public:
+    explicit AdpcmFormat(uint32_t requestedRateHz,
+                         RecordingCodec codec = RecordingCodec::ImaAdpcm,
+                         uint32_t requestedBlockAlign = 0)
+        : m_codec(codec == RecordingCodec::Flac ? codec
+                                                : RecordingCodec::ImaAdpcm) {
+        for (uint32_t factor : {2u, 4u}) {
+            if (requestedRateHz == AdpcmConfig::CaptureRateHz / factor) {
+                m_decimation = factor;
+            }
+        }
+        for (uint16_t align = AdpcmConfig::DefaultBlockAlign;
+             align <= AdpcmConfig::MaxBlockAlign;
+             align *= 2) {
+            if (requestedBlockAlign == align) {
+                m_blockAlign = align;
+            }
+        }
+    }
+
+    RecordingCodec Codec() const { return m_codec; }
+
+    // Bytes of one IMA ADPCM block, for the recording and its history.
+    uint16_t BlockAlign() const { return m_blockAlign; }
+
+    // Bytes of one ring slot.
+    uint16_t BlockBytes() const {
+        return m_codec == RecordingCodec::Flac ? AdpcmConfig::FlacBlockBytes
+                                               : m_blockAlign;
+    }
+
+    // Samples of one block at the recording rate.
+    uint32_t SamplesPerBlock() const {
+        return m_codec == RecordingCodec::Flac
+                   ? AdpcmConfig::FlacSamplesPerBlock
+                   : static_cast<uint32_t>(
+                         sensorhub::core::ImaSamplesPerBlock(m_blockAlign));
+    }
+
+    uint32_t SampleRateHz() const {
+        return AdpcmConfig::CaptureRateHz / m_decimation;
+    }
+
+    uint32_t Decimation() const { return m_decimation; }
+
+    // Captured samples behind one encoded block.
+    uint32_t CaptureSamplesPerBlock() const {
+        return SamplesPerBlock() * m_decimation;
+    }
+
+    uint32_t Blocks(uint32_t seconds) const {
+        return detail::CeilBlocks(seconds, SampleRateHz(), SamplesPerBlock());
+    }
+
+    uint32_t BlocksForMs(uint32_t ms) const {
+        return detail::CeilBlocks(ms,
+                                  SampleRateHz(),
+                                  SamplesPerBlock() * 1000);
+    }
+
+    // ADPCM recordings above HistoryRateHz keep the older pre-roll in a
+    // separate lower-rate tier; otherwise the whole pre-roll is in the
+    // ring. Lossless recordings never get a lossy history.
+    bool HasHistory() const {
+        return m_codec == RecordingCodec::ImaAdpcm &&
+               SampleRateHz() > AdpcmConfig::HistoryRateHz;
+    }
+
+    // Recording-rate blocks behind one history block, which has as many
+    // samples as a recording block.
+    uint32_t HistoryGroup() const {
+        return SampleRateHz() / AdpcmConfig::HistoryRateHz;
+    }
+
+    // Sizes the ring and the history tier for this rate. The history also
+    // covers the full-rate pre-roll, which it overlaps until an event cuts
+    // it off.
+    sensorhub::core::CapturePlanner Planner() const {
+        const sensorhub::core::BlockTier history =
+            HasHistory() ? sensorhub::core::BlockTier{
+                               AdpcmConfig::HistoryRateHz,
+                               SamplesPerBlock()}
+                         : sensorhub::core::BlockTier{};
+        return sensorhub::core::CapturePlanner(
+            {SampleRateHz(), SamplesPerBlock()},
+            history,
+            BlockBytes());
+    }
+
+   private:
+    RecordingCodec m_codec;
+    uint32_t m_decimation = 1;
+    uint16_t m_blockAlign = AdpcmConfig::DefaultBlockAlign;
+};
+
+// Length of the FLAC subframe in a lossless block.
+inline uint16_t FlacSubframeBytes(const uint8_t* block) {
+    uint16_t bytes = 0;
+    std::memcpy(&bytes, block, sizeof(bytes));
+    return bytes;
+}
+
+// An IMA ADPCM block's fourth byte is reserved and coded as 0. In the ring
+// and the spool it flags a block that goes as part of a silence run, and
+// must be cleared again before the block itself is uploaded.
+inline void MarkQuietBlock(uint8_t* block) { block[3] = 1; }
+
+inline bool IsQuietBlock(const uint8_t* block) { return block[3] != 0; }
+
 struct __attribute__((packed)) WavHeaderImaAdpcm {
     uint8_t RiffTag[4] = {'R', 'I', 'F', 'F'};
     uint32_t FileLength;
@@ -51,10 +216,10 @@ struct __attribute__((packed)) WavHeaderImaAdpcm {
     uint16_t ChannelCount = 1;
     uint32_t SampleRate;
     uint32_t BytesPerSecond;
-    uint16_t BlockAlign = AdpcmConfig::BlockAlign;
+    uint16_t BlockAlign;
     uint16_t BitsPerSample = 4;
     uint16_t CbSize = 2;
-    uint16_t SamplesPerBlock = AdpcmConfig::SamplesPerBlock;
+    uint16_t SamplesPerBlock;
 
     uint8_t FactTag[4] = {'f', 'a', 'c', 't'};
     uint32_t FactChunkSize = 4;
@@ -63,15 +228,26 @@ struct __attribute__((packed)) WavHeaderImaAdpcm {
     uint8_t DataTag[4] = {'d', 'a', 't', 'a'};
     uint32_t DataLength;
 
-    WavHeaderImaAdpcm(uint32_t sampleRate, uint32_t totalBlocks) {
+    WavHeaderImaAdpcm(uint32_t sampleRate, uint16_t blockAlign,
+                      uint32_t totalBlocks) {
         SampleRate = sampleRate;
-        BytesPerSecond = (sampleRate * AdpcmConfig::BlockAlign) /
-                         AdpcmConfig::SamplesPerBlock;
-        NumSamples = totalBlocks * AdpcmConfig::SamplesPerBlock;
-        DataLength = totalBlocks * AdpcmConfig::BlockAlign;
+        BlockAlign = blockAlign;
+        SamplesPerBlock = static_cast<uint16_t>(
+            sensorhub::core::ImaSamplesPerBlock(blockAlign));
+        BytesPerSecond = (sampleRate * BlockAlign) / SamplesPerBlock;
+        NumSamples = totalBlocks * SamplesPerBlock;
+        DataLength = totalBlocks * BlockAlign;
         FileLength =
             static_cast<uint32_t>(sizeof(WavHeaderImaAdpcm)) - 8 + DataLength;
     }
+
+    // Header for a recording streamed before its length is known.
+    WavHeaderImaAdpcm(uint32_t sampleRate, uint16_t blockAlign)
+        : WavHeaderImaAdpcm(sampleRate, blockAlign, 0) {
+        NumSamples = sensorhub::core::kImaWavStreamingLength;
+        DataLength = sensorhub::core::kImaWavStreamingLength;
+        FileLength = sensorhub::core::kImaWavStreamingLength;
+    }
 };
 
 static_assert(sizeof(WavHeaderImaAdpcm) == 60,
@@ -79,14 +255,20 @@ static_assert(sizeof(WavHeaderImaAdpcm) == 60,
 
 class AdpcmEncoderState {
    public:
-    AdpcmEncoderState() {
-        m_pcm = static_cast<int16_t*>(
-            heap_caps_malloc(AdpcmConfig::PcmBytesPerBlock,
-                             MALLOC_CAP_DMA | MALLOC_CAP_8BIT));
+    explicit AdpcmEncoderState(const AdpcmFormat& format)
+        : m_codec(format.Codec()),
+          m_blockAlign(format.BlockAlign()),
+          m_samples(format.CaptureSamplesPerBlock()),
+          m_decimator(static_cast<int>(format.Decimation())),
+          m_conditioner(format.SampleRateHz(),
+                        AdpcmConfig::DcCutoffHz,
+                        AgcFor(format)) {
+        m_pcm = static_cast<int16_t*>(heap_caps_malloc(
+            PcmBufferBytes(), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
         if (m_pcm == nullptr) {
             ESP_LOGE("AdpcmEnc",
                      "PCM scratch alloc failed (%u bytes)",
-                     (unsigned)AdpcmConfig::PcmBytesPerBlock);
+                     (unsigned)PcmBufferBytes());
             std::abort();
         }
     }
@@ -96,136 +278,204 @@ class AdpcmEncoderState {
     AdpcmEncoderState(const AdpcmEncoderState&) = delete;
     AdpcmEncoderState& operator=(const AdpcmEncoderState&) = delete;
 
+    // Captured PCM for one block, at the capture rate, rounded to 16 bits.
+    // I2S reads into a buffer of its own, so this one needs no DMA.
     int16_t* PcmBuffer() { return m_pcm; }
 
-    size_t PcmBufferBytes() const { return AdpcmConfig::PcmBytesPerBlock; }
+    uint32_t PcmSamples() const { return m_samples; }
 
-    bool Encode(uint8_t* outBlock) {
-        return m_encoder.EncodeWavBlock(m_pcm,
-                                        AdpcmConfig::SamplesPerBlock,
-                                        outBlock);
-    }
-
-   private:
-    sensorhub::core::ImaAdpcmEncoder m_encoder;
-    int16_t* m_pcm = nullptr;
-};
+    size_t PcmBufferBytes() const { return m_samples * sizeof(int16_t); }
 
-class AdpcmRing {
-   public:
-    enum class State : uint8_t { Idle, Recording, PostCaptureDrain };
+    // Samples the IMA ADPCM encoder looks ahead, 0 for the greedy one.
+    // Deeper searches cost several times the greedy encoding time.
+    void SetSearchDepth(uint32_t depth) {
+        m_encoder.SetSearchDepth(static_cast<int>(std::min<uint32_t>(
+            depth, sensorhub::core::kImaMaxSearchDepth)));
+    }
 
-    explicit AdpcmRing(uint8_t* backing) : m_buf(backing) {}
+    int SearchDepth() const { return m_encoder.SearchDepth(); }
 
-    ~AdpcmRing() = default;
+    // Gain in dB applied to ADPCM blocks since the last SettleGain(); a
+    // decoder divides by it to get the captured level back. Lossless
+    // blocks are coded as captured and always have 0.
+    int GainDb() const { return m_conditioner.Agc().GainDb(); }
 
-    AdpcmRing(const AdpcmRing&) = delete;
-    AdpcmRing& operator=(const AdpcmRing&) = delete;
+    // Picks the gain for the blocks from here on. Call it only where no
+    // recording spans the change.
+    int SettleGain() {
+        return m_codec == RecordingCodec::Flac
+                   ? 0
+                   : m_conditioner.Agc().Settle();
+    }
 
-    State CurrentState() const {
-        return m_state.load(std::memory_order_acquire);
+    // Decimates the captured PCM in place and encodes it into a block of
+    // the format's BlockBytes(). ADPCM blocks are DC blocked and scaled by
+    // GainDb() first. The block as coded stays at the front of
+    // PcmBuffer().
+    bool Encode(uint8_t* outBlock) {
+        const uint32_t samples = m_decimator.Process(m_pcm, m_samples, m_pcm);
+        if (m_codec == RecordingCodec::Flac) {
+            const uint16_t bytes = static_cast<uint16_t>(
+                sensorhub::core::EncodeFlacSubframe(m_pcm,
+                                                    samples,
+                                                    outBlock + 2));
+            std::memcpy(outBlock, &bytes, sizeof(bytes));
+            return true;
+        }
+        m_conditioner.Process(m_pcm, samples);
+        return m_encoder.EncodeWavBlock(m_pcm, samples, outBlock, m_blockAlign);
     }
 
-    uint32_t PostRollProduced() const {
-        return m_postRollProduced.load(std::memory_order_acquire);
+   private:
+    static sensorhub::core::AgcConfig AgcFor(const AdpcmFormat& format) {
+        sensorhub::core::AgcConfig config;
+        config.maxGainDb = AdpcmConfig::AgcMaxGainDb;
+        config.targetPeak = AdpcmConfig::AgcTargetPeak;
+        config.releaseBlocks = format.Blocks(AdpcmConfig::AgcReleaseSeconds);
+        return config;
     }
 
-    uint32_t Size() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        return m_count;
+    const RecordingCodec m_codec;
+    const uint16_t m_blockAlign;
+    const uint32_t m_samples;
+    sensorhub::core::PolyphaseDecimator m_decimator;
+    sensorhub::core::SignalConditioner m_conditioner;
+    sensorhub::core::ImaAdpcmEncoder m_encoder;
+    int16_t* m_pcm = nullptr;
+};
+
+// Lower-rate tier of the pre-roll. Each block of recording-rate PCM is
+// decimated to HistoryRateHz while no event is capturing, and every
+// HistoryGroup() blocks make one ADPCM block in a HistoryRing.
+class AdpcmHistory {
+   public:
+    AdpcmHistory(const AdpcmFormat& format, uint8_t* backing,
+                 uint32_t capacityBlocks)
+        : m_group(format.HistoryGroup()),
+          m_blockAlign(format.BlockAlign()),
+          m_decimator(static_cast<int>(m_group)),
+          m_ring(backing, m_blockAlign, capacityBlocks),
+          m_pcm(format.SamplesPerBlock()) {}
+
+    sensorhub::core::HistoryRing& Ring() { return m_ring; }
+
+    // Producer. Drops the history and the block being filled.
+    void Restart() {
+        m_ring.Restart();
+        m_decimator.Reset();
+        m_filled = 0;
+        m_phase = 0;
     }
 
-    void PushOverwrite(const uint8_t* block) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_state.load(std::memory_order_relaxed) != State::Idle) {
+    // Producer. Adds one block of recording-rate PCM.
+    void Add(const int16_t* pcm) {
+        if (m_ring.Frozen()) {
+            m_stale = true;
             return;
         }
-        WriteBlockLocked(block);
-        if (m_count < AdpcmConfig::PreRollBlocks) {
-            ++m_count;
-        } else {
-            m_tail = (m_tail + 1) % AdpcmConfig::RingCapacityBlocks;
+        if (m_stale) {
+            Restart();
+            m_stale = false;
         }
-    }
-
-    bool PushPreserve(const uint8_t* block) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_state.load(std::memory_order_relaxed) != State::Recording) {
-            return false;
+        m_filled += m_decimator.Process(pcm,
+                                        static_cast<uint32_t>(m_pcm.size()),
+                                        m_pcm.data() + m_filled);
+        if (++m_phase < m_group) {
+            return;
         }
-        if (m_count >= AdpcmConfig::RingCapacityBlocks) {
-            ++m_droppedDuringRecording;
-            return false;
+        uint8_t* slot = m_ring.Reserve();
+        if (slot != nullptr &&
+            m_encoder.EncodeWavBlock(m_pcm.data(),
+                                     m_filled,
+                                     slot,
+                                     m_blockAlign)) {
+            m_ring.Commit();
         }
-        WriteBlockLocked(block);
-        ++m_count;
-        m_postRollProduced.fetch_add(1, std::memory_order_release);
-        return true;
+        m_filled = 0;
+        m_phase = 0;
     }
 
-    uint32_t DroppedDuringRecording() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        return m_droppedDuringRecording;
+    // Producer. Freezes the history that ends where a full-rate pre-roll
+    // of `preRoll` blocks, the newest of which was just added, begins.
+    bool Freeze(uint32_t event, uint32_t preRoll) {
+        sensorhub::core::HistorySplit split;
+        return sensorhub::core::SplitHistory(preRoll,
+                                             m_phase,
+                                             m_group,
+                                             split) &&
+               m_ring.Freeze(event, split);
     }
 
-    bool Pop(uint8_t* outBlock) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_count == 0) {
-            return false;
-        }
-        std::memcpy(outBlock,
-                    m_buf + m_tail * AdpcmConfig::BlockAlign,
-                    AdpcmConfig::BlockAlign);
-        m_tail = (m_tail + 1) % AdpcmConfig::RingCapacityBlocks;
-        --m_count;
-        return true;
-    }
-
-    uint32_t BeginRecording() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_state.load(std::memory_order_relaxed) != State::Idle) {
-            return 0;
-        }
-        const uint32_t preRoll = m_count;
-        m_droppedDuringRecording = 0;
-        m_postRollProduced.store(0, std::memory_order_release);
-        m_state.store(State::Recording, std::memory_order_release);
-        return preRoll;
+   private:
+    const uint32_t m_group;
+    const uint16_t m_blockAlign;
+    sensorhub::core::PolyphaseDecimator m_decimator;
+    sensorhub::core::ImaAdpcmEncoder m_encoder;
+    sensorhub::core::HistoryRing m_ring;
+    std::vector<int16_t> m_pcm;
+    uint32_t m_filled = 0;
+    uint32_t m_phase = 0;
+    bool m_stale = false;
+};
+
+class AdpcmRing : public sensorhub::core::SpscEventRing {
+   public:
+    AdpcmRing(const AdpcmFormat& format, uint8_t* backing,
+              uint32_t capacityBlocks, uint32_t preRollBlocks)
+        : SpscEventRing(backing,
+                        format.BlockBytes(),
+                        capacityBlocks,
+                        preRollBlocks) {}
+};
+
+// Raw flash partition backing the offline recording spool.
+class PartitionFlash {
+   public:
+    static constexpr const char* Label = "spool";
+    static constexpr esp_partition_subtype_t SubType =
+        static_cast<esp_partition_subtype_t>(0x40);
+
+    explicit PartitionFlash(const esp_partition_t* partition)
+        : m_partition(partition) {}
+
+    static const esp_partition_t* Find() {
+        return esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                        SubType,
+                                        Label);
     }
 
-    void MarkPostRollDone() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_state.load(std::memory_order_relaxed) == State::Recording) {
-            m_state.store(State::PostCaptureDrain, std::memory_order_release);
-        }
+    uint32_t Size() const { return m_partition->size; }
+
+    bool Read(uint32_t offset, void* dst, uint32_t len) {
+        return esp_partition_read(m_partition, offset, dst, len) == ESP_OK;
+    }
+
+    bool Write(uint32_t offset, const void* src, uint32_t len) {
+        return esp_partition_write(m_partition, offset, src, len) == ESP_OK;
     }
 
-    void EndRecording() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_head = 0;
-        m_tail = 0;
-        m_count = 0;
-        m_postRollProduced.store(0, std::memory_order_release);
-        m_state.store(State::Idle, std::memory_order_release);
+    bool Erase(uint32_t offset, uint32_t len) {
+        return esp_partition_erase_range(m_partition, offset, len) == ESP_OK;
     }
 
    private:
-    void WriteBlockLocked(const uint8_t* block) {
-        std::memcpy(m_buf + m_head * AdpcmConfig::BlockAlign,
-                    block,
-                    AdpcmConfig::BlockAlign);
-        m_head = (m_head + 1) % AdpcmConfig::RingCapacityBlocks;
-    }
-
-    mutable std::mutex m_mutex;
-    std::atomic<State> m_state{State::Idle};
-    std::atomic<uint32_t> m_postRollProduced{0};
-
-    uint8_t* m_buf = nullptr;
-    uint32_t m_head = 0;
-    uint32_t m_tail = 0;
-    uint32_t m_count = 0;
-    uint32_t m_droppedDuringRecording = 0;
+    const esp_partition_t* m_partition;
+};
+
+// Blocks are stored in the format's slot size, so after a codec or block
+// size change the old sectors fail their CRC on Mount() and are dropped.
+// Only the sample rate and the gain are kept per event; the rest of the
+// format is the spool's.
+class AdpcmSpool : public sensorhub::core::RecordingSpool<PartitionFlash> {
+   public:
+    AdpcmSpool(const AdpcmFormat& format, PartitionFlash& flash)
+        : RecordingSpool(flash, flash.Size(), format.BlockBytes()),
+          m_format(format) {}
+
+    const AdpcmFormat& Format() const { return m_format; }
+
+   private:
+    AdpcmFormat m_format;
 };
 
 }
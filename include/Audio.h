@@ -86,19 +86,4 @@ struct Audio {
     uint32_t BufferCount, BufferLength, TotalLength, DMA_DescNum, DMA_FrameNum;
 };
 
-template <typename T>
-static float CalculateRMS(T* input, uint32_t size) {
-    if (size == 0) {
-        return 0.0f;
-    }
-    double sum_sqr = 0.0;
-
-    for (uint32_t count = size; count > 0; count--) {
-        const double f0 = static_cast<double>(*input++);
-        sum_sqr += f0 * f0;
-    }
-
-    return static_cast<float>(std::sqrt(sum_sqr / static_cast<double>(size)));
-}
-
 }
\ No newline at end of file
@@ -1,13 +1,19 @@
 #pragma once
 
+#include <cstdint>
+
 #include "Definitions.h"
 #include "core/Service.h"
+#include "sensorhub_core/ThirdOctaveAnalyzer.h"
 
 namespace Mic {
 
 extern const Kernel::Service kService;
 extern const Kernel::Service kSenderService;
 
+// How recordings are coded, from the device config.
+enum class RecordingCodec : uint32_t { ImaAdpcm = 0, Flac = 1 };
+
 void Init();
 void Update();
 
@@ -15,8 +21,24 @@ void UpdateRecording();
 bool UpdateLoudness();
 float CalculateLoudness();
 
+// Recording mode hands I2S buffers from a capture task to the analysis
+// task through a queue of chunks.
+struct CaptureStats {
+    uint32_t queueDepth = 0;
+    uint32_t maxQueueDepth = 0;
+    uint32_t queueChunks = 0;
+    // Buffers the I2S driver lost because nothing read them in time.
+    uint32_t dmaOverruns = 0;
+};
+
+CaptureStats GetCaptureStats();
+
 bool IsOK();
+// Clears the loudness, level statistics and band energies; only once the
+// readings of the interval are registered.
 void ResetValues();
 const Reading& GetLoudness();
+// Band energies summed over the reading interval, since ResetValues().
+sensorhub::core::BandEnergies GetBandEnergies();
 
 };
\ No newline at end of file
@@ -14,6 +14,10 @@ enum Sensors {
     Loudness,
     Recording,
     RPM,
+    LoudnessLeq,
+    LoudnessL10,
+    LoudnessL50,
+    LoudnessL90,
     SensorCount,
 };
 
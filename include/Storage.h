@@ -25,6 +25,17 @@ const std::string& GetApPassword();
 uint32_t GetDeviceId();
 uint32_t GetLoudnessThreshold();
 uint32_t GetRegisterInterval();
+uint32_t GetRecordingMaxSeconds();
+uint32_t GetRecordingSampleRate();
+uint32_t GetRecordingPreRollSeconds();
+uint32_t GetRecordingPostRollSeconds();
+uint32_t GetRecordingJitterSlackSeconds();
+uint32_t GetRecordingMemoryKb();
+uint32_t GetRecordingCodec();
+uint32_t GetRecordingSearchDepth();
+uint32_t GetRecordingBlockBytes();
+bool GetRecordingFeaturesOnly();
+bool GetRecordingSilenceRuns();
 bool GetSensorState(Configuration::Sensor::Sensors);
 bool GetConfigMode();
 
@@ -37,6 +48,17 @@ void SetApPassword(std::string&&);
 void SetDeviceId(uint32_t);
 void SetLoudnessThreshold(uint32_t);
 void SetRegisterInterval(uint32_t);
+void SetRecordingMaxSeconds(uint32_t);
+void SetRecordingSampleRate(uint32_t);
+void SetRecordingPreRollSeconds(uint32_t);
+void SetRecordingPostRollSeconds(uint32_t);
+void SetRecordingJitterSlackSeconds(uint32_t);
+void SetRecordingMemoryKb(uint32_t);
+void SetRecordingCodec(uint32_t);
+void SetRecordingSearchDepth(uint32_t);
+void SetRecordingBlockBytes(uint32_t);
+void SetRecordingFeaturesOnly(bool);
+void SetRecordingSilenceRuns(bool);
 void SetSensorState(Configuration::Sensor::Sensors, bool);
 void SetConfigMode(bool);
 
@@ -24,6 +24,7 @@ struct Service {
     void (*task_entry)(void*);
     uint32_t stack_bytes;
     UBaseType_t priority;
+    BaseType_t core = tskNO_AFFINITY;
 
     TaskHandle_t* out_handle;
 
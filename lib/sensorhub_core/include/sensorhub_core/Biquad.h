@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+
+namespace sensorhub::core {
+
+inline constexpr int kBiquadCoeffBits = 30;
+
+// Signals run through the biquads as int32 with this many bits of fraction
+// below the int16 LSB.
+inline constexpr int kBiquadStateFracBits = 8;
+
+struct BiquadQ30 {
+    int32_t b0, b1, b2, a1, a2;
+};
+
+struct BiquadCoeffs {
+    double b0, b1, b2, a1, a2;
+};
+
+struct BiquadStateQ30 {
+    int32_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    int64_t err = 0;
+};
+
+// Direct form I with first-order error feedback: the bits dropped by the
+// final shift are added back into the next accumulator, so rounding noise
+// is not amplified by poles close to z = 1.
+inline int32_t StepBiquadQ30(const BiquadQ30& c, BiquadStateQ30& st,
+                             int32_t x) {
+    const int64_t acc = static_cast<int64_t>(c.b0) * x +
+                        static_cast<int64_t>(c.b1) * st.x1 +
+                        static_cast<int64_t>(c.b2) * st.x2 -
+                        static_cast<int64_t>(c.a1) * st.y1 -
+                        static_cast<int64_t>(c.a2) * st.y2 + st.err;
+    const int32_t y = static_cast<int32_t>(acc >> kBiquadCoeffBits);
+    st.err = acc - (static_cast<int64_t>(y) << kBiquadCoeffBits);
+    st.x2 = st.x1;
+    st.x1 = x;
+    st.y2 = st.y1;
+    st.y1 = y;
+    return y;
+}
+
+inline int32_t RoundBiquadState(int32_t y) {
+    return (y + (1 << (kBiquadStateFracBits - 1))) >> kBiquadStateFracBits;
+}
+
+inline int32_t QuantiseQ30(double v) {
+    return static_cast<int32_t>(
+        std::clamp(std::llround(v * (1 << kBiquadCoeffBits)),
+                   static_cast<long long>(INT32_MIN),
+                   static_cast<long long>(INT32_MAX)));
+}
+
+inline BiquadQ30 QuantiseBiquad(const BiquadCoeffs& c) {
+    return {QuantiseQ30(c.b0),
+            QuantiseQ30(c.b1),
+            QuantiseQ30(c.b2),
+            QuantiseQ30(c.a1),
+            QuantiseQ30(c.a2)};
+}
+
+// Response at `w` radians per sample.
+inline std::complex<double> BiquadResponse(const BiquadCoeffs& c, double w) {
+    const std::complex<double> z1 = std::polar(1.0, -w);
+    const std::complex<double> z2 = z1 * z1;
+    return (c.b0 + c.b1 * z1 + c.b2 * z2) / (1.0 + c.a1 * z1 + c.a2 * z2);
+}
+
+inline std::complex<double> BiquadResponse(const BiquadQ30& q, double w) {
+    constexpr double kScale = 1.0 / (1 << kBiquadCoeffBits);
+    return BiquadResponse(BiquadCoeffs{q.b0 * kScale,
+                                       q.b1 * kScale,
+                                       q.b2 * kScale,
+                                       q.a1 * kScale,
+                                       q.a2 * kScale},
+                          w);
+}
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace sensorhub::core {
+
+// Sample rate and block length of one tier of stored audio.
+struct BlockTier {
+    uint32_t sampleRateHz = 0;
+    uint32_t samplesPerBlock = 0;
+
+    bool Enabled() const { return sampleRateHz > 0 && samplesPerBlock > 0; }
+
+    // Blocks needed to hold `ms`, rounded up.
+    uint32_t BlocksFor(uint32_t ms) const {
+        if (!Enabled()) {
+            return 0;
+        }
+        const uint64_t den = uint64_t{samplesPerBlock} * 1000;
+        return static_cast<uint32_t>(
+            (uint64_t{ms} * sampleRateHz + den - 1) / den);
+    }
+
+    // Audio held by `blocks`, rounded down.
+    uint32_t MsFor(uint32_t blocks) const {
+        if (!Enabled()) {
+            return 0;
+        }
+        return static_cast<uint32_t>(uint64_t{blocks} * samplesPerBlock *
+                                     1000 / sampleRateHz);
+    }
+};
+
+struct CaptureRequest {
+    // Whole pre-roll wanted before the trigger.
+    uint32_t preRollMs = 0;
+    // Newest part of it kept at the recording rate when there is a history
+    // tier; the rest only lives in the history.
+    uint32_t fullRateMs = 0;
+    // Room behind the pre-roll for blocks captured while the sender waits
+    // on the network.
+    uint32_t jitterSlackMs = 0;
+};
+
+struct CapturePlan {
+    // Event ring at the recording rate, and the pre-roll it keeps.
+    uint32_t ringBlocks = 0;
+    uint32_t preRollBlocks = 0;
+    // History tier; 0 when there is none or it does not fit.
+    uint32_t historyBlocks = 0;
+    // Pre-roll this plan gives, and the most the budget could give.
+    uint32_t preRollMs = 0;
+    uint32_t maxPreRollMs = 0;
+    // True when the budget cut the pre-roll or the slack short.
+    bool shortened = false;
+
+    uint32_t Blocks() const { return ringBlocks + historyBlocks; }
+};
+
+// Splits a memory budget between the event ring and the history tier.
+//
+// The jitter slack is served first, since running out of it drops blocks
+// from an event that is already being uploaded, then the full-rate
+// pre-roll, and the history gets what is left. A history that would not
+// reach past the full-rate pre-roll it overlaps is left out.
+class CapturePlanner {
+   public:
+    CapturePlanner(const BlockTier& recording, const BlockTier& history,
+                   uint16_t blockBytes)
+        : m_recording(recording),
+          m_history(history),
+          m_blockBytes(blockBytes) {}
+
+    CapturePlan Plan(const CaptureRequest& request,
+                     std::size_t budgetBytes) const {
+        CapturePlan plan;
+        const uint32_t budget = static_cast<uint32_t>(
+            std::min<std::size_t>(budgetBytes / m_blockBytes, UINT32_MAX));
+        const bool tiered = m_history.Enabled();
+        const uint32_t fullMs =
+            tiered ? std::min(request.fullRateMs, request.preRollMs)
+                   : request.preRollMs;
+
+        // The ring always keeps one free slot behind the pre-roll.
+        const uint32_t slack = std::max<uint32_t>(
+            1, m_recording.BlocksFor(request.jitterSlackMs));
+        const uint32_t wantPreRoll = m_recording.BlocksFor(fullMs);
+        const uint32_t preRollRoom = budget > slack ? budget - slack : 0;
+        plan.preRollBlocks = std::min(wantPreRoll, preRollRoom);
+        plan.ringBlocks = std::min(budget, plan.preRollBlocks + slack);
+        plan.shortened = plan.ringBlocks < wantPreRoll + slack;
+
+        const uint32_t left = budget - plan.ringBlocks;
+        if (tiered && request.preRollMs > fullMs) {
+            const uint32_t want = m_history.BlocksFor(request.preRollMs);
+            const uint32_t blocks = std::min(want, left);
+            plan.shortened = plan.shortened || blocks < want;
+            if (blocks > m_history.BlocksFor(fullMs)) {
+                plan.historyBlocks = blocks;
+            }
+        }
+
+        const uint32_t ringMs = m_recording.MsFor(plan.preRollBlocks);
+        plan.preRollMs = std::min(
+            request.preRollMs,
+            std::max(ringMs, m_history.MsFor(plan.historyBlocks)));
+        plan.maxPreRollMs =
+            tiered ? std::max(ringMs, m_history.MsFor(left))
+                   : m_recording.MsFor(preRollRoom);
+        return plan;
+    }
+
+   private:
+    BlockTier m_recording;
+    BlockTier m_history;
+    uint16_t m_blockBytes;
+};
+
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "sensorhub_core/LoudnessMath.h"
+#include "sensorhub_core/ThirdOctaveAnalyzer.h"
+
+namespace sensorhub::core {
+
+// What is left of a sound event when its audio is not kept. Levels are dB
+// SPL on the INMP441 scale, like every other level here.
+struct EventDescriptor {
+    uint32_t durationMs = 0;
+    // Highest time-weighted level, and the energy mean over the event.
+    float peakDb = 0.0f;
+    float leqDb = 0.0f;
+    // Band levels over the event; 0 for bands that were not measured.
+    std::array<float, kThirdOctaveBandCount> bandDb{};
+    // Energy-weighted mean of the band centres.
+    float centroidHz = 0.0f;
+    // Spectral flux, averaged over the event's blocks. A block's flux is
+    // how much its band amplitudes rose over the block before, falls
+    // counting as 0, as a fraction of its own summed amplitudes: 0 for a
+    // steady sound, 0.5 for one that doubles, 1 for one out of silence.
+    float flux = 0.0f;
+    // Blocks where the flux crossed DescriptorConfig::onsetFlux.
+    uint32_t onsets = 0;
+};
+
+struct DescriptorConfig {
+    // About a 3 dB jump across the spectrum.
+    float onsetFlux = 0.3f;
+};
+
+// Builds an EventDescriptor from the per-block measurements the capture
+// path already makes, one block at a time and in fixed memory.
+//
+// Every block goes through Add(), in an event or not, so the flux always
+// has the block before it. Outside an event the newest kPreRollBlocks are
+// held back, and Begin() takes the ones that made the trigger fire into
+// the event, with any onset among them.
+class DescriptorBuilder {
+   public:
+    static constexpr uint32_t kPreRollBlocks = 8;
+
+    explicit DescriptorBuilder(uint32_t sampleRateHz = 16000,
+                               const DescriptorConfig& config = {})
+        : m_sampleRateHz(sampleRateHz), m_onsetFlux(config.onsetFlux) {}
+
+    bool Active() const { return m_active; }
+
+    // One block: its weighted sum of squares over `count` samples, its
+    // band energies, and the time-weighted level after it.
+    void Add(uint64_t sumSquares, uint32_t count, const BandEnergies& bands,
+             float levelDb) {
+        Block block{sumSquares, count, bands, levelDb, 0.0f, false};
+        TrackFlux(block);
+        if (m_active) {
+            Accumulate(block);
+            return;
+        }
+        m_held[m_heldNext] = block;
+        m_heldNext = (m_heldNext + 1) % kPreRollBlocks;
+        m_heldCount = std::min(m_heldCount + 1, kPreRollBlocks);
+    }
+
+    // Starts an event with the newest `preRollBlocks` blocks already
+    // added, and returns how many of them it could take.
+    uint32_t Begin(uint32_t preRollBlocks) {
+        m_event = {};
+        m_active = true;
+        const uint32_t take = std::min(preRollBlocks, m_heldCount);
+        for (uint32_t i = take; i > 0; --i) {
+            Accumulate(m_held[(m_heldNext + kPreRollBlocks - i) %
+                              kPreRollBlocks]);
+        }
+        m_heldCount = 0;
+        return take;
+    }
+
+    EventDescriptor Finish() {
+        m_active = false;
+        EventDescriptor d;
+        d.durationMs = static_cast<uint32_t>(m_event.samples * 1000 /
+                                             m_sampleRateHz);
+        d.peakDb = m_event.peakDb;
+        d.leqDb = SplFromSumOfSquares(m_event.sumSquares, m_event.samples);
+        double weighted = 0.0;
+        double total = 0.0;
+        for (int b = 0; b < kThirdOctaveBandCount; ++b) {
+            const uint64_t n = m_event.bands.samples[b];
+            if (n == 0) {
+                continue;
+            }
+            d.bandDb[b] = m_event.bands.Level(b);
+            const double power =
+                static_cast<double>(m_event.bands.energy[b]) /
+                static_cast<double>(n);
+            weighted += power * ThirdOctaveCentreHz(b);
+            total += power;
+        }
+        d.centroidHz =
+            total > 0.0 ? static_cast<float>(weighted / total) : 0.0f;
+        d.flux = m_event.blocks > 0
+                     ? static_cast<float>(m_event.fluxSum / m_event.blocks)
+                     : 0.0f;
+        d.onsets = m_event.onsets;
+        return d;
+    }
+
+   private:
+    struct Block {
+        uint64_t sumSquares;
+        uint32_t count;
+        BandEnergies bands;
+        float levelDb;
+        float flux;
+        bool onset;
+    };
+
+    struct Event {
+        uint64_t sumSquares = 0;
+        uint64_t samples = 0;
+        BandEnergies bands;
+        float peakDb = 0.0f;
+        double fluxSum = 0.0;
+        uint32_t blocks = 0;
+        uint32_t onsets = 0;
+    };
+
+    // Amplitudes rather than levels, so quiet bands, such as the splatter
+    // of a sound that stops, weigh in by how loud they are. They are
+    // floored at 1 LSB, below the microphone's own noise, so that near
+    // silence a stray LSB is not a rise.
+    void TrackFlux(Block& block) {
+        float rise = 0.0f;
+        float sum = 0.0f;
+        for (int b = 0; b < kThirdOctaveBandCount; ++b) {
+            if (block.bands.samples[b] == 0) {
+                continue;
+            }
+            const float amplitude = std::max(
+                std::sqrt(static_cast<float>(block.bands.energy[b]) /
+                          static_cast<float>(block.bands.samples[b])),
+                1.0f);
+            rise += std::max(amplitude - m_amplitude[b], 0.0f);
+            sum += amplitude;
+            m_amplitude[b] = amplitude;
+        }
+        block.flux = m_primed && sum > 0.0f ? rise / sum : 0.0f;
+        block.onset = block.flux >= m_onsetFlux && m_lastFlux < m_onsetFlux;
+        m_lastFlux = block.flux;
+        m_primed = true;
+    }
+
+    void Accumulate(const Block& block) {
+        m_event.sumSquares += block.sumSquares;
+        m_event.samples += block.count;
+        m_event.bands.Add(block.bands);
+        m_event.peakDb = std::max(m_event.peakDb, block.levelDb);
+        m_event.fluxSum += block.flux;
+        m_event.blocks++;
+        m_event.onsets += block.onset ? 1 : 0;
+    }
+
+    uint32_t m_sampleRateHz;
+    float m_onsetFlux;
+    std::array<float, kThirdOctaveBandCount> m_amplitude{};
+    float m_lastFlux = 0.0f;
+    bool m_primed = false;
+    bool m_active = false;
+    Event m_event;
+    std::array<Block, kPreRollBlocks> m_held{};
+    uint32_t m_heldNext = 0;
+    uint32_t m_heldCount = 0;
+};
+
+// The descriptor as one JSON object, e.g.
+//
+//   {"duration_ms":2140,"peak_db":81.2,"leq_db":74.9,"centroid_hz":912,
+//    "flux":0.084,"onsets":3,"bands":{"50":41.0,...,"10000":38.2}}
+//
+// with unmeasured bands left out. Returns its length, or 0 if it does not
+// fit `capacity` with the terminating NUL.
+inline size_t FormatDescriptorJson(const EventDescriptor& d, char* out,
+                                   size_t capacity) {
+    size_t at = 0;
+    const auto append = [&](int n) {
+        if (n < 0 || static_cast<size_t>(n) >= capacity - at) {
+            at = capacity;
+            return false;
+        }
+        at += static_cast<size_t>(n);
+        return true;
+    };
+    if (capacity == 0 ||
+        !append(std::snprintf(out,
+                              capacity,
+                              "{\"duration_ms\":%" PRIu32
+                              ",\"peak_db\":%.1f,\"leq_db\":%.1f,"
+                              "\"centroid_hz\":%.0f,\"flux\":%.3f,"
+                              "\"onsets\":%" PRIu32 ",\"bands\":{",
+                              d.durationMs,
+                              d.peakDb,
+                              d.leqDb,
+                              d.centroidHz,
+                              d.flux,
+                              d.onsets))) {
+        return 0;
+    }
+    bool first = true;
+    for (int b = 0; b < kThirdOctaveBandCount; ++b) {
+        if (d.bandDb[b] == 0.0f) {
+            continue;
+        }
+        if (!append(std::snprintf(out + at,
+                                  capacity - at,
+                                  "%s\"%u\":%.1f",
+                                  first ? "" : ",",
+                                  unsigned{kThirdOctaveNominalHz[b]},
+                                  d.bandDb[b]))) {
+            return 0;
+        }
+        first = false;
+    }
+    if (!append(std::snprintf(out + at, capacity - at, "}}"))) {
+        return 0;
+    }
+    return at;
+}
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace sensorhub::core {
+
+struct TriggerConfig {
+    // Fire this far above the tracked noise floor...
+    float marginDb = 12.0f;
+    // ...but never below this absolute level.
+    float minLevelDb = 0.0f;
+    // After firing, re-arm once the level drops this far below threshold.
+    float rearmHysteresisDb = 3.0f;
+    // Consecutive blocks at or above threshold needed to fire.
+    uint32_t onsetBlocks = 4;
+    // Minimum number of blocks from one event to the next.
+    uint32_t cooldownBlocks = 0;
+    // Noise floor is tracked as this quantile of the block levels.
+    float floorQuantile = 0.1f;
+    // Tracker step per block; the floor rises by step * quantile and falls
+    // by step * (1 - quantile). Blocks vary in length, so set it with
+    // FloorStepDb() for a given speed.
+    float floorStepDb = 0.05f;
+};
+
+// Per-block floor step for a tracker that steps `dbPerSecond`, on blocks
+// of `samplesPerBlock` at `sampleRateHz`.
+constexpr float FloorStepDb(float dbPerSecond, uint32_t samplesPerBlock,
+                            uint32_t sampleRateHz) {
+    return dbPerSecond * static_cast<float>(samplesPerBlock) /
+           static_cast<float>(sampleRateHz);
+}
+
+// Event trigger against an adaptive noise floor. The floor is a streaming
+// quantile estimate (asymmetric fixed steps, O(1) and no history), so a
+// busy site raises its own threshold instead of firing on every passing
+// car. Firing needs `onsetBlocks` consecutive blocks above threshold; the
+// trigger then disarms until the level falls below the hysteresis band, and
+// a cooldown limits the event rate.
+class EventTrigger {
+   public:
+    explicit EventTrigger(const TriggerConfig& config = {})
+        : m_config(config) {}
+
+    const TriggerConfig& Config() const { return m_config; }
+
+    void Reset() {
+        m_floor = 0.0f;
+        m_primed = false;
+        m_armed = true;
+        m_run = 0;
+        m_sinceEvent = UINT32_MAX;
+    }
+
+    float NoiseFloor() const { return m_floor; }
+
+    float Threshold() const {
+        return std::max(m_floor + m_config.marginDb, m_config.minLevelDb);
+    }
+
+    bool Armed() const { return m_armed; }
+
+    // True while `levelDb` still sustains an event that has fired, i.e. it
+    // has not dropped out of the hysteresis band.
+    bool Sustains(float levelDb) const {
+        return levelDb >= Threshold() - m_config.rearmHysteresisDb;
+    }
+
+    // Feeds one block level in dB; returns true on the block an event fires.
+    bool Update(float levelDb) {
+        if (!m_primed) {
+            m_floor = levelDb;
+            m_primed = true;
+        }
+
+        const float threshold = Threshold();
+        if (m_sinceEvent != UINT32_MAX) {
+            ++m_sinceEvent;
+        }
+
+        if (levelDb > m_floor) {
+            m_floor += m_config.floorStepDb * m_config.floorQuantile;
+        } else {
+            m_floor -= m_config.floorStepDb * (1.0f - m_config.floorQuantile);
+        }
+
+        if (!m_armed) {
+            if (levelDb < threshold - m_config.rearmHysteresisDb) {
+                m_armed = true;
+                m_run = 0;
+            }
+            return false;
+        }
+
+        m_run = levelDb >= threshold ? m_run + 1 : 0;
+        if (m_run < m_config.onsetBlocks ||
+            m_sinceEvent < m_config.cooldownBlocks) {
+            return false;
+        }
+
+        m_armed = false;
+        m_run = 0;
+        m_sinceEvent = 0;
+        return true;
+    }
+
+   private:
+    TriggerConfig m_config;
+    float m_floor = 0.0f;
+    bool m_primed = false;
+    bool m_armed = true;
+    uint32_t m_run = 0;
+    uint32_t m_sinceEvent = UINT32_MAX;
+};
+
+struct ExtentConfig {
+    // Blocks always recorded after the trigger.
+    uint32_t minPostBlocks = 0;
+    // After that, the event ends once this many blocks in a row no longer
+    // sustain it...
+    uint32_t releaseBlocks = 0;
+    // ...or when it reaches this many blocks, pre-roll included.
+    uint32_t maxBlocks = UINT32_MAX;
+};
+
+// Decides when a recording that has fired ends: it runs on while the sound
+// sustains it and stops soon after it dies away, so short events do not
+// carry a fixed tail of silence and long ones are not cut off early.
+class EventExtent {
+   public:
+    explicit EventExtent(const ExtentConfig& config = {}) : m_config(config) {}
+
+    const ExtentConfig& Config() const { return m_config; }
+
+    void Start(uint32_t preRollBlocks) {
+        m_blocks = preRollBlocks;
+        m_post = 0;
+        m_quiet = 0;
+    }
+
+    uint32_t Blocks() const { return m_blocks; }
+
+    // Feeds one recorded block after the trigger; returns true when the
+    // event should end with this block.
+    bool Update(bool sustained) {
+        ++m_blocks;
+        ++m_post;
+        m_quiet = sustained ? 0 : m_quiet + 1;
+        if (m_blocks >= m_config.maxBlocks) {
+            return true;
+        }
+        return m_post >= m_config.minPostBlocks &&
+               m_quiet >= m_config.releaseBlocks;
+    }
+
+   private:
+    ExtentConfig m_config;
+    uint32_t m_blocks = 0;
+    uint32_t m_post = 0;
+    uint32_t m_quiet = 0;
+};
+
+}
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace sensorhub::core {
+
+// Lossless mono 16-bit coding in FLAC's format: every block of samples is
+// one subframe with a fixed polynomial predictor (order 0 to 4, picked per
+// block by the smallest residual sum) and Rice-coded residuals, with the
+// Rice parameter picked per block from the exact bit count. Silence is a
+// constant subframe, and a block that would not shrink is stored verbatim,
+// so a subframe never exceeds FlacMaxSubframeBytes().
+//
+// Subframes are kept bare, without the frame header: that carries the
+// frame number, which is only known once an event is uploaded, so
+// FlacFrameHeader() and FlacCrc16() wrap them then. The block size is
+// whatever the caller uses throughout; FLAC's Rice partitions need it to
+// be even, so odd sizes get a single partition.
+
+inline constexpr int kFlacMaxFixedOrder = 4;
+
+// STREAMINFO for a stream of unknown length: "fLaC" and one metadata
+// block.
+inline constexpr std::size_t kFlacStreamHeaderBytes = 42;
+
+// Sync, two code bytes, a frame number of up to six bytes, the block size
+// and the CRC-8.
+inline constexpr std::size_t kFlacMaxFrameHeaderBytes = 13;
+
+inline constexpr std::size_t kFlacFrameFooterBytes = 2;
+
+inline constexpr uint32_t FlacMaxSubframeBytes(uint32_t samples) {
+    return 1 + 2 * samples;
+}
+
+// CRC-8 (poly 0x07) over a frame header.
+inline uint8_t FlacCrc8(const uint8_t* data, std::size_t len,
+                        uint8_t crc = 0) {
+    for (std::size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = static_cast<uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x07
+                                                  : crc << 1);
+        }
+    }
+    return crc;
+}
+
+// CRC-16 (poly 0x8005) over a whole frame, nibble table.
+inline uint16_t FlacCrc16(const uint8_t* data, std::size_t len,
+                          uint16_t crc = 0) {
+    static constexpr uint16_t kTable[16] = {
+        0x0000, 0x8005, 0x800F, 0x000A, 0x801B, 0x001E, 0x0014, 0x8011,
+        0x8033, 0x0036, 0x003C, 0x8039, 0x0028, 0x802D, 0x8027, 0x0022};
+    for (std::size_t i = 0; i < len; ++i) {
+        crc = static_cast<uint16_t>((crc << 4) ^
+                                    kTable[(crc >> 12) ^ (data[i] >> 4)]);
+        crc = static_cast<uint16_t>((crc << 4) ^
+                                    kTable[(crc >> 12) ^ (data[i] & 0x0F)]);
+    }
+    return crc;
+}
+
+namespace detail {
+
+inline uint8_t FlacRateCode(uint32_t sampleRateHz) {
+    switch (sampleRateHz) {
+        case 8000:
+            return 0x4;
+        case 16000:
+            return 0x5;
+        case 32000:
+            return 0x8;
+        default:
+            // Taken from STREAMINFO.
+            return 0x0;
+    }
+}
+
+class BitWriter {
+   public:
+    explicit BitWriter(uint8_t* out) : m_out(out) {}
+
+    // `bits` <= 32.
+    void Put(uint32_t value, int bits) {
+        if (bits == 0) {
+            return;
+        }
+        m_acc = (m_acc << bits) | (value & (0xFFFFFFFFu >> (32 - bits)));
+        m_bits += bits;
+        while (m_bits >= 8) {
+            m_bits -= 8;
+            m_out[m_bytes++] = static_cast<uint8_t>(m_acc >> m_bits);
+        }
+    }
+
+    void PutZeros(uint32_t count) {
+        for (; count >= 32; count -= 32) {
+            Put(0, 32);
+        }
+        Put(0, static_cast<int>(count));
+    }
+
+    // Pads to a byte with zeros; returns the bytes written.
+    uint32_t Finish() {
+        if (m_bits > 0) {
+            Put(0, 8 - m_bits);
+        }
+        return m_bytes;
+    }
+
+   private:
+    uint8_t* m_out;
+    uint64_t m_acc = 0;
+    int m_bits = 0;
+    uint32_t m_bytes = 0;
+};
+
+class BitReader {
+   public:
+    BitReader(const uint8_t* in, uint32_t bytes) : m_in(in), m_size(bytes) {}
+
+    bool Ok() const { return m_ok; }
+
+    // `bits` <= 32.
+    uint32_t Get(int bits) {
+        uint32_t value = 0;
+        for (int i = 0; i < bits; ++i) {
+            value = (value << 1) | Bit();
+        }
+        return value;
+    }
+
+    int32_t GetSigned(int bits) {
+        const uint32_t value = Get(bits);
+        const uint32_t sign = 1u << (bits - 1);
+        return static_cast<int32_t>((value ^ sign) - sign);
+    }
+
+    uint32_t Unary() {
+        uint32_t zeros = 0;
+        while (m_ok && Bit() == 0) {
+            ++zeros;
+        }
+        return zeros;
+    }
+
+   private:
+    uint32_t Bit() {
+        if (m_pos >= m_size * 8u) {
+            m_ok = false;
+            return 1;
+        }
+        const uint32_t bit = (m_in[m_pos >> 3] >> (7 - (m_pos & 7))) & 1;
+        ++m_pos;
+        return bit;
+    }
+
+    const uint8_t* m_in;
+    uint32_t m_size;
+    uint32_t m_pos = 0;
+    bool m_ok = true;
+};
+
+// Fixed polynomial prediction of x[i] from the `order` samples before it.
+inline int32_t FlacFixedPredict(const int16_t* x, uint32_t i, int order) {
+    switch (order) {
+        case 0:
+            return 0;
+        case 1:
+            return x[i - 1];
+        case 2:
+            return 2 * x[i - 1] - x[i - 2];
+        case 3:
+            return 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3];
+        default:
+            return 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4];
+    }
+}
+
+inline int32_t FlacFixedResidual(const int16_t* x, uint32_t i, int order) {
+    return x[i] - FlacFixedPredict(x, i, order);
+}
+
+inline uint32_t ZigZag(int32_t r) {
+    return (static_cast<uint32_t>(r) << 1) ^ static_cast<uint32_t>(r >> 31);
+}
+
+}
+
+// Writes STREAMINFO for mono 16-bit audio in blocks of `blockSize`, with
+// the length and MD5 left unknown.
+inline void FlacStreamHeader(uint32_t blockSize, uint32_t sampleRateHz,
+                             uint8_t* out) {
+    detail::BitWriter w(out);
+    for (char c : {'f', 'L', 'a', 'C'}) {
+        w.Put(static_cast<uint8_t>(c), 8);
+    }
+    w.Put(0x80, 8);  // Last metadata block, STREAMINFO.
+    w.Put(34, 24);
+    w.Put(blockSize, 16);
+    w.Put(blockSize, 16);
+    w.Put(0, 24);
+    w.Put(0, 24);
+    w.Put(sampleRateHz, 20);
+    w.Put(0, 3);   // One channel.
+    w.Put(15, 5);  // 16 bits per sample.
+    w.Put(0, 4);   // Total samples, 36 bits.
+    w.Put(0, 32);
+    for (int i = 0; i < 4; ++i) {
+        w.Put(0, 32);
+    }
+    w.Finish();
+}
+
+// Writes the header of frame `frame` and returns its length.
+inline std::size_t FlacFrameHeader(uint32_t frame, uint32_t blockSize,
+                                   uint32_t sampleRateHz, uint8_t* out) {
+    std::size_t n = 0;
+    out[n++] = 0xFF;
+    out[n++] = 0xF8;  // Fixed block size.
+    out[n++] =
+        static_cast<uint8_t>(0x70 | detail::FlacRateCode(sampleRateHz));
+    out[n++] = 0x08;  // Mono, 16 bits per sample.
+
+    frame &= 0x7FFFFFFF;
+    if (frame < 0x80) {
+        out[n++] = static_cast<uint8_t>(frame);
+    } else {
+        int extra = 1;
+        while (extra < 5 && frame >= (1u << (5 * extra + 6))) {
+            ++extra;
+        }
+        out[n++] = static_cast<uint8_t>((0xFF00 >> (extra + 1)) |
+                                        (frame >> (6 * extra)));
+        for (int i = extra - 1; i >= 0; --i) {
+            out[n++] =
+                static_cast<uint8_t>(0x80 | ((frame >> (6 * i)) & 0x3F));
+        }
+    }
+
+    out[n++] = static_cast<uint8_t>((blockSize - 1) >> 8);
+    out[n++] = static_cast<uint8_t>(blockSize - 1);
+    out[n] = FlacCrc8(out, n);
+    return n + 1;
+}
+
+// Encodes `count` samples as one subframe and returns its length in bytes,
+// at most FlacMaxSubframeBytes(count).
+inline uint32_t EncodeFlacSubframe(const int16_t* pcm, uint32_t count,
+                                   uint8_t* out) {
+    detail::BitWriter w(out);
+
+    if (count > 0 && std::all_of(pcm, pcm + count, [&](int16_t s) {
+            return s == pcm[0];
+        })) {
+        w.Put(0x00, 8);
+        w.Put(static_cast<uint16_t>(pcm[0]), 16);
+        return w.Finish();
+    }
+
+    const uint64_t verbatimBits = 8 + 16 * uint64_t{count};
+    int order = 0;
+    int k = 0;
+    uint64_t bits = UINT64_MAX;
+    if (count > kFlacMaxFixedOrder) {
+        // Residual magnitude of every order over the same samples; the
+        // order-n residual is the difference of consecutive order n-1 ones.
+        std::array<uint64_t, kFlacMaxFixedOrder + 1> sums{};
+        int32_t last[kFlacMaxFixedOrder] = {
+            pcm[3],
+            pcm[3] - pcm[2],
+            pcm[3] - 2 * pcm[2] + pcm[1],
+            pcm[3] - 3 * pcm[2] + 3 * pcm[1] - pcm[0]};
+        for (uint32_t i = kFlacMaxFixedOrder; i < count; ++i) {
+            int32_t e = pcm[i];
+            for (int o = 0; o < kFlacMaxFixedOrder; ++o) {
+                sums[o] += static_cast<uint32_t>(e < 0 ? -e : e);
+                const int32_t next = e - last[o];
+                last[o] = e;
+                e = next;
+            }
+            sums[kFlacMaxFixedOrder] += static_cast<uint32_t>(e < 0 ? -e : e);
+        }
+        order = static_cast<int>(std::min_element(sums.begin(), sums.end()) -
+                                 sums.begin());
+
+        // A Rice parameter near log2 of the mean folded residual, then the
+        // exact cost of it and its neighbours.
+        const uint32_t n = count - order;
+        const uint64_t mean = 2 * sums[order] / (count - kFlacMaxFixedOrder);
+        const int guess =
+            std::clamp(static_cast<int>(std::bit_width(mean)) - 1, 1, 13);
+        std::array<uint64_t, 3> cost{};
+        for (uint32_t i = order; i < count; ++i) {
+            const uint32_t u =
+                detail::ZigZag(detail::FlacFixedResidual(pcm, i, order));
+            for (int c = 0; c < 3; ++c) {
+                cost[c] += u >> (guess - 1 + c);
+            }
+        }
+        for (int c = 0; c < 3; ++c) {
+            const uint64_t total = 8 + 16 * uint64_t(order) + 10 +
+                                   uint64_t{n} * (guess + c) + cost[c];
+            if (total < bits) {
+                bits = total;
+                k = guess - 1 + c;
+            }
+        }
+    }
+
+    if (bits >= verbatimBits) {
+        w.Put(0x02, 8);
+        for (uint32_t i = 0; i < count; ++i) {
+            w.Put(static_cast<uint16_t>(pcm[i]), 16);
+        }
+        return w.Finish();
+    }
+
+    w.Put(static_cast<uint32_t>(0x10 | (order << 1)), 8);
+    for (int i = 0; i < order; ++i) {
+        w.Put(static_cast<uint16_t>(pcm[i]), 16);
+    }
+    w.Put(0, 2);  // 4-bit Rice parameters.
+    w.Put(0, 4);  // One partition.
+    w.Put(static_cast<uint32_t>(k), 4);
+    for (uint32_t i = order; i < count; ++i) {
+        const uint32_t u =
+            detail::ZigZag(detail::FlacFixedResidual(pcm, i, order));
+        w.PutZeros(u >> k);
+        w.Put(1, 1);
+        w.Put(u, k);
+    }
+    return w.Finish();
+}
+
+// Decodes a subframe of `count` samples as written by EncodeFlacSubframe():
+// constant, verbatim or fixed, with any Rice partitioning. False if it is
+// some other kind or runs past `bytes`.
+inline bool DecodeFlacSubframe(const uint8_t* in, uint32_t bytes,
+                               uint32_t count, int16_t* out) {
+    detail::BitReader r(in, bytes);
+    const uint32_t header = r.Get(8);
+    if ((header & 0x81) != 0) {
+        return false;
+    }
+    const uint32_t type = header >> 1;
+
+    if (type == 0 || type == 1) {
+        for (uint32_t i = 0; i < count; ++i) {
+            out[i] = static_cast<int16_t>(
+                i == 0 || type == 1 ? r.GetSigned(16) : out[0]);
+        }
+        return r.Ok();
+    }
+    if (type < 8 || type > 8 + kFlacMaxFixedOrder) {
+        return false;
+    }
+
+    const int order = static_cast<int>(type - 8);
+    if (static_cast<uint32_t>(order) > count) {
+        return false;
+    }
+    for (int i = 0; i < order; ++i) {
+        out[i] = static_cast<int16_t>(r.GetSigned(16));
+    }
+
+    const uint32_t method = r.Get(2);
+    const int partitionOrder = static_cast<int>(r.Get(4));
+    const uint32_t partitions = 1u << partitionOrder;
+    if (method > 1 || count % partitions != 0 ||
+        count / partitions < static_cast<uint32_t>(order)) {
+        return false;
+    }
+
+    const int paramBits = method == 0 ? 4 : 5;
+    const uint32_t escape = method == 0 ? 15 : 31;
+    uint32_t i = order;
+    for (uint32_t p = 0; p < partitions && r.Ok(); ++p) {
+        const uint32_t end = (p + 1) * (count / partitions);
+        const uint32_t param = r.Get(paramBits);
+        const uint32_t raw = param == escape ? r.Get(5) : 0;
+        for (; i < end && r.Ok(); ++i) {
+            int32_t residual = 0;
+            if (param != escape) {
+                const uint32_t u =
+                    (r.Unary() << param) | r.Get(static_cast<int>(param));
+                residual = static_cast<int32_t>(u >> 1) ^
+                           -static_cast<int32_t>(u & 1);
+            } else if (raw > 0) {
+                residual = r.GetSigned(static_cast<int>(raw));
+            }
+            const int32_t value =
+                residual + detail::FlacFixedPredict(out, i, order);
+            if (value < INT16_MIN || value > INT16_MAX) {
+                return false;
+            }
+            out[i] = static_cast<int16_t>(value);
+        }
+    }
+    return r.Ok() && i == count;
+}
+
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <numbers>
+
+#include "sensorhub_core/Biquad.h"
+
+namespace sensorhub::core {
+
+enum class FrequencyWeighting : uint8_t { Z, A, C };
+
+inline const char* WeightingUnit(FrequencyWeighting weighting) {
+    switch (weighting) {
+        case FrequencyWeighting::A:
+            return "dBA";
+        case FrequencyWeighting::C:
+            return "dBC";
+        default:
+            return "dB";
+    }
+}
+
+// Nominal IEC 61672-1 response in dB, from the analog pole frequencies.
+inline double WeightingNominalDb(FrequencyWeighting weighting, double freqHz) {
+    constexpr double f1 = 20.598997, f2 = 107.65265, f3 = 737.86223,
+                     f4 = 12194.217;
+    const double ff = freqHz * freqHz;
+    const double hp1 = ff / (ff + f1 * f1);
+    const double lp4 = f4 * f4 / (ff + f4 * f4);
+    switch (weighting) {
+        case FrequencyWeighting::A:
+            return 20.0 * std::log10(hp1 * lp4 * ff /
+                                     std::sqrt((ff + f2 * f2) *
+                                               (ff + f3 * f3))) +
+                   2.0;
+        case FrequencyWeighting::C:
+            return 20.0 * std::log10(hp1 * lp4) + 0.062;
+        default:
+            return 0.0;
+    }
+}
+
+// A / C frequency weighting as a cascade of fixed-point biquads.
+//
+// Sections run through StepBiquadQ30(), whose error feedback keeps the
+// 20 Hz double pole from amplifying truncation noise. Low-frequency poles
+// use the bilinear transform (the 107 Hz and 738 Hz poles prewarped); the
+// 12.2 kHz pole pair is split into one bilinear and one matched-z pole,
+// whose errors near Nyquist have opposite signs. At 32 kHz the response is
+// within 0.2 dB of nominal up to 8 kHz.
+class WeightingFilter {
+   public:
+    static constexpr int kMaxSections = 3;
+
+    WeightingFilter() = default;
+
+    WeightingFilter(FrequencyWeighting weighting, uint32_t sampleRateHz)
+        : m_weighting(weighting) {
+        Design(static_cast<double>(sampleRateHz));
+    }
+
+    FrequencyWeighting Weighting() const { return m_weighting; }
+
+    int SectionCount() const { return m_sectionCount; }
+
+    const BiquadQ30& Section(int i) const { return m_coeffs[i]; }
+
+    void Reset() {
+        m_state = {};
+        m_residue = 0;
+    }
+
+    // Weights `count` samples from `in` into `out`, saturating at int16.
+    // `in` and `out` may alias.
+    void Process(const int16_t* in, int16_t* out, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i) {
+            const int32_t y = RoundBiquadState(Step(in[i]));
+            out[i] = static_cast<int16_t>(
+                std::clamp(y, int32_t{-32768}, int32_t{32767}));
+        }
+    }
+
+    // Sum of squares of the weighted signal, without writing it anywhere.
+    uint64_t SumOfSquares(const int16_t* in, uint32_t count) {
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            const int64_t y = RoundBiquadState(Step(in[i]));
+            sum += static_cast<uint64_t>(y * y);
+        }
+        return sum;
+    }
+
+    // SumOfSquares() for 24-bit samples on the 16-bit scale with
+    // kBiquadStateFracBits of fraction, still in LSB^2 of 16 bits. Nothing
+    // is rounded per sample; the part of the sum below one LSB^2 carries
+    // over to the next call.
+    uint64_t SumOfSquaresQ8(const int32_t* in, uint32_t count) {
+        uint64_t sum = m_residue;
+        for (uint32_t i = 0; i < count; ++i) {
+            const int64_t y = StepQ8(in[i]);
+            sum += static_cast<uint64_t>(y * y);
+        }
+        constexpr int kShift = 2 * kBiquadStateFracBits;
+        m_residue = sum & ((uint64_t{1} << kShift) - 1);
+        return sum >> kShift;
+    }
+
+    // Magnitude response of the quantised coefficients, in dB.
+    double ResponseDb(double freqHz, double sampleRateHz) const {
+        const double w = 2.0 * std::numbers::pi * freqHz / sampleRateHz;
+        std::complex<double> h = 1.0;
+        for (int s = 0; s < m_sectionCount; ++s) {
+            h *= BiquadResponse(m_coeffs[s], w);
+        }
+        return 20.0 * std::log10(std::abs(h));
+    }
+
+   private:
+    struct FirstOrder {
+        double b0, b1, a1;
+    };
+
+    int32_t Step(int16_t sample) {
+        return StepQ8(static_cast<int32_t>(sample) << kBiquadStateFracBits);
+    }
+
+    int32_t StepQ8(int32_t x) {
+        for (int s = 0; s < m_sectionCount; ++s) {
+            x = StepBiquadQ30(m_coeffs[s], m_state[s], x);
+        }
+        return x;
+    }
+
+    static FirstOrder HighPass(double w, double k) {
+        return {k / (k + w), -k / (k + w), (w - k) / (k + w)};
+    }
+
+    static FirstOrder LowPass(double w, double k) {
+        return {w / (k + w), w / (k + w), (w - k) / (k + w)};
+    }
+
+    static FirstOrder LowPassMatched(double w, double fs) {
+        const double p = std::exp(-w / fs);
+        return {1.0 - p, 0.0, -p};
+    }
+
+    static BiquadCoeffs Combine(const FirstOrder& p, const FirstOrder& q) {
+        return {p.b0 * q.b0,
+                p.b0 * q.b1 + p.b1 * q.b0,
+                p.b1 * q.b1,
+                p.a1 + q.a1,
+                p.a1 * q.a1};
+    }
+
+    void Design(double fs) {
+        constexpr double kTwoPi = 2.0 * std::numbers::pi;
+        const double k = 2.0 * fs;
+        const double w1 = kTwoPi * 20.598997;
+        const double w2 = k * std::tan(kTwoPi * 107.65265 / k);
+        const double w3 = k * std::tan(kTwoPi * 737.86223 / k);
+        const double w4 = kTwoPi * 12194.217;
+
+        std::array<BiquadCoeffs, kMaxSections> sections{};
+        const BiquadCoeffs lowPass =
+            Combine(LowPass(w4, k), LowPassMatched(w4, fs));
+        switch (m_weighting) {
+            case FrequencyWeighting::A:
+                sections[0] = Combine(HighPass(w1, k), HighPass(w1, k));
+                sections[1] = Combine(HighPass(w2, k), HighPass(w3, k));
+                sections[2] = lowPass;
+                m_sectionCount = 3;
+                break;
+            case FrequencyWeighting::C:
+                sections[0] = Combine(HighPass(w1, k), HighPass(w1, k));
+                sections[1] = lowPass;
+                m_sectionCount = 2;
+                break;
+            default:
+                m_sectionCount = 0;
+                return;
+        }
+
+        const double w1k = kTwoPi * 1000.0 / fs;
+        std::complex<double> h = 1.0;
+        for (int s = 0; s < m_sectionCount; ++s) {
+            h *= BiquadResponse(sections[s], w1k);
+        }
+        const double gain = 1.0 / std::abs(h);
+        BiquadCoeffs& last = sections[m_sectionCount - 1];
+        last.b0 *= gain;
+        last.b1 *= gain;
+        last.b2 *= gain;
+
+        for (int s = 0; s < m_sectionCount; ++s) {
+            m_coeffs[s] = QuantiseBiquad(sections[s]);
+        }
+    }
+
+    FrequencyWeighting m_weighting = FrequencyWeighting::Z;
+    int m_sectionCount = 0;
+    std::array<BiquadQ30, kMaxSections> m_coeffs{};
+    std::array<BiquadStateQ30, kMaxSections> m_state{};
+    uint64_t m_residue = 0;
+};
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+#include "sensorhub_core/Biquad.h"
+
+namespace sensorhub::core {
+
+// Zeroth-order modified Bessel function, for Kaiser windows.
+inline double BesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Decimate-by-two halfband FIR with `Pairs` non-zero coefficient pairs
+// (4 * Pairs - 1 taps, Kaiser windowed). Every other tap of a halfband is
+// zero and the centre tap is 1/2, so one output costs Pairs multiplies on
+// pre-added symmetric samples, and only every second input produces one.
+// Coefficients are Q30 like the biquads; samples are plain int32.
+template <int Pairs>
+class HalfbandDecimator {
+   public:
+    static constexpr int kTaps = 4 * Pairs - 1;
+    static constexpr int kCentre = kTaps / 2;
+
+    explicit HalfbandDecimator(double kaiserBeta = 5.0) {
+        Design(kaiserBeta);
+    }
+
+    void Reset() {
+        m_history.fill(0);
+        m_pos = 0;
+        m_odd = false;
+    }
+
+    // Feeds one input sample; returns true and writes `out` on every
+    // second call.
+    bool Push(int32_t x, int32_t& out) {
+        m_pos = m_pos == 0 ? kTaps - 1 : m_pos - 1;
+        m_history[m_pos] = x;
+        m_history[m_pos + kTaps] = x;
+        m_odd = !m_odd;
+        if (m_odd) {
+            return false;
+        }
+
+        const int32_t* w = m_history.data() + m_pos;
+        int64_t acc = static_cast<int64_t>(w[kCentre])
+                      << (kBiquadCoeffBits - 1);
+        for (int j = 0; j < Pairs; ++j) {
+            const int offset = 2 * j + 1;
+            acc += static_cast<int64_t>(m_coeffs[j]) *
+                   (static_cast<int64_t>(w[kCentre - offset]) +
+                    w[kCentre + offset]);
+        }
+        out = static_cast<int32_t>(
+            (acc + (int64_t{1} << (kBiquadCoeffBits - 1))) >> kBiquadCoeffBits);
+        return true;
+    }
+
+    // Magnitude response in dB at `f` cycles per input sample.
+    double ResponseDb(double f) const {
+        constexpr double kScale = 1.0 / (1 << kBiquadCoeffBits);
+        double h = 0.5;
+        for (int j = 0; j < Pairs; ++j) {
+            h += 2.0 * m_coeffs[j] * kScale *
+                 std::cos(2.0 * std::numbers::pi * f * (2 * j + 1));
+        }
+        return 20.0 * std::log10(std::abs(h));
+    }
+
+   private:
+    void Design(double beta) {
+        std::array<double, Pairs> taps{};
+        double sum = 0.0;
+        const double half = 2.0 * Pairs;
+        for (int j = 0; j < Pairs; ++j) {
+            const int m = 2 * j + 1;
+            const double sinc = std::sin(std::numbers::pi * m / 2.0) /
+                                (std::numbers::pi * m);
+            const double r = m / half;
+            const double window =
+                BesselI0(beta * std::sqrt(1.0 - r * r)) / BesselI0(beta);
+            taps[j] = sinc * window;
+            sum += 2.0 * taps[j];
+        }
+        for (int j = 0; j < Pairs; ++j) {
+            m_coeffs[j] = QuantiseQ30(taps[j] * 0.5 / sum);
+        }
+    }
+
+    std::array<int32_t, Pairs> m_coeffs{};
+    std::array<int32_t, 2 * kTaps> m_history{};
+    int m_pos = 0;
+    bool m_odd = false;
+};
+
+}
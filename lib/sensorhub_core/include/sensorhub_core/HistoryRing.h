@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace sensorhub::core {
+
+// Where a lower-rate history ends against a full-rate pre-roll, when each
+// history block covers `group` full-rate blocks.
+struct HistorySplit {
+    // Newest history blocks that overlap the pre-roll and are left out.
+    uint32_t dropNewest = 0;
+    // Oldest pre-roll blocks to skip so the pre-roll starts exactly where
+    // the history ends.
+    uint32_t skipPreRoll = 0;
+};
+
+// `preRoll` full-rate blocks end at the newest one, and the last `phase` of
+// them are still in the history block being filled.
+inline bool SplitHistory(uint32_t preRoll, uint32_t phase, uint32_t group,
+                         HistorySplit& out) {
+    if (group == 0 || phase > preRoll) {
+        return false;
+    }
+    const uint32_t overlap = preRoll - phase;
+    out.dropNewest = overlap / group;
+    out.skipPreRoll = overlap % group;
+    return true;
+}
+
+struct HistorySnapshot {
+    uint32_t blocks = 0;
+    uint32_t skipPreRoll = 0;
+};
+
+// Single-producer/single-consumer store for the older, lower-rate tier of
+// the pre-roll. The producer keeps the newest `capacity` blocks until an
+// event freezes them; the consumer then reads the frozen blocks and
+// releases them, and the producer starts over from empty, so history never
+// reaches back past the previous event. The producer writes nothing while
+// frozen.
+class HistoryRing {
+   public:
+    HistoryRing(uint8_t* backing, uint16_t blockBytes, uint32_t capacityBlocks)
+        : m_buf(backing),
+          m_blockBytes(blockBytes),
+          m_capacity(capacityBlocks) {}
+
+    HistoryRing(const HistoryRing&) = delete;
+    HistoryRing& operator=(const HistoryRing&) = delete;
+
+    uint32_t Capacity() const { return m_capacity; }
+
+    // Producer. Blocks held.
+    uint32_t Size() const { return m_count; }
+
+    bool Frozen() const { return m_frozen.load(std::memory_order_acquire); }
+
+    // Producer. Slot for the next block, overwriting the oldest when full;
+    // nullptr while frozen.
+    uint8_t* Reserve() {
+        if (Frozen() || m_capacity == 0) {
+            return nullptr;
+        }
+        return m_buf + static_cast<std::size_t>(m_head) * m_blockBytes;
+    }
+
+    void Commit() {
+        m_head = m_head + 1 == m_capacity ? 0 : m_head + 1;
+        if (m_count < m_capacity) {
+            ++m_count;
+        }
+    }
+
+    // Producer. Forgets the history; frozen blocks stay readable.
+    void Restart() { m_count = 0; }
+
+    // Producer. Freezes all but the newest `split.dropNewest` blocks for
+    // event `event`. False if nothing would be left or a previous freeze
+    // has not been released yet.
+    bool Freeze(uint32_t event, const HistorySplit& split) {
+        if (Frozen() || m_count <= split.dropNewest) {
+            return false;
+        }
+        m_snapshot = {m_count - split.dropNewest, split.skipPreRoll};
+        m_snapshotStart = m_head >= m_count ? m_head - m_count
+                                            : m_head + m_capacity - m_count;
+        m_snapshotEvent.store(event, std::memory_order_relaxed);
+        m_count = 0;
+        m_frozen.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // Producer. Undoes Freeze() for an event that was never queued.
+    void Cancel(uint32_t event) {
+        if (Frozen() &&
+            m_snapshotEvent.load(std::memory_order_relaxed) == event) {
+            m_frozen.store(false, std::memory_order_release);
+        }
+    }
+
+    // Consumer. The frozen history of event `event`, if there is one.
+    bool Snapshot(uint32_t event, HistorySnapshot& out) const {
+        if (!Frozen() ||
+            m_snapshotEvent.load(std::memory_order_relaxed) != event) {
+            return false;
+        }
+        out = m_snapshot;
+        return true;
+    }
+
+    // Consumer. Block `i` of the snapshot, oldest first.
+    const uint8_t* Block(uint32_t i) const {
+        uint32_t slot = m_snapshotStart + i;
+        if (slot >= m_capacity) {
+            slot -= m_capacity;
+        }
+        return m_buf + static_cast<std::size_t>(slot) * m_blockBytes;
+    }
+
+    // Consumer. Hands the snapshot of `event` back to the producer.
+    void Release(uint32_t event) {
+        if (Frozen() &&
+            m_snapshotEvent.load(std::memory_order_relaxed) == event) {
+            m_frozen.store(false, std::memory_order_release);
+        }
+    }
+
+   private:
+    uint8_t* const m_buf;
+    const uint16_t m_blockBytes;
+    const uint32_t m_capacity;
+
+    // Producer only.
+    uint32_t m_head = 0;
+    uint32_t m_count = 0;
+
+    // Written by the producer before `m_frozen` is set.
+    HistorySnapshot m_snapshot;
+    uint32_t m_snapshotStart = 0;
+    std::atomic<uint32_t> m_snapshotEvent{0};
+
+    std::atomic<bool> m_frozen{false};
+};
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "sensorhub_core/Biquad.h"
+
+namespace sensorhub::core {
+
+// The INMP441 sends 24-bit samples MSB first in 32-bit I2S slots, so a slot
+// read as int32 is the sample shifted up by this much, with zeros below.
+inline constexpr int kI2sSlotPadBits = 8;
+
+// Shifted back down, a slot is a sample on the 16-bit scale with this much
+// fraction, which is what the loudness filters run on anyway.
+static_assert(kI2sSlotPadBits == kBiquadStateFracBits,
+              "24-bit samples must line up with the biquad state");
+
+// Turns `count` slots into 24-bit samples in place.
+inline void UnpadI2sSlots(int32_t* slots, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        slots[i] >>= kI2sSlotPadBits;
+    }
+}
+
+// Turns `count` slots into 24-bit samples in place and writes them rounded
+// to 16 bits into `out`.
+inline void SplitI2sSlots(int32_t* slots, uint32_t count, int16_t* out) {
+    constexpr int32_t kHalf = 1 << (kI2sSlotPadBits - 1);
+    for (uint32_t i = 0; i < count; ++i) {
+        const int32_t sample = slots[i] >> kI2sSlotPadBits;
+        slots[i] = sample;
+        out[i] = static_cast<int16_t>(std::min<int32_t>(
+            (sample + kHalf) >> kI2sSlotPadBits, INT16_MAX));
+    }
+}
+
+}
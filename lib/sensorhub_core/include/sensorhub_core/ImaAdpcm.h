@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
 
@@ -39,6 +41,197 @@ inline constexpr int kImaIndexTable[16] = {
 inline constexpr uint16_t kImaWavBlockAlign = 256;
 inline constexpr uint16_t kImaWavSamplesPerBlock = 505;
 
+// Samples in a mono block of `blockAlign` bytes: the header sample and two
+// per data byte.
+constexpr std::size_t ImaSamplesPerBlock(std::size_t blockAlign) {
+    return blockAlign < 4 ? 0 : (blockAlign - 4) * 2 + 1;
+}
+
+// RIFF, fact and data length of a WAV streamed before its length is known:
+// the data runs to the end of the stream.
+inline constexpr uint32_t kImaWavStreamingLength = 0xFFFFFFFF;
+
+struct ImaEncodeEntry {
+    uint16_t diffq;
+    uint8_t nextIndex;
+};
+
+// Quantised step and follow-up index for every (index, |code|) pair, so the
+// batch encoder needs one lookup per sample instead of the branch ladder.
+inline constexpr auto kImaEncodeTable = [] {
+    std::array<std::array<ImaEncodeEntry, 8>, 89> table{};
+    for (int index = 0; index < 89; ++index) {
+        const int step = kImaStepTable[index];
+        for (int code = 0; code < 8; ++code) {
+            int diffq = step >> 3;
+            if (code & 4)
+                diffq += step;
+            if (code & 2)
+                diffq += step >> 1;
+            if (code & 1)
+                diffq += step >> 2;
+            const int next =
+                std::clamp(index + kImaIndexTable[code], 0, 88);
+            table[index][code] = {static_cast<uint16_t>(diffq),
+                                  static_cast<uint8_t>(next)};
+        }
+    }
+    return table;
+}();
+
+struct ImaChannelState {
+    int predictor;
+    int index;
+};
+
+inline uint8_t ImaEncodeSampleFast(ImaChannelState& st, int sample) {
+    const int step = kImaStepTable[st.index];
+    int diff = sample - st.predictor;
+    const int sign = diff >> 31;
+    diff = (diff ^ sign) - sign;
+
+    const int b2 = diff >= step;
+    diff -= step & -b2;
+    const int b1 = diff >= (step >> 1);
+    diff -= (step >> 1) & -b1;
+    const int b0 = diff >= (step >> 2);
+    const int magnitude = (b2 << 2) | (b1 << 1) | b0;
+
+    const ImaEncodeEntry& e = kImaEncodeTable[st.index][magnitude];
+    const int diffq = (static_cast<int>(e.diffq) ^ sign) - sign;
+    st.predictor = std::clamp(st.predictor + diffq, -32768, 32767);
+    st.index = e.nextIndex;
+
+    return static_cast<uint8_t>(magnitude | (sign & 8));
+}
+
+// Encodes `count` samples as packed nibbles, low nibble first. Produces
+// exactly the codes of ImaAdpcmEncoder::EncodeSample.
+inline void ImaEncodeNibbles(ImaChannelState& st, const int16_t* samples,
+                             std::size_t count, uint8_t* out) {
+    ImaChannelState local = st;
+    std::size_t i = 0;
+    for (; i + 1 < count; i += 2) {
+        const uint8_t lo = ImaEncodeSampleFast(local, samples[i]);
+        const uint8_t hi = ImaEncodeSampleFast(local, samples[i + 1]);
+        *out++ = static_cast<uint8_t>(lo | (hi << 4));
+    }
+    if (i < count) {
+        *out = ImaEncodeSampleFast(local, samples[i]);
+    }
+    st = local;
+}
+
+// Deepest lookahead ImaEncodeNibblesLookahead() accepts. The search tree
+// triples with each level, though pruning keeps well short of that.
+inline constexpr int kImaMaxSearchDepth = 4;
+
+namespace detail {
+
+inline void ImaApplyCode(ImaChannelState& st, uint8_t code) {
+    const ImaEncodeEntry& e = kImaEncodeTable[st.index][code & 7];
+    const int diffq = code & 8 ? -static_cast<int>(e.diffq) : e.diffq;
+    st.predictor = std::clamp(st.predictor + diffq, -32768, 32767);
+    st.index = e.nextIndex;
+}
+
+// The greedy code and its neighbours in magnitude. Below the smallest step
+// the neighbour is the smallest step of the other sign.
+inline int ImaCandidates(const ImaChannelState& st, int sample,
+                         uint8_t* codes) {
+    ImaChannelState greedy = st;
+    const uint8_t code = ImaEncodeSampleFast(greedy, sample);
+    const uint8_t sign = code & 8;
+    const uint8_t magnitude = code & 7;
+    int n = 0;
+    codes[n++] = code;
+    if (magnitude < 7) {
+        codes[n++] = static_cast<uint8_t>(sign | (magnitude + 1));
+    }
+    codes[n++] = magnitude > 0
+                     ? static_cast<uint8_t>(sign | (magnitude - 1))
+                     : static_cast<uint8_t>(sign ^ 8);
+    return n;
+}
+
+// Smallest squared error over the next `depth` samples from `st`, or
+// something at least `bound` once it is clear the result cannot be lower.
+// The greedy code goes first, so its cost is usually the bound for the
+// other branches.
+inline uint64_t ImaSearchCost(const ImaChannelState& st,
+                              const int16_t* samples, std::size_t count,
+                              int depth, uint64_t bound) {
+    if (depth == 0 || count == 0) {
+        return 0;
+    }
+    uint8_t codes[3];
+    const int n = ImaCandidates(st, samples[0], codes);
+    uint64_t best = bound;
+    for (int c = 0; c < n; ++c) {
+        ImaChannelState next = st;
+        ImaApplyCode(next, codes[c]);
+        const int64_t err = samples[0] - next.predictor;
+        const uint64_t own = static_cast<uint64_t>(err * err);
+        if (own >= best) {
+            continue;
+        }
+        const uint64_t cost =
+            own + ImaSearchCost(
+                      next, samples + 1, count - 1, depth - 1, best - own);
+        best = std::min(best, cost);
+    }
+    return best;
+}
+
+}
+
+// Like ImaEncodeNibbles(), but each code is picked by its squared error
+// plus the smallest error reachable over the following `depth` samples,
+// trying the greedy code and its neighbours at every step. Any IMA decoder
+// reads the result; depth 0 gives the greedy codes.
+inline void ImaEncodeNibblesLookahead(ImaChannelState& st,
+                                      const int16_t* samples,
+                                      std::size_t count, int depth,
+                                      uint8_t* out) {
+    depth = std::clamp(depth, 0, kImaMaxSearchDepth);
+    if (depth == 0) {
+        ImaEncodeNibbles(st, samples, count, out);
+        return;
+    }
+    ImaChannelState local = st;
+    for (std::size_t i = 0; i < count; ++i) {
+        uint8_t codes[3];
+        const int n = detail::ImaCandidates(local, samples[i], codes);
+        uint8_t bestCode = codes[0];
+        uint64_t best = UINT64_MAX;
+        for (int c = 0; c < n; ++c) {
+            ImaChannelState next = local;
+            detail::ImaApplyCode(next, codes[c]);
+            const int64_t err = samples[i] - next.predictor;
+            const uint64_t own = static_cast<uint64_t>(err * err);
+            if (own >= best) {
+                continue;
+            }
+            const uint64_t cost = own + detail::ImaSearchCost(next,
+                                                              samples + i + 1,
+                                                              count - i - 1,
+                                                              depth,
+                                                              best - own);
+            if (cost < best) {
+                best = cost;
+                bestCode = codes[c];
+            }
+        }
+        detail::ImaApplyCode(local, bestCode);
+        if (i % 2 == 0) {
+            out[i / 2] = bestCode;
+        } else {
+            out[i / 2] |= static_cast<uint8_t>(bestCode << 4);
+        }
+    }
+    st = local;
+}
+
 class ImaAdpcmEncoder {
    public:
     ImaAdpcmEncoder() = default;
@@ -57,6 +250,13 @@ class ImaAdpcmEncoder {
         m_index = index;
     }
 
+    // Lookahead of EncodeWavBlock(), 0 (greedy) to kImaMaxSearchDepth.
+    int SearchDepth() const { return m_searchDepth; }
+
+    void SetSearchDepth(int depth) {
+        m_searchDepth = std::clamp(depth, 0, kImaMaxSearchDepth);
+    }
+
     uint8_t EncodeSample(int16_t sample) {
         int diff = sample - m_predictor;
         const int step = kImaStepTable[m_index];
@@ -109,18 +309,41 @@ class ImaAdpcmEncoder {
         return code;
     }
 
+    // Encodes one mono block of `blockAlign` bytes, which takes exactly
+    // ImaSamplesPerBlock(blockAlign) samples.
     bool EncodeWavBlock(const int16_t* samples, std::size_t sample_count,
-                        uint8_t* out) {
-        if (sample_count != kImaWavSamplesPerBlock) {
+                        uint8_t* out,
+                        std::size_t blockAlign = kImaWavBlockAlign) {
+        if (blockAlign < 5 ||
+            sample_count != ImaSamplesPerBlock(blockAlign)) {
             return false;
         }
 
         m_predictor = samples[0];
+        WriteBlockHeader(out);
 
-        out[0] = static_cast<uint8_t>(m_predictor & 0xFF);
-        out[1] = static_cast<uint8_t>((m_predictor >> 8) & 0xFF);
-        out[2] = static_cast<uint8_t>(m_index);
-        out[3] = 0;
+        ImaChannelState st{m_predictor, m_index};
+        ImaEncodeNibblesLookahead(st,
+                                  samples + 1,
+                                  sample_count - 1,
+                                  m_searchDepth,
+                                  out + 4);
+        m_predictor = static_cast<int16_t>(st.predictor);
+        m_index = static_cast<int8_t>(st.index);
+
+        return true;
+    }
+
+    bool EncodeWavBlockReference(const int16_t* samples,
+                                 std::size_t sample_count, uint8_t* out,
+                                 std::size_t blockAlign = kImaWavBlockAlign) {
+        if (blockAlign < 5 ||
+            sample_count != ImaSamplesPerBlock(blockAlign)) {
+            return false;
+        }
+
+        m_predictor = samples[0];
+        WriteBlockHeader(out);
 
         std::size_t out_byte = 4;
         bool high_nibble = false;
@@ -140,8 +363,16 @@ class ImaAdpcmEncoder {
     }
 
    private:
+    void WriteBlockHeader(uint8_t* out) const {
+        out[0] = static_cast<uint8_t>(m_predictor & 0xFF);
+        out[1] = static_cast<uint8_t>((m_predictor >> 8) & 0xFF);
+        out[2] = static_cast<uint8_t>(m_index);
+        out[3] = 0;
+    }
+
     int16_t m_predictor = 0;
     int8_t m_index = 0;
+    int m_searchDepth = 0;
 };
 
 class ImaAdpcmDecoder {
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "sensorhub_core/ImaAdpcm.h"
+
+namespace sensorhub::core {
+
+inline constexpr std::size_t kImaDecodeLanes = 8;
+
+inline void ImaDecodeNibble(int& predictor, int& index, unsigned code) {
+    const ImaEncodeEntry& e = kImaEncodeTable[index][code & 7];
+    const int sign = -static_cast<int>((code >> 3) & 1);
+    const int diffq = (static_cast<int>(e.diffq) ^ sign) - sign;
+    predictor = std::clamp(predictor + diffq, -32768, 32767);
+    index = e.nextIndex;
+}
+
+// Decodes `Lanes` consecutive mono blocks in lock-step. Each block is an
+// independent dependency chain, so interleaving them hides the latency of
+// the predictor update and lets the compiler vectorise across lanes.
+// `out` receives Lanes * ImaSamplesPerBlock(blockAlign) samples.
+template <std::size_t Lanes>
+inline void ImaDecodeBlockLanes(const uint8_t* blocks, std::size_t blockAlign,
+                                int16_t* out) {
+    const std::size_t spb = ImaSamplesPerBlock(blockAlign);
+    int predictor[Lanes];
+    int index[Lanes];
+
+    for (std::size_t lane = 0; lane < Lanes; ++lane) {
+        const uint8_t* block = blocks + lane * blockAlign;
+        predictor[lane] = static_cast<int16_t>(block[0] | (block[1] << 8));
+        index[lane] = std::min<int>(block[2], 88);
+        out[lane * spb] = static_cast<int16_t>(predictor[lane]);
+    }
+
+    for (std::size_t byte = 4; byte < blockAlign; ++byte) {
+        const std::size_t pos = 1 + (byte - 4) * 2;
+        for (std::size_t lane = 0; lane < Lanes; ++lane) {
+            const unsigned packed = blocks[lane * blockAlign + byte];
+            int16_t* dst = out + lane * spb + pos;
+            ImaDecodeNibble(predictor[lane], index[lane], packed & 0x0F);
+            dst[0] = static_cast<int16_t>(predictor[lane]);
+            ImaDecodeNibble(predictor[lane], index[lane], packed >> 4);
+            dst[1] = static_cast<int16_t>(predictor[lane]);
+        }
+    }
+}
+
+inline void ImaDecodeBlocks(const uint8_t* blocks, std::size_t count,
+                            std::size_t blockAlign, int16_t* out) {
+    const std::size_t spb = ImaSamplesPerBlock(blockAlign);
+    std::size_t b = 0;
+    for (; b + kImaDecodeLanes <= count; b += kImaDecodeLanes) {
+        ImaDecodeBlockLanes<kImaDecodeLanes>(blocks + b * blockAlign,
+                                             blockAlign,
+                                             out + b * spb);
+    }
+    for (; b < count; ++b) {
+        ImaDecodeBlockLanes<1>(blocks + b * blockAlign,
+                               blockAlign,
+                               out + b * spb);
+    }
+}
+
+// Splits `count` blocks across `threads` workers. Blocks carry their own
+// predictor and index, so no state crosses a split.
+inline void ImaDecodeBlocksParallel(const uint8_t* blocks, std::size_t count,
+                                    std::size_t blockAlign, int16_t* out,
+                                    unsigned threads) {
+    const std::size_t spb = ImaSamplesPerBlock(blockAlign);
+    const std::size_t minPerThread = 4 * kImaDecodeLanes;
+    threads = static_cast<unsigned>(std::min<std::size_t>(
+        std::max(threads, 1u), std::max<std::size_t>(count / minPerThread, 1)));
+
+    if (threads == 1) {
+        ImaDecodeBlocks(blocks, count, blockAlign, out);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    const std::size_t per = (count + threads - 1) / threads;
+    for (unsigned t = 1; t < threads; ++t) {
+        const std::size_t first = std::min(count, t * per);
+        const std::size_t n = std::min(count - first, per);
+        workers.emplace_back([=] {
+            ImaDecodeBlocks(blocks + first * blockAlign,
+                            n,
+                            blockAlign,
+                            out + first * spb);
+        });
+    }
+    ImaDecodeBlocks(blocks, std::min(count, per), blockAlign, out);
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+}
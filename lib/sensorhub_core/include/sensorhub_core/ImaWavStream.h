@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "sensorhub_core/ImaAdpcmBatch.h"
+
+namespace sensorhub::core {
+
+struct ImaWavFormat {
+    uint32_t sampleRate = 0;
+    uint16_t channelCount = 0;
+    uint16_t blockAlign = 0;
+    uint16_t samplesPerBlock = 0;
+    uint32_t numSamples = 0;
+    uint32_t dataLength = 0;
+};
+
+// Push parser for mono IMA ADPCM WAV streams (RIFF / fmt / fact / data).
+// Whole blocks are handed to the sink straight from the caller's buffer;
+// only a block split across two Feed() calls is copied into a one-block
+// carry buffer. Unknown chunks are skipped, a trailing partial block is
+// dropped. A data chunk of kImaWavStreamingLength is read until Finish().
+class ImaWavStreamParser {
+   public:
+    enum class Status : uint8_t { NeedMore, Done, Error };
+
+    static constexpr uint16_t kMaxBlockAlign = 8192;
+
+    const ImaWavFormat& Format() const { return m_format; }
+
+    bool HasFormat() const { return m_format.blockAlign != 0; }
+
+    uint32_t BlocksEmitted() const { return m_blocksEmitted; }
+
+    // Input bytes parsed so far. Once a fixed-length stream is Done, any
+    // input past this point belongs to whatever follows it.
+    uint64_t BytesConsumed() const { return m_consumed; }
+
+    // Sink: void(const uint8_t* blocks, std::size_t blockCount).
+    template <typename Sink>
+    Status Feed(const uint8_t* data, std::size_t len, Sink&& sink) {
+        while (len > 0 && m_status == Status::NeedMore) {
+            std::size_t used = 0;
+            switch (m_stage) {
+                case Stage::Riff:
+                    used = Collect(data, len, 12);
+                    if (m_have == 12) {
+                        if (std::memcmp(m_hdr, "RIFF", 4) != 0 ||
+                            std::memcmp(m_hdr + 8, "WAVE", 4) != 0) {
+                            return Fail();
+                        }
+                        m_have = 0;
+                        m_stage = Stage::ChunkHeader;
+                    }
+                    break;
+                case Stage::ChunkHeader:
+                    used = Collect(data, len, 8);
+                    if (m_have == 8 && !BeginChunk()) {
+                        return Fail();
+                    }
+                    break;
+                case Stage::ChunkBody:
+                    used = Collect(data, len, m_chunkSize);
+                    if (m_have == m_chunkSize && !EndChunk()) {
+                        return Fail();
+                    }
+                    break;
+                case Stage::Skip:
+                    used = static_cast<std::size_t>(
+                        std::min<uint64_t>(m_skip, len));
+                    m_skip -= used;
+                    if (m_skip == 0) {
+                        m_have = 0;
+                        m_stage = Stage::ChunkHeader;
+                    }
+                    break;
+                case Stage::Data:
+                    used = ConsumeData(data, len, sink);
+                    break;
+            }
+            data += used;
+            len -= used;
+            m_consumed += used;
+        }
+        return m_status;
+    }
+
+    // Marks the end of the input. Completes a streamed data chunk, filling
+    // in the lengths actually received; any other unfinished stream is an
+    // error.
+    Status Finish() {
+        if (m_status != Status::NeedMore) {
+            return m_status;
+        }
+        if (m_stage != Stage::Data ||
+            m_format.dataLength != kImaWavStreamingLength) {
+            return Fail();
+        }
+        m_format.dataLength = m_blocksEmitted * m_format.blockAlign;
+        m_format.numSamples = m_blocksEmitted * m_format.samplesPerBlock;
+        m_carried = 0;
+        m_status = Status::Done;
+        return m_status;
+    }
+
+   private:
+    enum class Stage : uint8_t { Riff, ChunkHeader, ChunkBody, Skip, Data };
+
+    static constexpr std::size_t kHeaderBytes = 64;
+
+    static uint16_t Le16(const uint8_t* p) {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    static uint32_t Le32(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) |
+               (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) |
+               (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    Status Fail() {
+        m_status = Status::Error;
+        return m_status;
+    }
+
+    std::size_t Collect(const uint8_t* data, std::size_t len,
+                        std::size_t want) {
+        const std::size_t n = std::min(len, want - m_have);
+        std::memcpy(m_hdr + m_have, data, n);
+        m_have += n;
+        return n;
+    }
+
+    bool BeginChunk() {
+        const uint32_t size = Le32(m_hdr + 4);
+        m_have = 0;
+
+        if (std::memcmp(m_hdr, "data", 4) == 0) {
+            if (!HasFormat()) {
+                return false;
+            }
+            m_format.dataLength = size;
+            m_remaining = size;
+            m_stage = Stage::Data;
+            if (size == 0) {
+                m_status = Status::Done;
+            }
+            return true;
+        }
+
+        if (std::memcmp(m_hdr, "fmt ", 4) == 0 ||
+            std::memcmp(m_hdr, "fact", 4) == 0) {
+            if (size > kHeaderBytes || size < 4) {
+                return false;
+            }
+            m_chunkIsFmt = m_hdr[1] == 'm';
+            m_chunkSize = size;
+            m_stage = Stage::ChunkBody;
+            return true;
+        }
+
+        m_skip = static_cast<uint64_t>(size) + (size & 1);
+        m_stage = m_skip == 0 ? Stage::ChunkHeader : Stage::Skip;
+        return true;
+    }
+
+    bool EndChunk() {
+        if (m_chunkIsFmt) {
+            if (m_chunkSize < 16 || !ParseFmt()) {
+                return false;
+            }
+        } else {
+            m_format.numSamples = Le32(m_hdr);
+        }
+        m_have = 0;
+        m_skip = m_chunkSize & 1;
+        m_stage = m_skip == 0 ? Stage::ChunkHeader : Stage::Skip;
+        return true;
+    }
+
+    bool ParseFmt() {
+        const uint16_t formatTag = Le16(m_hdr);
+        const uint16_t channels = Le16(m_hdr + 2);
+        const uint16_t blockAlign = Le16(m_hdr + 12);
+        const uint16_t bits = Le16(m_hdr + 14);
+        const uint16_t expectedSpb =
+            static_cast<uint16_t>(ImaSamplesPerBlock(blockAlign));
+
+        if (formatTag != 0x0011 || channels != 1 || bits != 4 ||
+            blockAlign < 5 || blockAlign > kMaxBlockAlign) {
+            return false;
+        }
+
+        uint16_t spb = expectedSpb;
+        if (m_chunkSize >= 20) {
+            spb = Le16(m_hdr + 18);
+        }
+        if (spb != expectedSpb) {
+            return false;
+        }
+
+        m_format.channelCount = channels;
+        m_format.sampleRate = Le32(m_hdr + 4);
+        m_format.blockAlign = blockAlign;
+        m_format.samplesPerBlock = spb;
+        m_carry.assign(blockAlign, 0);
+        return true;
+    }
+
+    template <typename Sink>
+    std::size_t ConsumeData(const uint8_t* data, std::size_t len,
+                            Sink& sink) {
+        const std::size_t blockAlign = m_format.blockAlign;
+        std::size_t avail =
+            static_cast<std::size_t>(std::min<uint64_t>(len, m_remaining));
+        std::size_t used = 0;
+
+        if (m_carried > 0) {
+            const std::size_t n = std::min(avail, blockAlign - m_carried);
+            std::memcpy(m_carry.data() + m_carried, data, n);
+            m_carried += n;
+            used += n;
+            avail -= n;
+            if (m_carried == blockAlign) {
+                sink(static_cast<const uint8_t*>(m_carry.data()),
+                     std::size_t{1});
+                ++m_blocksEmitted;
+                m_carried = 0;
+            }
+        }
+
+        const std::size_t whole = avail / blockAlign;
+        if (whole > 0) {
+            sink(data + used, whole);
+            m_blocksEmitted += static_cast<uint32_t>(whole);
+            used += whole * blockAlign;
+            avail -= whole * blockAlign;
+        }
+
+        if (avail > 0) {
+            std::memcpy(m_carry.data(), data + used, avail);
+            m_carried = avail;
+            used += avail;
+        }
+
+        m_remaining -= used;
+        if (m_remaining == 0) {
+            m_carried = 0;
+            m_status = Status::Done;
+        }
+        return used;
+    }
+
+    ImaWavFormat m_format;
+    Status m_status = Status::NeedMore;
+    uint64_t m_consumed = 0;
+    Stage m_stage = Stage::Riff;
+
+    uint8_t m_hdr[kHeaderBytes] = {};
+    std::size_t m_have = 0;
+    uint32_t m_chunkSize = 0;
+    bool m_chunkIsFmt = false;
+    uint64_t m_skip = 0;
+
+    uint64_t m_remaining = 0;
+    std::vector<uint8_t> m_carry;
+    std::size_t m_carried = 0;
+    uint32_t m_blocksEmitted = 0;
+};
+
+}
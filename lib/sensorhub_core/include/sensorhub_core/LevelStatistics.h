@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+#include "sensorhub_core/LoudnessMath.h"
+
+namespace sensorhub::core {
+
+// Per-interval level statistics in constant memory: Leq from the exact
+// accumulated energy, Lmax, and exceedance levels (L10 / L50 / L90) from a
+// fixed quarter-dB histogram of the time-weighted level. Add() is O(1) and
+// never allocates; Exceeded() walks the histogram once.
+class LevelStatistics {
+   public:
+    static constexpr float kMinDb = 0.0f;
+    static constexpr int kBinsPerDb = 4;
+    static constexpr int kBinCount = 128 * kBinsPerDb;
+
+    void Reset() {
+        m_bins.fill(0);
+        m_observations = 0;
+        m_energy = 0;
+        m_samples = 0;
+        m_max = std::numeric_limits<float>::lowest();
+    }
+
+    // `levelDb` is the time-weighted level after this block; `sumSquares`
+    // and `count` are the block's weighted energy for Leq.
+    void Add(float levelDb, uint64_t sumSquares, uint32_t count) {
+        const int bin =
+            std::clamp(static_cast<int>((levelDb - kMinDb) * kBinsPerDb),
+                       0,
+                       kBinCount - 1);
+        ++m_bins[bin];
+        ++m_observations;
+        m_max = std::max(m_max, levelDb);
+
+        m_energy = sumSquares > UINT64_MAX - m_energy ? UINT64_MAX
+                                                      : m_energy + sumSquares;
+        m_samples += count;
+    }
+
+    uint32_t Observations() const { return m_observations; }
+
+    float Leq() const { return SplFromSumOfSquares(m_energy, m_samples); }
+
+    float Max() const { return m_observations ? m_max : 0.0f; }
+
+    // Level exceeded for `percent` of the observations (L10 = Exceeded(10)),
+    // interpolated inside the bin. 0 when empty.
+    float Exceeded(float percent) const {
+        if (m_observations == 0) {
+            return 0.0f;
+        }
+        const float target = static_cast<float>(m_observations) *
+                             std::clamp(percent, 0.0f, 100.0f) / 100.0f;
+        uint32_t above = 0;
+        for (int bin = kBinCount - 1; bin >= 0; --bin) {
+            const uint32_t n = m_bins[bin];
+            if (n > 0 && static_cast<float>(above + n) >= target) {
+                const float frac = (target - static_cast<float>(above)) /
+                                   static_cast<float>(n);
+                return kMinDb +
+                       (static_cast<float>(bin + 1) - frac) / kBinsPerDb;
+            }
+            above += n;
+        }
+        return kMinDb;
+    }
+
+   private:
+    std::array<uint32_t, kBinCount> m_bins{};
+    uint32_t m_observations = 0;
+    uint64_t m_energy = 0;
+    uint64_t m_samples = 0;
+    float m_max = std::numeric_limits<float>::lowest();
+};
+
+}
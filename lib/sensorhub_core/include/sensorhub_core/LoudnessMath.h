@@ -1,6 +1,9 @@
 #pragma once
 
+#include <array>
+#include <bit>
 #include <cmath>
+#include <cstdint>
 
 namespace sensorhub::core {
 
@@ -30,4 +33,106 @@ inline float RmsToSpl(float rms, float amplitude) {
     return 0.0f;
 }
 
+namespace detail {
+
+constexpr double ConstexprLog2(double x) {
+    int exponent = 0;
+    while (x >= 2.0) {
+        x /= 2.0;
+        ++exponent;
+    }
+    while (x < 1.0) {
+        x *= 2.0;
+        --exponent;
+    }
+    const double z = (x - 1.0) / (x + 1.0);
+    const double z2 = z * z;
+    double term = z;
+    double ln = 0.0;
+    for (int k = 1; k < 60; k += 2) {
+        ln += term / k;
+        term *= z2;
+    }
+    constexpr double kLn2 = 0.693147180559945309417;
+    return exponent + 2.0 * ln / kLn2;
+}
+
+inline constexpr int kLog2TableBits = 8;
+
+inline constexpr auto kLog2FracTable = [] {
+    std::array<uint32_t, (1u << kLog2TableBits) + 1> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        const double x = 1.0 + static_cast<double>(i) / (1u << kLog2TableBits);
+        table[i] = static_cast<uint32_t>(ConstexprLog2(x) * 65536.0 + 0.5);
+    }
+    return table;
+}();
+
+constexpr double kTenLog10Two = 3.01029995663981195214;
+
+constexpr double kSplOffsetDb =
+    kInmp441SensitivityDb - 2.0 * kTenLog10Two * ConstexprLog2(32767.0) +
+    kInmp441ReferenceSpl + kInmp441OffsetDb;
+
+}
+
+// log2(x) in Q16.16 for x > 0; table lookup with linear interpolation,
+// max error about 3e-6.
+inline int32_t Log2Q16(uint64_t x) {
+    if (x == 0) {
+        return INT32_MIN;
+    }
+    const int msb = 63 - std::countl_zero(x);
+    const uint32_t mantissa =
+        msb >= 31 ? static_cast<uint32_t>(x >> (msb - 31))
+                  : static_cast<uint32_t>(x << (31 - msb));
+
+    constexpr int kFracBits = 31 - detail::kLog2TableBits;
+    const uint32_t idx =
+        (mantissa >> kFracBits) & ((1u << detail::kLog2TableBits) - 1);
+    const uint32_t frac = mantissa & ((1u << kFracBits) - 1);
+    const uint32_t lo = detail::kLog2FracTable[idx];
+    const uint32_t hi = detail::kLog2FracTable[idx + 1];
+    const uint32_t interp =
+        lo + static_cast<uint32_t>(
+                 (static_cast<uint64_t>(hi - lo) * frac) >> kFracBits);
+
+    return (msb << 16) + static_cast<int32_t>(interp);
+}
+
+// 10 * log10(sumSquares / count) in Q16.16, i.e. the mean power in dB
+// relative to one LSB squared.
+inline int32_t MeanPowerDbQ16(uint64_t sumSquares, uint64_t count) {
+    if (sumSquares == 0 || count == 0) {
+        return INT32_MIN;
+    }
+    constexpr int64_t kScaleQ24 =
+        static_cast<int64_t>(detail::kTenLog10Two * (1 << 24) + 0.5);
+    const int64_t log2Ratio =
+        static_cast<int64_t>(Log2Q16(sumSquares)) - Log2Q16(count);
+    return static_cast<int32_t>((log2Ratio * kScaleQ24) >> 24);
+}
+
+// Same result as RmsToSpl(CalculateRms(pcm), FullScaleAmplitude16Bit())
+// without the floor/peak gate, computed from an integer sum of squares.
+// Returns 0 for silence.
+inline float SplFromSumOfSquares(uint64_t sumSquares, uint64_t count) {
+    const int32_t powerQ16 = MeanPowerDbQ16(sumSquares, count);
+    if (powerQ16 == INT32_MIN) {
+        return 0.0f;
+    }
+    constexpr int32_t kOffsetQ16 =
+        static_cast<int32_t>(detail::kSplOffsetDb * 65536.0 + 0.5);
+    return static_cast<float>(powerQ16 + kOffsetQ16) / 65536.0f;
+}
+
+// SplFromSumOfSquares() for an already averaged mean square in LSB^2.
+inline float SplFromMeanSquare(float meanSquare) {
+    if (!(meanSquare > 0.0f)) {
+        return 0.0f;
+    }
+    return 10.0f * std::log10(meanSquare) +
+           static_cast<float>(detail::kSplOffsetDb);
+}
+
 }
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <numbers>
+
+#include "sensorhub_core/Biquad.h"
+#include "sensorhub_core/HalfbandDecimator.h"
+
+namespace sensorhub::core {
+
+// Decimate-by-M low-pass FIR (M = 1 to 4) for int16 audio, split into M
+// polyphase branches of kTapsPerPhase taps each. Input sample i feeds
+// branch (-i mod M), and one output is the sum of all branches once every
+// M inputs, so each output costs kTapsPerPhase * M multiplies and nothing
+// is computed for the samples that are thrown away.
+//
+// The prototype is a Kaiser-windowed sinc cut off at half the output rate.
+// With 32 taps per phase it is flat to 0.43 of the output rate and 70 dB
+// down from 0.57, so only the top of the output band carries any alias.
+// Coefficients are Q30 like the biquads.
+class PolyphaseDecimator {
+   public:
+    static constexpr int kTapsPerPhase = 32;
+    static constexpr int kMaxFactor = 4;
+
+    explicit PolyphaseDecimator(int factor = 1, double kaiserBeta = 7.0)
+        : m_factor(std::clamp(factor, 1, kMaxFactor)) {
+        Design(kaiserBeta);
+    }
+
+    int Factor() const { return m_factor; }
+
+    int Taps() const { return kTapsPerPhase * m_factor; }
+
+    void Reset() {
+        for (auto& branch : m_history) {
+            branch.fill(0);
+        }
+        m_pos = 0;
+        m_phase = 0;
+    }
+
+    // Decimates `count` input samples into `out` and returns the number of
+    // samples written; a partial period carries over to the next call.
+    // `out` may be `in`.
+    uint32_t Process(const int16_t* in, uint32_t count, int16_t* out) {
+        if (m_factor == 1) {
+            if (out != in) {
+                std::memmove(out, in, count * sizeof(int16_t));
+            }
+            return count;
+        }
+
+        uint32_t written = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (m_phase == 0) {
+                m_pos = m_pos == 0 ? kTapsPerPhase - 1 : m_pos - 1;
+            }
+            auto& branch = m_history[m_factor - 1 - m_phase];
+            branch[m_pos] = in[i];
+            branch[m_pos + kTapsPerPhase] = in[i];
+            if (++m_phase < m_factor) {
+                continue;
+            }
+            m_phase = 0;
+
+            int64_t acc = 0;
+            for (int p = 0; p < m_factor; ++p) {
+                const int16_t* w = m_history[p].data() + m_pos;
+                const int32_t* h = m_coeffs[p].data();
+                for (int j = 0; j < kTapsPerPhase; ++j) {
+                    acc += static_cast<int64_t>(h[j]) * w[j];
+                }
+            }
+            const int64_t y =
+                (acc + (int64_t{1} << (kBiquadCoeffBits - 1))) >>
+                kBiquadCoeffBits;
+            out[written++] = static_cast<int16_t>(
+                std::clamp<int64_t>(y, INT16_MIN, INT16_MAX));
+        }
+        return written;
+    }
+
+    // Magnitude response in dB at `f` cycles per input sample, from the
+    // quantised coefficients.
+    double ResponseDb(double f) const {
+        constexpr double kScale = 1.0 / (1 << kBiquadCoeffBits);
+        std::complex<double> h = 0.0;
+        for (int k = 0; k < Taps(); ++k) {
+            h += m_coeffs[k % m_factor][k / m_factor] * kScale *
+                 std::polar(1.0, -2.0 * std::numbers::pi * f * k);
+        }
+        return 20.0 * std::log10(std::abs(h));
+    }
+
+   private:
+    // Tap k of the prototype is tap k / M of branch k % M.
+    void Design(double beta) {
+        const int taps = Taps();
+        const double cutoff = 0.5 / m_factor;
+        const double centre = (taps - 1) / 2.0;
+        std::array<double, kTapsPerPhase * kMaxFactor> proto{};
+        double sum = 0.0;
+        for (int k = 0; k < taps; ++k) {
+            const double t = k - centre;
+            const double x = 2.0 * cutoff * t;
+            const double sinc =
+                x == 0.0 ? 1.0
+                         : std::sin(std::numbers::pi * x) /
+                               (std::numbers::pi * x);
+            const double r = t / (centre + 0.5);
+            const double window =
+                BesselI0(beta * std::sqrt(1.0 - r * r)) / BesselI0(beta);
+            proto[k] = sinc * window;
+            sum += proto[k];
+        }
+        for (int k = 0; k < taps; ++k) {
+            m_coeffs[k % m_factor][k / m_factor] = QuantiseQ30(proto[k] / sum);
+        }
+    }
+
+    int m_factor;
+    std::array<std::array<int32_t, kTapsPerPhase>, kMaxFactor> m_coeffs{};
+    std::array<std::array<int16_t, 2 * kTapsPerPhase>, kMaxFactor>
+        m_history{};
+    int m_pos = 0;
+    int m_phase = 0;
+};
+
+}
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace sensorhub::core {
+
+// CRC-32 (IEEE, reflected), nibble table.
+inline uint32_t Crc32(const uint8_t* data, std::size_t len,
+                      uint32_t crc = 0) {
+    static constexpr uint32_t kTable[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    crc = ~crc;
+    for (std::size_t i = 0; i < len; ++i) {
+        crc = kTable[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = kTable[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+struct SpoolEvent {
+    uint32_t id = 0;
+    uint32_t preRoll = 0;
+    uint32_t sampleRate = 0;
+    uint32_t blocks = 0;
+    // Gain the event was recorded with, for the uploader to pass on.
+    int32_t gainDb = 0;
+};
+
+// Append-only ring of recordings on a raw flash partition.
+//
+// Every sector is one header block followed by whole data blocks, and is
+// written in a single sector-aligned write once the RAM sector buffer is
+// full (or the event ends), so flash is touched once per `BlocksPerSector`
+// blocks. A sector is as many kSectorBytes flash sectors as it takes to
+// hold at least three data blocks, so large blocks do not leave most of
+// the flash to headers. Each header names its event and carries a CRC of
+// the sector, so Mount() rebuilds the index by reading the headers back:
+// nothing else is stored and a torn write only loses its own sector. When
+// the ring is full the oldest whole event is erased to make room; a sector
+// is erased as soon as its event is removed, so writes rarely wait on an
+// erase.
+//
+// Flash: bool Read(uint32_t offset, void* dst, uint32_t len);
+//        bool Write(uint32_t offset, const void* src, uint32_t len);
+//        bool Erase(uint32_t offset, uint32_t len);
+// with NOR semantics (erased bytes read 0xFF).
+template <typename Flash>
+class RecordingSpool {
+   public:
+    static constexpr uint32_t kSectorBytes = 4096;
+
+    RecordingSpool(Flash& flash, uint32_t sizeBytes, uint16_t blockBytes)
+        : m_flash(flash),
+          m_blockBytes(blockBytes),
+          m_sectorBytes(SpoolSectorBytes(blockBytes)),
+          m_blocksPerSector(m_sectorBytes / blockBytes - 1),
+          m_slots(sizeBytes / m_sectorBytes),
+          m_sector(m_sectorBytes) {}
+
+    // Bytes in one spool sector for blocks of `blockBytes`.
+    static constexpr uint32_t SpoolSectorBytes(uint16_t blockBytes) {
+        const uint32_t flashSectors =
+            (4u * blockBytes + kSectorBytes - 1) / kSectorBytes;
+        return (flashSectors > 0 ? flashSectors : 1) * kSectorBytes;
+    }
+
+    RecordingSpool(const RecordingSpool&) = delete;
+    RecordingSpool& operator=(const RecordingSpool&) = delete;
+
+    uint32_t SectorCount() const {
+        return static_cast<uint32_t>(m_slots.size());
+    }
+
+    uint32_t SectorBytes() const { return m_sectorBytes; }
+
+    uint32_t BlocksPerSector() const { return m_blocksPerSector; }
+
+    // Events removed to make room for newer ones.
+    uint32_t DroppedEvents() const { return m_droppedEvents; }
+
+    // Blocks not stored because a single event outgrew the whole spool.
+    uint32_t DroppedBlocks() const { return m_droppedBlocks; }
+
+    // Rebuilds the index from the sector headers. Sectors that fail their
+    // CRC are erased before reuse.
+    bool Mount() {
+        m_sequence = 0;
+        m_lastEvent = 0;
+        m_cursor = 0;
+        m_writing = false;
+        bool any = false;
+        for (uint32_t i = 0; i < SectorCount(); ++i) {
+            Slot& slot = m_slots[i];
+            slot = {};
+            Header header;
+            if (!m_flash.Read(Offset(i), &header, sizeof(header))) {
+                return false;
+            }
+            if (header.magic == 0xFFFFFFFF) {
+                continue;
+            }
+            if (!m_flash.Read(Offset(i), m_sector.data(), m_sectorBytes)) {
+                return false;
+            }
+            if (!Valid(header)) {
+                slot.state = State::Dirty;
+                continue;
+            }
+            slot = {State::Used,
+                    header.sequence,
+                    header.event,
+                    header.preRoll,
+                    header.sampleRate,
+                    header.gainDb,
+                    header.index,
+                    header.blocks};
+            if (!any || header.sequence - m_sequence < 0x80000000u) {
+                m_sequence = header.sequence;
+                m_cursor = i + 1 == SectorCount() ? 0 : i + 1;
+            }
+            if (!any || header.event - m_lastEvent < 0x80000000u) {
+                m_lastEvent = header.event;
+            }
+            any = true;
+        }
+        m_sequence += any ? 1 : 0;
+        return true;
+    }
+
+    // Events stored and not being written.
+    uint32_t PendingEvents() const {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < SectorCount(); ++i) {
+            const Slot& slot = m_slots[i];
+            if (slot.state != State::Used || Writing(slot.event)) {
+                continue;
+            }
+            bool first = true;
+            for (uint32_t j = 0; j < i && first; ++j) {
+                first = m_slots[j].state != State::Used ||
+                        m_slots[j].event != slot.event;
+            }
+            count += first ? 1 : 0;
+        }
+        return count;
+    }
+
+    bool BeginEvent(uint32_t preRoll, uint32_t sampleRate,
+                    int32_t gainDb = 0) {
+        if (m_writing || m_slots.empty()) {
+            return false;
+        }
+        m_writing = true;
+        m_writeEvent = ++m_lastEvent;
+        m_writePreRoll = preRoll;
+        m_writeRate = sampleRate;
+        m_writeGain = gainDb;
+        m_writeIndex = 0;
+        m_buffered = 0;
+        m_truncated = false;
+        return true;
+    }
+
+    // Buffers one block; a full sector is written out at once.
+    bool Append(const uint8_t* block) {
+        if (!m_writing || m_truncated) {
+            ++m_droppedBlocks;
+            return false;
+        }
+        std::memcpy(m_sector.data() + (m_buffered + 1) * m_blockBytes,
+                    block,
+                    m_blockBytes);
+        if (++m_buffered == m_blocksPerSector) {
+            return FlushSector();
+        }
+        return true;
+    }
+
+    bool EndEvent() {
+        if (!m_writing) {
+            return false;
+        }
+        const bool ok = m_buffered == 0 || m_truncated || FlushSector();
+        m_writing = false;
+        return ok;
+    }
+
+    // Oldest stored event that is not being written. `blocks` counts the
+    // sectors that survive in order from the first; it is 0 if the first
+    // was lost, and such an event can only be removed.
+    bool OldestEvent(SpoolEvent& out) const {
+        bool found = false;
+        for (const Slot& slot : m_slots) {
+            if (slot.state != State::Used || Writing(slot.event)) {
+                continue;
+            }
+            if (!found || slot.event - out.id >= 0x80000000u) {
+                out = {slot.event,
+                       slot.preRoll,
+                       slot.sampleRate,
+                       0,
+                       slot.gainDb};
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        for (uint32_t index = 0;; ++index) {
+            const uint32_t i = Find(out.id, index);
+            if (i == kNone) {
+                break;
+            }
+            out.blocks += m_slots[i].blocks;
+            if (m_slots[i].blocks < m_blocksPerSector) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    // Reads block `block` of `event` straight from flash.
+    bool ReadBlock(const SpoolEvent& event, uint32_t block, uint8_t* out) {
+        const uint32_t i = Find(event.id, block / m_blocksPerSector);
+        const uint32_t at = block % m_blocksPerSector;
+        if (i == kNone || at >= m_slots[i].blocks) {
+            return false;
+        }
+        return m_flash.Read(Offset(i) + (at + 1) * m_blockBytes,
+                            out,
+                            m_blockBytes);
+    }
+
+    // Erases every sector of `event`, e.g. once it has been uploaded.
+    bool Remove(const SpoolEvent& event) {
+        bool ok = true;
+        for (uint32_t i = 0; i < SectorCount(); ++i) {
+            if (m_slots[i].state == State::Used &&
+                m_slots[i].event == event.id) {
+                ok = EraseSlot(i) && ok;
+            }
+        }
+        return ok;
+    }
+
+   private:
+    static constexpr uint32_t kMagic = 0x4C505333;  // "3SPL"
+
+    struct Header {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t event;
+        uint32_t preRoll;
+        uint32_t sampleRate;
+        int32_t gainDb;
+        uint16_t index;
+        uint16_t blocks;
+        uint32_t crc;
+    };
+
+    enum class State : uint8_t { Free, Used, Dirty };
+
+    struct Slot {
+        State state = State::Free;
+        uint32_t sequence = 0;
+        uint32_t event = 0;
+        uint32_t preRoll = 0;
+        uint32_t sampleRate = 0;
+        int32_t gainDb = 0;
+        uint16_t index = 0;
+        uint16_t blocks = 0;
+    };
+
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    uint32_t Offset(uint32_t slot) const { return slot * m_sectorBytes; }
+
+    uint32_t Find(uint32_t event, uint32_t index) const {
+        for (uint32_t i = 0; i < SectorCount(); ++i) {
+            const Slot& slot = m_slots[i];
+            if (slot.state == State::Used && slot.event == event &&
+                slot.index == index) {
+                return i;
+            }
+        }
+        return kNone;
+    }
+
+    bool Writing(uint32_t event) const {
+        return m_writing && event == m_writeEvent;
+    }
+
+    // CRC over the header (crc field zeroed) and the sector's blocks, as
+    // held in m_sector.
+    uint32_t SectorCrc(const Header& header) const {
+        Header copy = header;
+        copy.crc = 0;
+        const uint32_t crc = Crc32(reinterpret_cast<const uint8_t*>(&copy),
+                                   sizeof(copy));
+        return Crc32(m_sector.data() + m_blockBytes,
+                     static_cast<std::size_t>(header.blocks) * m_blockBytes,
+                     crc);
+    }
+
+    bool Valid(const Header& header) const {
+        return header.magic == kMagic && header.blocks > 0 &&
+               header.blocks <= m_blocksPerSector &&
+               SectorCrc(header) == header.crc;
+    }
+
+    bool EraseSlot(uint32_t i) {
+        m_slots[i] = {};
+        return m_flash.Erase(Offset(i), m_sectorBytes);
+    }
+
+    // Frees the cursor sector, dropping the oldest event if it is there.
+    bool MakeRoom() {
+        const Slot& slot = m_slots[m_cursor];
+        if (slot.state == State::Free) {
+            return true;
+        }
+        if (slot.state == State::Used) {
+            if (Writing(slot.event)) {
+                return false;
+            }
+            ++m_droppedEvents;
+            return Remove(SpoolEvent{slot.event, 0, 0, 0});
+        }
+        return EraseSlot(m_cursor);
+    }
+
+    bool FlushSector() {
+        if (!MakeRoom()) {
+            m_droppedBlocks += m_buffered;
+            m_buffered = 0;
+            m_truncated = true;
+            return false;
+        }
+
+        Header header{kMagic,
+                      m_sequence,
+                      m_writeEvent,
+                      m_writePreRoll,
+                      m_writeRate,
+                      m_writeGain,
+                      static_cast<uint16_t>(m_writeIndex),
+                      static_cast<uint16_t>(m_buffered),
+                      0};
+        header.crc = SectorCrc(header);
+        std::memset(m_sector.data(), 0xFF, m_blockBytes);
+        std::memcpy(m_sector.data(), &header, sizeof(header));
+        const std::size_t used = (m_buffered + 1) * m_blockBytes;
+        std::memset(m_sector.data() + used, 0xFF, m_sectorBytes - used);
+
+        const uint32_t at = m_cursor;
+        m_slots[at] = {State::Used,
+                       m_sequence,
+                       m_writeEvent,
+                       m_writePreRoll,
+                       m_writeRate,
+                       m_writeGain,
+                       header.index,
+                       header.blocks};
+        ++m_sequence;
+        ++m_writeIndex;
+        m_buffered = 0;
+        m_cursor = at + 1 == SectorCount() ? 0 : at + 1;
+        if (!m_flash.Write(Offset(at), m_sector.data(), m_sectorBytes)) {
+            m_slots[at].state = State::Dirty;
+            m_truncated = true;
+            return false;
+        }
+        return true;
+    }
+
+    Flash& m_flash;
+    const uint16_t m_blockBytes;
+    const uint32_t m_sectorBytes;
+    const uint32_t m_blocksPerSector;
+    std::vector<Slot> m_slots;
+    std::vector<uint8_t> m_sector;
+
+    uint32_t m_sequence = 0;
+    uint32_t m_lastEvent = 0;
+    uint32_t m_cursor = 0;
+    uint32_t m_droppedEvents = 0;
+    uint32_t m_droppedBlocks = 0;
+
+    bool m_writing = false;
+    bool m_truncated = false;
+    uint32_t m_writeEvent = 0;
+    uint32_t m_writePreRoll = 0;
+    uint32_t m_writeRate = 0;
+    int32_t m_writeGain = 0;
+    uint32_t m_writeIndex = 0;
+    uint32_t m_buffered = 0;
+};
+
+}
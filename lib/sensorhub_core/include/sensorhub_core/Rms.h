@@ -2,22 +2,49 @@
 
 #include <cmath>
 #include <cstdint>
+#include <type_traits>
 
 namespace sensorhub::core {
 
+inline uint64_t SumOfSquares(const int16_t* input, uint32_t size) {
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+        const int32_t s = input[i];
+        sum += static_cast<uint32_t>(s * s);
+    }
+    return sum;
+}
+
+// SumOfSquares() for 24-bit samples on the 16-bit scale with 8 bits of
+// fraction, rounded to LSB^2 of 16 bits.
+inline uint64_t SumOfSquaresQ8(const int32_t* input, uint32_t size) {
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+        const int64_t s = input[i];
+        sum += static_cast<uint64_t>(s * s);
+    }
+    return (sum + (1u << 15)) >> 16;
+}
+
 template <typename T>
 inline float CalculateRms(const T* input, uint32_t size) {
     if (size == 0) {
         return 0.0f;
     }
 
-    float sumSquares = 0.0f;
-    for (uint32_t i = 0; i < size; ++i) {
-        const float sample = static_cast<float>(input[i]);
-        sumSquares += sample * sample;
-    }
+    if constexpr (std::is_same_v<T, int16_t>) {
+        const double mean = static_cast<double>(SumOfSquares(input, size)) /
+                            static_cast<double>(size);
+        return static_cast<float>(std::sqrt(mean));
+    } else {
+        float sumSquares = 0.0f;
+        for (uint32_t i = 0; i < size; ++i) {
+            const float sample = static_cast<float>(input[i]);
+            sumSquares += sample * sample;
+        }
 
-    return std::sqrt(sumSquares / static_cast<float>(size));
+        return std::sqrt(sumSquares / static_cast<float>(size));
+    }
 }
 
 }
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+namespace sensorhub::core {
+
+// One-pole DC blocker, y[n] = x[n] - x[n-1] + (1 - 2^-k) y[n-1], for int16
+// audio. The pole is a shift, picked so the -3 dB point, fs / (2 pi 2^k),
+// is the power of two nearest the requested cut-off; 20 Hz comes out at
+// 19.9 Hz for 32, 16 and 8 kHz alike. `y` is held with kFracBits of
+// fraction, so the truncated shift leaves less than 2^(k - kFracBits) LSB
+// of DC behind.
+class DcBlocker {
+   public:
+    static constexpr int kFracBits = 12;
+
+    explicit DcBlocker(uint32_t sampleRateHz = 16000, double cutoffHz = 20.0)
+        : m_shift(std::clamp(
+              static_cast<int>(std::lround(std::log2(
+                  sampleRateHz / (2.0 * std::numbers::pi * cutoffHz)))),
+              1,
+              15)) {}
+
+    int Shift() const { return m_shift; }
+
+    double CutoffHz(uint32_t sampleRateHz) const {
+        return sampleRateHz / (2.0 * std::numbers::pi * (1 << m_shift));
+    }
+
+    // The next sample starts the filter as if the input had always been
+    // at that level, so there is no step at start-up.
+    void Reset() { m_primed = false; }
+
+    // One output sample; it may be past the int16 range right after a
+    // step.
+    int32_t Step(int32_t x) {
+        if (!m_primed) {
+            m_x1 = x;
+            m_acc = 0;
+            m_primed = true;
+        }
+        m_acc += (x - m_x1) * (1 << kFracBits) - (m_acc >> m_shift);
+        m_x1 = x;
+        return (m_acc + (1 << (kFracBits - 1))) >> kFracBits;
+    }
+
+    // `out` may be `in`.
+    void Process(const int16_t* in, uint32_t count, int16_t* out) {
+        for (uint32_t i = 0; i < count; ++i) {
+            out[i] = static_cast<int16_t>(
+                std::clamp<int32_t>(Step(in[i]), INT16_MIN, INT16_MAX));
+        }
+    }
+
+   private:
+    int m_shift;
+    int32_t m_x1 = 0;
+    int32_t m_acc = 0;
+    bool m_primed = false;
+};
+
+struct AgcConfig {
+    // Gain is in whole dB from 0 to maxGainDb; 30 at most.
+    int maxGainDb = 24;
+    // Peak the gain aims for. The level it is set from is the loudest
+    // recent audio, and the room above the target is what a louder event
+    // has before it clips. IMA ADPCM codes best around this level.
+    int32_t targetPeak = 2048;
+    // Blocks for the level to fall by 1/e after a loud one, rounded down
+    // to a power of two.
+    uint32_t releaseBlocks = 1024;
+};
+
+// Slow automatic gain for audio that is coded after it. Every block is
+// measured before the gain by its peak; the level follows a louder block
+// at once and falls back over `releaseBlocks`. The gain only moves when
+// Settle() is called, so the caller picks the points where a change cannot
+// fall inside one recording, and every block in between is scaled by the
+// same GainDb() and can be scaled back.
+class BlockAgc {
+   public:
+    static constexpr int kMaxGainDb = 30;
+    static constexpr int kGainFracBits = 10;
+
+    explicit BlockAgc(const AgcConfig& config = {})
+        : m_maxGainDb(std::clamp(config.maxGainDb, 0, kMaxGainDb)),
+          m_targetPeak(std::clamp<int32_t>(config.targetPeak, 1, INT16_MAX)),
+          m_releaseShift(
+              static_cast<int>(std::bit_width(
+                  std::max<uint32_t>(config.releaseBlocks, 1))) -
+              1) {}
+
+    int GainDb() const { return m_gainDb; }
+
+    // Gain as a multiplier with kGainFracBits of fraction.
+    int32_t GainQ() const { return m_gainQ; }
+
+    // Peak level the next Settle() works from.
+    int32_t Level() const { return m_level >> kLevelFracBits; }
+
+    // Takes the pre-gain peak of one block.
+    void Track(int32_t peak) {
+        m_level -= m_level >> m_releaseShift;
+        m_level = std::max(m_level, std::min(peak, kPeakLimit)
+                                        << kLevelFracBits);
+    }
+
+    // Sets the gain that brings Level() closest to the target without
+    // passing it, and returns it.
+    int Settle() {
+        const int32_t level = Level();
+        const int gain =
+            level == 0 ? m_maxGainDb
+                       : static_cast<int>(std::floor(
+                             20.0 * std::log10(static_cast<double>(
+                                                   m_targetPeak) /
+                                               level)));
+        SetGainDb(gain);
+        return m_gainDb;
+    }
+
+    void SetGainDb(int db) {
+        m_gainDb = std::clamp(db, 0, m_maxGainDb);
+        m_gainQ = static_cast<int32_t>(std::lround(
+            std::pow(10.0, m_gainDb / 20.0) * (1 << kGainFracBits)));
+    }
+
+    // `y` must be within the int16 range; the result is clipped to it.
+    int16_t Scale(int32_t y) const {
+        const int32_t scaled =
+            (y * m_gainQ + (1 << (kGainFracBits - 1))) >> kGainFracBits;
+        return static_cast<int16_t>(
+            std::clamp<int32_t>(scaled, INT16_MIN, INT16_MAX));
+    }
+
+   private:
+    static constexpr int kLevelFracBits = 8;
+    static constexpr int32_t kPeakLimit = 32768;
+
+    int m_maxGainDb;
+    int32_t m_targetPeak;
+    int m_releaseShift;
+    int32_t m_level = 0;
+    int m_gainDb = 0;
+    int32_t m_gainQ = 1 << kGainFracBits;
+};
+
+// DC blocker and AGC in one pass over a block, in place. Coding a block
+// with no DC offset and at a level that uses the coder's range keeps the
+// ADPCM step size working on the signal rather than on the offset or on
+// the bottom of its step table.
+class SignalConditioner {
+   public:
+    SignalConditioner(uint32_t sampleRateHz, double dcCutoffHz,
+                      const AgcConfig& agc)
+        : m_dc(sampleRateHz, dcCutoffHz), m_agc(agc) {}
+
+    const DcBlocker& Dc() const { return m_dc; }
+
+    BlockAgc& Agc() { return m_agc; }
+
+    const BlockAgc& Agc() const { return m_agc; }
+
+    void Process(int16_t* pcm, uint32_t count) {
+        int32_t peak = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            const int32_t y =
+                std::clamp<int32_t>(m_dc.Step(pcm[i]), INT16_MIN, INT16_MAX);
+            peak = std::max(peak, y < 0 ? -y : y);
+            pcm[i] = m_agc.Scale(y);
+        }
+        m_agc.Track(peak);
+    }
+
+   private:
+    DcBlocker m_dc;
+    BlockAgc m_agc;
+};
+
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "sensorhub_core/ImaAdpcm.h"
+
+namespace sensorhub::core {
+
+struct SilenceConfig {
+    // A block whose level is within this of the noise floor, or below it,
+    // is quiet.
+    float marginDb = 6.0f;
+    // Quiet blocks in a row that are kept before the rest of the run is
+    // left out, so that a sound dies away and short pauses stay.
+    uint32_t holdBlocks = 8;
+};
+
+// Picks the blocks of an event that can go as silence: those past the
+// first `holdBlocks` of a run of quiet ones.
+class SilenceGate {
+   public:
+    explicit SilenceGate(const SilenceConfig& config = {})
+        : m_marginDb(config.marginDb), m_holdBlocks(config.holdBlocks) {}
+
+    void Reset() { m_run = 0; }
+
+    // Takes one block's level and the noise floor, both in dB, and returns
+    // true if the block can be left out.
+    bool Update(float levelDb, float floorDb) {
+        if (levelDb > floorDb + m_marginDb) {
+            m_run = 0;
+            return false;
+        }
+        ++m_run;
+        return m_run > m_holdBlocks;
+    }
+
+   private:
+    float m_marginDb;
+    uint32_t m_holdBlocks;
+    uint32_t m_run = 0;
+};
+
+// A silence run stands in the data chunk of an IMA ADPCM WAV for that many
+// blocks of silence, between whole blocks:
+//
+//   0xFF 0xFF 0xFF 0xFF   tag
+//   uint32 LE             run length in blocks
+//
+// The third byte of a block is its step index, at most 88, so no block can
+// be read as a run.
+inline constexpr std::size_t kSilenceRunBytes = 8;
+inline constexpr uint8_t kSilenceRunTag = 0xFF;
+
+inline void WriteSilenceRun(uint32_t blocks, uint8_t* out) {
+    std::memset(out, kSilenceRunTag, 4);
+    for (int i = 0; i < 4; ++i) {
+        out[4 + i] = static_cast<uint8_t>(blocks >> (8 * i));
+    }
+}
+
+// Rebuilds standard IMA ADPCM WAVs, with exact RIFF, fact and data
+// lengths, from an upload body of one or more such WAVs back to back, any
+// of them with silence runs and the last one possibly streamed. Every run
+// becomes its length in all-zero blocks, which decode to digital silence.
+// A trailing partial block is dropped, as by ImaWavStreamParser. The WAVs
+// go to `wav` back to back in the same order. Returns false, with `wav`
+// undefined, for anything that is not a series of mono IMA ADPCM WAVs or
+// would not fit 4 GB.
+inline bool ExpandSilenceRuns(const uint8_t* stream, std::size_t len,
+                              std::vector<uint8_t>& wav) {
+    const auto le16 = [](const uint8_t* p) {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    };
+    const auto le32 = [](const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) |
+               (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) |
+               (static_cast<uint32_t>(p[3]) << 24);
+    };
+    const auto put32 = [&wav](std::size_t at, uint32_t v) {
+        for (int i = 0; i < 4; ++i) {
+            wav[at + i] = static_cast<uint8_t>(v >> (8 * i));
+        }
+    };
+
+    wav.clear();
+    std::size_t at = 0;
+    do {
+        const std::size_t start = at;
+        if (len - at < 12 || std::memcmp(stream + at, "RIFF", 4) != 0 ||
+            std::memcmp(stream + at + 8, "WAVE", 4) != 0) {
+            return false;
+        }
+        at += 12;
+
+        std::size_t blockAlign = 0;
+        std::size_t factAt = 0;
+        uint32_t dataLength = 0;
+        for (;;) {
+            if (len - at < 8) {
+                return false;
+            }
+            const uint32_t size = le32(stream + at + 4);
+            if (std::memcmp(stream + at, "data", 4) == 0) {
+                dataLength = size;
+                at += 8;
+                break;
+            }
+            const std::size_t padded =
+                static_cast<std::size_t>(size) + (size & 1);
+            if (len - at - 8 < padded) {
+                return false;
+            }
+            if (std::memcmp(stream + at, "fmt ", 4) == 0) {
+                const uint8_t* fmt = stream + at + 8;
+                if (size < 16 || le16(fmt) != 0x0011 || le16(fmt + 2) != 1 ||
+                    le16(fmt + 14) != 4) {
+                    return false;
+                }
+                blockAlign = le16(fmt + 12);
+            } else if (std::memcmp(stream + at, "fact", 4) == 0 &&
+                       size >= 4) {
+                factAt = wav.size() + at - start + 8;
+            }
+            at += 8 + padded;
+        }
+        if (blockAlign < 5) {
+            return false;
+        }
+
+        // Data past a streamed length, or past the end, runs to the end.
+        const bool exact = dataLength != kImaWavStreamingLength &&
+                           dataLength <= len - at;
+        const std::size_t end = exact ? at + dataLength : len;
+        const std::size_t riffAt = wav.size();
+        wav.insert(wav.end(), stream + start, stream + at);
+        const std::size_t dataAt = wav.size();
+        uint64_t blocks = 0;
+        while (end - at >= 3) {
+            if (stream[at + 2] == kSilenceRunTag) {
+                if (end - at < kSilenceRunBytes) {
+                    break;
+                }
+                const uint32_t run = le32(stream + at + 4);
+                if ((blocks + run) * blockAlign + dataAt - riffAt >
+                    UINT32_MAX) {
+                    return false;
+                }
+                wav.resize(
+                    wav.size() + static_cast<std::size_t>(run) * blockAlign, 0);
+                blocks += run;
+                at += kSilenceRunBytes;
+                continue;
+            }
+            if (end - at < blockAlign) {
+                break;
+            }
+            if ((blocks + 1) * blockAlign + dataAt - riffAt > UINT32_MAX) {
+                return false;
+            }
+            wav.insert(wav.end(), stream + at, stream + at + blockAlign);
+            ++blocks;
+            at += blockAlign;
+        }
+
+        put32(riffAt + 4, static_cast<uint32_t>(wav.size() - riffAt - 8));
+        put32(dataAt - 4, static_cast<uint32_t>(blocks * blockAlign));
+        if (factAt != 0) {
+            put32(factAt, static_cast<uint32_t>(
+                              blocks * ImaSamplesPerBlock(blockAlign)));
+        }
+        at = exact ? end : len;
+        if (exact && (dataLength & 1) != 0 && at < len) {
+            ++at;
+        }
+    } while (at < len);
+    return true;
+}
+
+}
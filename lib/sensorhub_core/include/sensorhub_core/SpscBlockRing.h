@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace sensorhub::core {
+
+// Wait-free single-producer/single-consumer ring of fixed-size blocks.
+//
+// The producer owns `head` at all times. Ownership of `tail` follows the
+// state: the producer owns it while Idle (to slide the pre-roll window),
+// the consumer owns it otherwise. Every hand-over goes through a release
+// store on `m_state`, so neither side ever needs a lock.
+//
+// Indices run over [0, 2 * capacity) so that full and empty are
+// distinguishable without a spare slot or a division.
+class SpscBlockRing {
+   public:
+    enum class State : uint8_t { Idle, Recording, PostCaptureDrain };
+
+    SpscBlockRing(uint8_t* backing, uint16_t blockBytes,
+                  uint32_t capacityBlocks, uint32_t preRollBlocks)
+        : m_buf(backing),
+          m_blockBytes(blockBytes),
+          m_capacity(capacityBlocks),
+          m_preRoll(preRollBlocks < capacityBlocks ? preRollBlocks
+                                                   : capacityBlocks) {}
+
+    SpscBlockRing(const SpscBlockRing&) = delete;
+    SpscBlockRing& operator=(const SpscBlockRing&) = delete;
+
+    uint16_t BlockBytes() const { return m_blockBytes; }
+
+    uint32_t Capacity() const { return m_capacity; }
+
+    State CurrentState() const {
+        return m_state.load(std::memory_order_acquire);
+    }
+
+    uint32_t PostRollProduced() const {
+        return m_postRollProduced.load(std::memory_order_acquire);
+    }
+
+    uint32_t DroppedDuringRecording() const {
+        return m_droppedDuringRecording.load(std::memory_order_acquire);
+    }
+
+    uint32_t Size() const {
+        return Distance(m_head.load(std::memory_order_acquire),
+                        m_tail.load(std::memory_order_acquire));
+    }
+
+    // Producer. Slot for the next block while Idle, nullptr otherwise.
+    uint8_t* ReserveOverwrite() {
+        if (m_state.load(std::memory_order_acquire) != State::Idle) {
+            return nullptr;
+        }
+        return SlotPtr(m_head.load(std::memory_order_relaxed));
+    }
+
+    // Producer. Publishes the reserved slot, keeping the newest pre-roll
+    // window.
+    void CommitOverwrite() {
+        const uint32_t next = Advance(m_head.load(std::memory_order_relaxed));
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (Distance(next, tail) > m_preRoll) {
+            m_tail.store(Advance(tail), std::memory_order_relaxed);
+        }
+        m_head.store(next, std::memory_order_release);
+    }
+
+    // Producer. Slot for the next block while Recording and not full,
+    // nullptr otherwise. A full ring counts as a dropped block.
+    uint8_t* ReservePreserve() {
+        if (m_state.load(std::memory_order_acquire) != State::Recording) {
+            return nullptr;
+        }
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        const uint32_t tail = m_tail.load(std::memory_order_acquire);
+        if (Distance(head, tail) >= m_capacity) {
+            m_droppedDuringRecording.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return SlotPtr(head);
+    }
+
+    // Producer. Publishes the slot returned by ReservePreserve().
+    void CommitPreserve() {
+        m_head.store(Advance(m_head.load(std::memory_order_relaxed)),
+                     std::memory_order_release);
+        m_postRollProduced.fetch_add(1, std::memory_order_release);
+    }
+
+    void PushOverwrite(const uint8_t* block) {
+        uint8_t* slot = ReserveOverwrite();
+        if (slot == nullptr) {
+            return;
+        }
+        std::memcpy(slot, block, m_blockBytes);
+        CommitOverwrite();
+    }
+
+    bool PushPreserve(const uint8_t* block) {
+        uint8_t* slot = ReservePreserve();
+        if (slot == nullptr) {
+            return false;
+        }
+        std::memcpy(slot, block, m_blockBytes);
+        CommitPreserve();
+        return true;
+    }
+
+    // Consumer. Oldest unread block, valid until ReleaseFront().
+    const uint8_t* PeekFront() const {
+        if (m_state.load(std::memory_order_acquire) == State::Idle) {
+            return nullptr;
+        }
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        const uint32_t head = m_head.load(std::memory_order_acquire);
+        if (head == tail) {
+            return nullptr;
+        }
+        return SlotPtr(tail);
+    }
+
+    // Consumer. Returns the slot from PeekFront() to the producer.
+    void ReleaseFront() {
+        m_tail.store(Advance(m_tail.load(std::memory_order_relaxed)),
+                     std::memory_order_release);
+    }
+
+    bool Pop(uint8_t* outBlock) {
+        const uint8_t* block = PeekFront();
+        if (block == nullptr) {
+            return false;
+        }
+        std::memcpy(outBlock, block, m_blockBytes);
+        ReleaseFront();
+        return true;
+    }
+
+    // Producer. Returns the pre-roll depth, or 0 if not Idle.
+    uint32_t BeginRecording() {
+        if (m_state.load(std::memory_order_acquire) != State::Idle) {
+            return 0;
+        }
+        const uint32_t preRoll =
+            Distance(m_head.load(std::memory_order_relaxed),
+                     m_tail.load(std::memory_order_relaxed));
+        m_droppedDuringRecording.store(0, std::memory_order_relaxed);
+        m_postRollProduced.store(0, std::memory_order_relaxed);
+
+        State expected = State::Idle;
+        if (!m_state.compare_exchange_strong(expected,
+                                             State::Recording,
+                                             std::memory_order_acq_rel)) {
+            return 0;
+        }
+        return preRoll;
+    }
+
+    // Producer. Loses against a concurrent EndRecording().
+    void MarkPostRollDone() {
+        State expected = State::Recording;
+        m_state.compare_exchange_strong(expected,
+                                        State::PostCaptureDrain,
+                                        std::memory_order_acq_rel);
+    }
+
+    // Consumer. Discards whatever was not popped and hands `tail` back to
+    // the producer. A block pushed concurrently survives as pre-roll.
+    void EndRecording() {
+        m_tail.store(m_head.load(std::memory_order_acquire),
+                     std::memory_order_relaxed);
+        m_postRollProduced.store(0, std::memory_order_relaxed);
+        m_state.store(State::Idle, std::memory_order_release);
+    }
+
+   private:
+    static constexpr std::size_t kIndexAlign = 64;
+
+    uint8_t* SlotPtr(uint32_t index) const {
+        const uint32_t slot = index >= m_capacity ? index - m_capacity : index;
+        return m_buf + static_cast<std::size_t>(slot) * m_blockBytes;
+    }
+
+    uint32_t Advance(uint32_t index) const {
+        return index + 1 == 2 * m_capacity ? 0 : index + 1;
+    }
+
+    uint32_t Distance(uint32_t head, uint32_t tail) const {
+        return head >= tail ? head - tail : head + 2 * m_capacity - tail;
+    }
+
+    uint8_t* const m_buf;
+    const uint16_t m_blockBytes;
+    const uint32_t m_capacity;
+    const uint32_t m_preRoll;
+
+    std::atomic<State> m_state{State::Idle};
+    std::atomic<uint32_t> m_postRollProduced{0};
+    std::atomic<uint32_t> m_droppedDuringRecording{0};
+
+    alignas(kIndexAlign) std::atomic<uint32_t> m_head{0};
+    alignas(kIndexAlign) std::atomic<uint32_t> m_tail{0};
+};
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace sensorhub::core {
+
+// Wait-free single-producer/single-consumer queue of fixed-size chunks,
+// for handing capture buffers from one core to another without copying.
+//
+// The producer fills the slot from Acquire() in place and publishes it; the
+// consumer works on the slot from Front() in place and releases it. A full
+// queue never blocks the producer: Acquire() returns nullptr and counts an
+// overrun, and the producer is expected to drop that chunk.
+//
+// Indices run over [0, 2 * capacity) so that full and empty are
+// distinguishable without a spare slot or a division.
+template <typename T>
+class SpscChunkQueue {
+   public:
+    SpscChunkQueue(T* backing, uint32_t chunkItems, uint32_t capacityChunks)
+        : m_buf(backing),
+          m_chunkItems(chunkItems),
+          m_capacity(capacityChunks) {}
+
+    SpscChunkQueue(const SpscChunkQueue&) = delete;
+    SpscChunkQueue& operator=(const SpscChunkQueue&) = delete;
+
+    uint32_t ChunkItems() const { return m_chunkItems; }
+
+    uint32_t Capacity() const { return m_capacity; }
+
+    // Chunks published and not yet released.
+    uint32_t Depth() const {
+        return Distance(m_head.load(std::memory_order_acquire),
+                        m_tail.load(std::memory_order_acquire));
+    }
+
+    // Deepest the queue has been right after a publish.
+    uint32_t MaxDepth() const {
+        return m_maxDepth.load(std::memory_order_relaxed);
+    }
+
+    // Chunks the producer had no room for.
+    uint32_t Overruns() const {
+        return m_overruns.load(std::memory_order_relaxed);
+    }
+
+    uint32_t Published() const {
+        return m_published.load(std::memory_order_relaxed);
+    }
+
+    // Producer. True if Acquire() would return nullptr; not an overrun.
+    bool Full() const {
+        return Distance(m_head.load(std::memory_order_relaxed),
+                        m_tail.load(std::memory_order_acquire)) >= m_capacity;
+    }
+
+    // Producer. Slot for the next chunk, or nullptr if the queue is full
+    // (counted as an overrun). Until Publish(), asking again returns the
+    // same slot.
+    T* Acquire() {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        const uint32_t tail = m_tail.load(std::memory_order_acquire);
+        if (Distance(head, tail) >= m_capacity) {
+            m_overruns.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return SlotPtr(head);
+    }
+
+    // Producer. Hands the slot from Acquire() to the consumer.
+    void Publish() {
+        const uint32_t head =
+            Advance(m_head.load(std::memory_order_relaxed));
+        m_head.store(head, std::memory_order_release);
+        const uint32_t depth =
+            Distance(head, m_tail.load(std::memory_order_acquire));
+        if (depth > m_maxDepth.load(std::memory_order_relaxed)) {
+            m_maxDepth.store(depth, std::memory_order_relaxed);
+        }
+        m_published.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Consumer. Oldest published chunk, valid until Release(), or nullptr
+    // if there is none.
+    T* Front() {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (m_head.load(std::memory_order_acquire) == tail) {
+            return nullptr;
+        }
+        return SlotPtr(tail);
+    }
+
+    // Consumer. Returns the slot from Front() to the producer.
+    void Release() {
+        m_tail.store(Advance(m_tail.load(std::memory_order_relaxed)),
+                     std::memory_order_release);
+    }
+
+   private:
+    static constexpr std::size_t kIndexAlign = 64;
+
+    T* SlotPtr(uint32_t index) const {
+        const uint32_t slot = index >= m_capacity ? index - m_capacity : index;
+        return m_buf + static_cast<std::size_t>(slot) * m_chunkItems;
+    }
+
+    uint32_t Advance(uint32_t index) const {
+        return index + 1 == 2 * m_capacity ? 0 : index + 1;
+    }
+
+    uint32_t Distance(uint32_t head, uint32_t tail) const {
+        return head >= tail ? head - tail : head + 2 * m_capacity - tail;
+    }
+
+    T* const m_buf;
+    const uint32_t m_chunkItems;
+    const uint32_t m_capacity;
+
+    // Written by the producer only.
+    std::atomic<uint32_t> m_maxDepth{0};
+    std::atomic<uint32_t> m_overruns{0};
+    std::atomic<uint32_t> m_published{0};
+
+    alignas(kIndexAlign) std::atomic<uint32_t> m_head{0};
+    alignas(kIndexAlign) std::atomic<uint32_t> m_tail{0};
+};
+
+}
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace sensorhub::core {
+
+struct RingEvent {
+    // Ring index of the first pre-roll block.
+    uint32_t start = 0;
+    uint32_t preRoll = 0;
+};
+
+// Single-producer/single-consumer block ring that never stops capturing.
+//
+// The producer writes every block. While no event is queued it owns `tail`
+// and slides it to keep the newest pre-roll window, like SpscBlockRing in
+// Idle. QueueEvent() pins that window and every block after it until the
+// producer calls CloseEvent(), so events can run for any length and the
+// consumer streams them while they are still being captured. `tail` moves
+// to the consumer; blocks keep flowing in behind it, so an event that fires
+// while the previous one is still uploading gets its full pre-roll from the
+// blocks captured since the previous one closed. The consumer hands `tail`
+// back when it finishes the last queued event.
+//
+// The consumer can pin the blocks of the open event it has read, so that
+// it can go back and read them again if sending them failed. Pinned blocks
+// only ever fill the pre-roll window's worth of the ring; past that the
+// oldest are let go, and the room behind it stays free for blocks the
+// consumer has yet to read.
+//
+// Memory is bounded by the ring itself and by kMaxEvents queued events.
+// When either is exhausted, blocks or whole events are dropped and counted
+// rather than overwriting data that is still queued.
+class SpscEventRing {
+   public:
+    static constexpr uint32_t kMaxEvents = 4;
+
+    SpscEventRing(uint8_t* backing, uint16_t blockBytes,
+                  uint32_t capacityBlocks, uint32_t preRollBlocks)
+        : m_buf(backing),
+          m_blockBytes(blockBytes),
+          m_capacity(capacityBlocks),
+          m_preRoll(std::min(preRollBlocks, capacityBlocks - 1)) {}
+
+    SpscEventRing(const SpscEventRing&) = delete;
+    SpscEventRing& operator=(const SpscEventRing&) = delete;
+
+    uint16_t BlockBytes() const { return m_blockBytes; }
+
+    uint32_t Capacity() const { return m_capacity; }
+
+    uint32_t PreRollBlocks() const { return m_preRoll; }
+
+    uint32_t Size() const {
+        return Distance(m_head.load(std::memory_order_acquire),
+                        m_tail.load(std::memory_order_acquire));
+    }
+
+    // Events queued and not yet finished by the consumer, including the
+    // one being read.
+    uint32_t QueuedEvents() const {
+        return m_pending.load(std::memory_order_acquire);
+    }
+
+    // Blocks not captured because queued events filled the ring.
+    uint32_t DroppedBlocks() const {
+        return m_droppedBlocks.load(std::memory_order_acquire);
+    }
+
+    // Events not queued because the queue or the ring was full.
+    uint32_t DroppedEvents() const {
+        return m_droppedEvents.load(std::memory_order_acquire);
+    }
+
+    // Producer. True between QueueEvent() and CloseEvent().
+    bool Capturing() const { return m_capturing; }
+
+    // Producer. Blocks of the capturing event so far, pre-roll included.
+    uint32_t CapturedBlocks() const { return m_captured; }
+
+    // Producer. Slot for the next block, or nullptr if queued events fill
+    // the ring (counted as a dropped block).
+    uint8_t* Reserve() {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (m_pending.load(std::memory_order_acquire) > 0 &&
+            Distance(head, m_tail.load(std::memory_order_acquire)) >=
+                m_capacity) {
+            m_droppedBlocks.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return SlotPtr(head);
+    }
+
+    // Producer. Publishes the slot returned by Reserve().
+    void Commit() {
+        const uint32_t next = Advance(m_head.load(std::memory_order_relaxed));
+        if (m_pending.load(std::memory_order_acquire) == 0) {
+            const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+            if (Distance(next, tail) > m_preRoll) {
+                m_tail.store(Retreat(next, m_preRoll),
+                             std::memory_order_relaxed);
+            }
+        }
+        m_head.store(next, std::memory_order_release);
+        if (m_capturing) {
+            ++m_captured;
+        }
+    }
+
+    bool Push(const uint8_t* block) {
+        uint8_t* slot = Reserve();
+        if (slot == nullptr) {
+            return false;
+        }
+        std::memcpy(slot, block, m_blockBytes);
+        Commit();
+        return true;
+    }
+
+    // Producer. Pre-roll blocks QueueEvent() would give an event now.
+    uint32_t PreRollDepth() const {
+        const uint32_t retained =
+            m_pending.load(std::memory_order_acquire) == 0
+                ? m_tail.load(std::memory_order_relaxed)
+                : m_lastEnd;
+        return std::min(m_preRoll,
+                        Distance(m_head.load(std::memory_order_relaxed),
+                                 retained));
+    }
+
+    // Producer. Opens an event starting up to the pre-roll window before
+    // the next block; it never reaches back into the previous event.
+    // Returns false while Capturing() and, counting a dropped event, when
+    // the queue or the ring is full.
+    bool QueueEvent(uint32_t& preRoll) {
+        if (Capturing()) {
+            return false;
+        }
+        const uint32_t pending = m_pending.load(std::memory_order_acquire);
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (pending >= kMaxEvents ||
+            (pending > 0 &&
+             Distance(head, m_tail.load(std::memory_order_acquire)) >=
+                 m_capacity)) {
+            m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        const uint32_t retained =
+            pending == 0 ? m_tail.load(std::memory_order_relaxed) : m_lastEnd;
+        const uint32_t depth = std::min(m_preRoll, Distance(head, retained));
+
+        m_events[m_eventHead] = {Retreat(head, depth), depth};
+        m_eventBlocks[m_eventHead].store(kOpen, std::memory_order_relaxed);
+        m_captureSlot = m_eventHead;
+        m_eventHead = m_eventHead + 1 == kMaxEvents ? 0 : m_eventHead + 1;
+        m_capturing = true;
+        m_captured = depth;
+        m_pending.fetch_add(1, std::memory_order_release);
+
+        preRoll = depth;
+        return true;
+    }
+
+    // Producer. Ends the capturing event after the last committed block.
+    void CloseEvent() {
+        if (!m_capturing) {
+            return;
+        }
+        m_capturing = false;
+        m_lastEnd = m_head.load(std::memory_order_relaxed);
+        m_eventBlocks[m_captureSlot].store(m_captured,
+                                           std::memory_order_release);
+    }
+
+    // Consumer. Opens the oldest queued event, skipping any blocks between
+    // the previous event and its pre-roll. Returns the open event again
+    // until FinishEvent(); false if none is queued.
+    bool BeginEvent(RingEvent& out) {
+        if (!m_open) {
+            if (m_pending.load(std::memory_order_acquire) == 0) {
+                return false;
+            }
+            m_current = m_events[m_eventTail];
+            m_read = 0;
+            m_open = true;
+            m_pinning = false;
+            m_front = m_current.start;
+            m_tail.store(m_current.start, std::memory_order_release);
+        }
+        out = m_current;
+        return true;
+    }
+
+    // Consumer. True once the open event is closed and fully read, or if
+    // no event is open.
+    bool EventDone() const {
+        return !m_open || m_read == m_eventBlocks[m_eventTail].load(
+                                        std::memory_order_acquire);
+    }
+
+    // Consumer. Blocks of the open event released so far.
+    uint32_t EventRead() const { return m_read; }
+
+    // Consumer. Next block of the open event, valid until ReleaseFront().
+    const uint8_t* PeekFront() const {
+        if (EventDone()) {
+            return nullptr;
+        }
+        if (m_head.load(std::memory_order_acquire) == m_front) {
+            return nullptr;
+        }
+        return SlotPtr(m_front);
+    }
+
+    // Consumer. Moves past the block from PeekFront() and returns it to
+    // the producer, or keeps it pinned after PinEvent().
+    void ReleaseFront() {
+        m_front = Advance(m_front);
+        ++m_read;
+        if (!m_pinning) {
+            m_tail.store(m_front, std::memory_order_release);
+            return;
+        }
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        const uint32_t held = Distance(m_head.load(std::memory_order_acquire),
+                                       tail);
+        if (held > m_preRoll) {
+            const uint32_t unpin = std::min(held - m_preRoll,
+                                            Distance(m_front, tail));
+            m_tail.store(Advance(tail, unpin), std::memory_order_release);
+        }
+    }
+
+    // Consumer. Keeps the blocks of the open event read from now on in the
+    // ring until RewindPinned() or FinishEvent().
+    void PinEvent() {
+        if (m_open) {
+            m_pinning = true;
+        }
+    }
+
+    // Consumer. Blocks read and still pinned.
+    uint32_t Pinned() const {
+        return Distance(m_front, m_tail.load(std::memory_order_relaxed));
+    }
+
+    // Consumer. Stops pinning and goes back to the oldest pinned block, so
+    // reading starts again from there. Returns its index in the event.
+    uint32_t RewindPinned() {
+        m_read -= Pinned();
+        m_front = m_tail.load(std::memory_order_relaxed);
+        m_pinning = false;
+        return m_read;
+    }
+
+    bool Pop(uint8_t* outBlock) {
+        const uint8_t* block = PeekFront();
+        if (block == nullptr) {
+            return false;
+        }
+        std::memcpy(outBlock, block, m_blockBytes);
+        ReleaseFront();
+        return true;
+    }
+
+    // Consumer. Closes the open event, read to the end or not. Closing the
+    // last queued one hands `tail` back to the producer.
+    void FinishEvent() {
+        if (!m_open) {
+            return;
+        }
+        m_open = false;
+        m_pinning = false;
+        m_tail.store(m_front, std::memory_order_release);
+        m_eventTail = m_eventTail + 1 == kMaxEvents ? 0 : m_eventTail + 1;
+        m_pending.fetch_sub(1, std::memory_order_release);
+    }
+
+   private:
+    static constexpr std::size_t kIndexAlign = 64;
+
+    uint8_t* SlotPtr(uint32_t index) const {
+        const uint32_t slot = index >= m_capacity ? index - m_capacity : index;
+        return m_buf + static_cast<std::size_t>(slot) * m_blockBytes;
+    }
+
+    uint32_t Advance(uint32_t index, uint32_t by = 1) const {
+        return index + by >= 2 * m_capacity ? index + by - 2 * m_capacity
+                                            : index + by;
+    }
+
+    uint32_t Retreat(uint32_t index, uint32_t by) const {
+        return index >= by ? index - by : index + 2 * m_capacity - by;
+    }
+
+    uint32_t Distance(uint32_t head, uint32_t tail) const {
+        return head >= tail ? head - tail : head + 2 * m_capacity - tail;
+    }
+
+    uint8_t* const m_buf;
+    const uint16_t m_blockBytes;
+    const uint32_t m_capacity;
+    const uint32_t m_preRoll;
+
+    static constexpr uint32_t kOpen = UINT32_MAX;
+
+    std::array<RingEvent, kMaxEvents> m_events{};
+    std::array<std::atomic<uint32_t>, kMaxEvents> m_eventBlocks{};
+    std::atomic<uint32_t> m_pending{0};
+    std::atomic<uint32_t> m_droppedBlocks{0};
+    std::atomic<uint32_t> m_droppedEvents{0};
+
+    // Producer only.
+    uint32_t m_eventHead = 0;
+    uint32_t m_captureSlot = 0;
+    bool m_capturing = false;
+    uint32_t m_captured = 0;
+    uint32_t m_lastEnd = 0;
+
+    // Consumer only.
+    uint32_t m_eventTail = 0;
+    RingEvent m_current;
+    uint32_t m_read = 0;
+    bool m_open = false;
+    bool m_pinning = false;
+    uint32_t m_front = 0;
+
+    alignas(kIndexAlign) std::atomic<uint32_t> m_head{0};
+    alignas(kIndexAlign) std::atomic<uint32_t> m_tail{0};
+};
+
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <numbers>
+
+#include "sensorhub_core/Biquad.h"
+#include "sensorhub_core/HalfbandDecimator.h"
+#include "sensorhub_core/LoudnessMath.h"
+
+namespace sensorhub::core {
+
+inline constexpr int kThirdOctaveBandCount = 24;
+
+// Nominal IEC 61260 mid-band frequencies, 50 Hz to 10 kHz.
+inline constexpr std::array<uint16_t, kThirdOctaveBandCount>
+    kThirdOctaveNominalHz = {50,   63,   80,   100,  125,  160,  200,  250,
+                             315,  400,  500,  630,  800,  1000, 1250, 1600,
+                             2000, 2500, 3150, 4000, 5000, 6300, 8000, 10000};
+
+// Exact base-two mid-band frequency of band `i` (0 = 50 Hz).
+inline double ThirdOctaveCentreHz(int band) {
+    return 1000.0 * std::exp2((band - 13) / 3.0);
+}
+
+// Per-band energy, summed in LSB^2 at each band's own sample rate.
+struct BandEnergies {
+    std::array<uint64_t, kThirdOctaveBandCount> energy{};
+    std::array<uint64_t, kThirdOctaveBandCount> samples{};
+
+    void Reset() {
+        energy.fill(0);
+        samples.fill(0);
+    }
+
+    void Add(const BandEnergies& other) {
+        for (int b = 0; b < kThirdOctaveBandCount; ++b) {
+            energy[b] += other.energy[b];
+            samples[b] += other.samples[b];
+        }
+    }
+
+    // Band level in dB SPL on the INMP441 scale; 0 when empty or silent.
+    float Level(int band) const {
+        return SplFromSumOfSquares(energy[band], samples[band]);
+    }
+};
+
+// Multirate 1/3-octave filter bank. Each octave stage runs three 6th-order
+// Butterworth band-passes (three Q30 biquads each) and hands a halfband-
+// decimated signal to the next stage down. Because every stage sits at the
+// same place relative to its own sample rate, all stages share one set of
+// coefficients, and the whole bank costs about twice the top octave.
+//
+// The top band is the highest one whose upper edge stays below 0.36 fs,
+// i.e. 10 kHz at 32 kHz and 5 kHz at 16 kHz; bands run down to 50 Hz.
+class ThirdOctaveAnalyzer {
+   public:
+    static constexpr int kBandsPerStage = 3;
+    static constexpr int kSectionsPerBand = 3;
+    static constexpr int kMaxStages = kThirdOctaveBandCount / kBandsPerStage;
+    static constexpr int kDecimatorPairs = 6;
+
+    explicit ThirdOctaveAnalyzer(uint32_t sampleRateHz) {
+        const double fs = static_cast<double>(sampleRateHz);
+        const double edge = std::exp2(1.0 / 6.0);
+        m_topBand = -1;
+        for (int b = kThirdOctaveBandCount - 1; b >= 0; --b) {
+            if (ThirdOctaveCentreHz(b) * edge < 0.36 * fs) {
+                m_topBand = b;
+                break;
+            }
+        }
+        if (m_topBand < 0) {
+            return;
+        }
+        m_stageCount = (m_topBand + kBandsPerStage) / kBandsPerStage;
+        for (int i = 0; i < kBandsPerStage; ++i) {
+            DesignBand(i, ThirdOctaveCentreHz(m_topBand - i), fs);
+        }
+    }
+
+    // Highest band measured at this sample rate; bands 0 (50 Hz) up to it
+    // are covered.
+    int TopBand() const { return m_topBand; }
+
+    int StageCount() const { return m_stageCount; }
+
+    void Reset() {
+        for (auto& stage : m_state) {
+            for (auto& band : stage) {
+                band = {};
+            }
+        }
+        for (auto& d : m_decimators) {
+            d.Reset();
+        }
+        m_residue.fill(0);
+    }
+
+    void Process(const int16_t* pcm, uint32_t count, BandEnergies& out) {
+        for (uint32_t i = 0; i < count; ++i) {
+            Push<false>(static_cast<int32_t>(pcm[i]) << kBiquadStateFracBits,
+                        out);
+        }
+    }
+
+    // Process() for 24-bit samples on the 16-bit scale with
+    // kBiquadStateFracBits of fraction. Band outputs are squared without
+    // rounding and the energy below one LSB^2 carries over to the next
+    // call, so quiet bands are not lost to the 16-bit grid.
+    void ProcessQ8(const int32_t* pcm, uint32_t count, BandEnergies& out) {
+        for (uint32_t i = 0; i < count; ++i) {
+            Push<true>(pcm[i], out);
+        }
+        constexpr int kShift = 2 * kBiquadStateFracBits;
+        for (int b = 0; b < kThirdOctaveBandCount; ++b) {
+            out.energy[b] += m_residue[b] >> kShift;
+            m_residue[b] &= (uint64_t{1} << kShift) - 1;
+        }
+    }
+
+    // Designed magnitude response of band `band` at `freqHz`, in dB, from
+    // the quantised coefficients and ignoring the decimators.
+    double ResponseDb(int band, double freqHz, double sampleRateHz) const {
+        const int offset = m_topBand - band;
+        const int stage = offset / kBandsPerStage;
+        const double fs = sampleRateHz / std::exp2(stage);
+        const double w = 2.0 * std::numbers::pi * freqHz / fs;
+        std::complex<double> h = 1.0;
+        for (const BiquadQ30& c : m_coeffs[offset % kBandsPerStage]) {
+            h *= BiquadResponse(c, w);
+        }
+        return 20.0 * std::log10(std::abs(h));
+    }
+
+   private:
+    using BandState = std::array<BiquadStateQ30, kSectionsPerBand>;
+
+    template <bool Fine>
+    void Push(int32_t x, BandEnergies& out) {
+        for (int stage = 0; stage < m_stageCount; ++stage) {
+            RunStage<Fine>(stage, x, out);
+            if (stage + 1 == m_stageCount || !m_decimators[stage].Push(x, x)) {
+                break;
+            }
+        }
+    }
+
+    template <bool Fine>
+    void RunStage(int stage, int32_t x, BandEnergies& out) {
+        const int top = m_topBand - stage * kBandsPerStage;
+        for (int i = 0; i < kBandsPerStage; ++i) {
+            const int band = top - i;
+            if (band < 0) {
+                return;
+            }
+            int32_t y = x;
+            for (int s = 0; s < kSectionsPerBand; ++s) {
+                y = StepBiquadQ30(m_coeffs[i][s], m_state[stage][i][s], y);
+            }
+            if constexpr (Fine) {
+                m_residue[band] += static_cast<uint64_t>(int64_t{y} * y);
+            } else {
+                const int64_t v = RoundBiquadState(y);
+                out.energy[band] += static_cast<uint64_t>(v * v);
+            }
+            ++out.samples[band];
+        }
+    }
+
+    // Butterworth band-pass from a 3rd-order low-pass prototype: each
+    // prototype pole p maps to the roots of s^2 - p*B*s + w0^2, which are
+    // paired with their conjugates into biquads with a zero at s = 0, then
+    // bilinear-transformed with prewarped band edges.
+    void DesignBand(int index, double centreHz, double fs) {
+        const double k = 2.0 * fs;
+        const double halfBand = std::exp2(1.0 / 6.0);
+        const double lo = k * std::tan(std::numbers::pi * centreHz /
+                                       halfBand / fs);
+        const double hi = k * std::tan(std::numbers::pi * centreHz *
+                                       halfBand / fs);
+        const double w0 = std::sqrt(lo * hi);
+        const double bw = hi - lo;
+
+        const std::complex<double> protoUpper =
+            std::polar(1.0, 2.0 * std::numbers::pi / 3.0);
+        std::array<std::complex<double>, kSectionsPerBand> poles;
+        const std::complex<double> disc =
+            std::sqrt(protoUpper * protoUpper * bw * bw - 4.0 * w0 * w0);
+        poles[0] = (protoUpper * bw + disc) / 2.0;
+        poles[1] = (protoUpper * bw - disc) / 2.0;
+        poles[2] = (-bw + std::sqrt(std::complex<double>(
+                              bw * bw - 4.0 * w0 * w0))) /
+                   2.0;
+
+        std::array<BiquadCoeffs, kSectionsPerBand> sections;
+        for (int s = 0; s < kSectionsPerBand; ++s) {
+            const double a = -2.0 * poles[s].real();
+            const double b = std::norm(poles[s]);
+            const double d0 = k * k + a * k + b;
+            sections[s] = {bw * k / d0,
+                           0.0,
+                           -bw * k / d0,
+                           (2.0 * b - 2.0 * k * k) / d0,
+                           (k * k - a * k + b) / d0};
+        }
+
+        const double wc = 2.0 * std::numbers::pi * centreHz / fs;
+        std::complex<double> h = 1.0;
+        for (const BiquadCoeffs& c : sections) {
+            h *= BiquadResponse(c, wc);
+        }
+        const double gain = std::cbrt(1.0 / std::abs(h));
+        for (int s = 0; s < kSectionsPerBand; ++s) {
+            sections[s].b0 *= gain;
+            sections[s].b2 *= gain;
+            m_coeffs[index][s] = QuantiseBiquad(sections[s]);
+        }
+    }
+
+    int m_topBand = -1;
+    int m_stageCount = 0;
+    std::array<std::array<BiquadQ30, kSectionsPerBand>, kBandsPerStage>
+        m_coeffs{};
+    std::array<std::array<BandState, kBandsPerStage>, kMaxStages> m_state{};
+    std::array<HalfbandDecimator<kDecimatorPairs>, kMaxStages> m_decimators;
+    // ProcessQ8() energy in LSB^2 << 2 * kBiquadStateFracBits.
+    std::array<uint64_t, kThirdOctaveBandCount> m_residue{};
+};
+
+}
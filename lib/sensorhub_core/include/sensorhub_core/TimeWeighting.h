@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "sensorhub_core/LoudnessMath.h"
+
+namespace sensorhub::core {
+
+enum class TimeWeighting : uint8_t { Fast, Slow, Impulse };
+
+// Exponentially time-weighted mean square (IEC 61672-1 F / S / I), updated
+// once per block from that block's sum of squares. Each block is treated as
+// constant power over its duration, so the level no longer depends on the
+// block size for stationary signals. Decay factors are cached per block
+// length, so Add() is O(1) without a call to exp() in the steady state.
+class ExponentialLevel {
+   public:
+    static constexpr float kFastSeconds = 0.125f;
+    static constexpr float kSlowSeconds = 1.0f;
+    static constexpr float kImpulseRiseSeconds = 0.035f;
+    static constexpr float kImpulseFallSeconds = 1.5f;
+
+    ExponentialLevel() : ExponentialLevel(TimeWeighting::Fast, 32000) {}
+
+    ExponentialLevel(TimeWeighting weighting, uint32_t sampleRateHz)
+        : m_weighting(weighting),
+          m_sampleRate(static_cast<float>(sampleRateHz)) {
+        switch (weighting) {
+            case TimeWeighting::Slow:
+                m_riseSeconds = m_fallSeconds = kSlowSeconds;
+                break;
+            case TimeWeighting::Impulse:
+                m_riseSeconds = kImpulseRiseSeconds;
+                m_fallSeconds = kImpulseFallSeconds;
+                break;
+            default:
+                m_riseSeconds = m_fallSeconds = kFastSeconds;
+                break;
+        }
+    }
+
+    TimeWeighting Weighting() const { return m_weighting; }
+
+    void Reset() {
+        m_meanSquare = 0.0f;
+        m_primed = false;
+    }
+
+    void Add(uint64_t sumSquares, uint32_t count) {
+        if (count == 0) {
+            return;
+        }
+        const float blockMs =
+            static_cast<float>(sumSquares) / static_cast<float>(count);
+        if (!m_primed) {
+            m_meanSquare = blockMs;
+            m_primed = true;
+            return;
+        }
+        if (count != m_cachedCount) {
+            const float seconds = static_cast<float>(count) / m_sampleRate;
+            m_riseDecay = std::exp(-seconds / m_riseSeconds);
+            m_fallDecay = std::exp(-seconds / m_fallSeconds);
+            m_cachedCount = count;
+        }
+        const float decay = blockMs > m_meanSquare ? m_riseDecay : m_fallDecay;
+        m_meanSquare = blockMs + (m_meanSquare - blockMs) * decay;
+    }
+
+    // Mean square in LSB^2.
+    float MeanSquare() const { return m_meanSquare; }
+
+    // Level in dB SPL on the INMP441 scale; 0 before the first block or for
+    // silence.
+    float Spl() const { return SplFromMeanSquare(m_meanSquare); }
+
+   private:
+    TimeWeighting m_weighting;
+    float m_sampleRate;
+    float m_riseSeconds = kFastSeconds;
+    float m_fallSeconds = kFastSeconds;
+
+    float m_meanSquare = 0.0f;
+    bool m_primed = false;
+
+    uint32_t m_cachedCount = 0;
+    float m_riseDecay = 0.0f;
+    float m_fallDecay = 0.0f;
+};
+
+}
@@ -145,6 +145,30 @@ ProbeResult ProbeAndStoreConfiguration() {
     Storage::SetDeviceId(doc["device_id"].as<uint32_t>());
     Storage::SetRegisterInterval(doc["register_interval"].as<uint32_t>());
     Storage::SetLoudnessThreshold(doc["loudness_threshold"].as<uint32_t>());
+    Storage::SetRecordingMaxSeconds(
+        doc["recording_max_seconds"].as<uint32_t>());
+    Storage::SetRecordingSampleRate(
+        doc["recording_sample_rate"].as<uint32_t>());
+    Storage::SetRecordingPreRollSeconds(
+        doc["recording_pre_roll_seconds"].as<uint32_t>());
+    Storage::SetRecordingPostRollSeconds(
+        doc["recording_post_roll_seconds"].as<uint32_t>());
+    Storage::SetRecordingJitterSlackSeconds(
+        doc["recording_jitter_slack_seconds"].as<uint32_t>());
+    Storage::SetRecordingMemoryKb(doc["recording_memory_kb"].as<uint32_t>());
+    const Mic::RecordingCodec codec =
+        doc["recording_codec"].as<std::string>() == "flac"
+            ? Mic::RecordingCodec::Flac
+            : Mic::RecordingCodec::ImaAdpcm;
+    Storage::SetRecordingCodec(static_cast<uint32_t>(codec));
+    Storage::SetRecordingSearchDepth(
+        doc["recording_adpcm_search_depth"].as<uint32_t>());
+    Storage::SetRecordingBlockBytes(
+        doc["recording_block_bytes"].as<uint32_t>());
+    Storage::SetRecordingFeaturesOnly(
+        doc["recording_features_only"].as<bool>());
+    Storage::SetRecordingSilenceRuns(
+        doc["recording_silence_runs"].as<bool>());
 
     JsonArray sensors = doc["sensors"].as<JsonArray>();
     for (JsonVariant sensor : sensors) {
@@ -189,6 +213,20 @@ bool RegisterReadings() {
         vTaskDelete(nullptr);
     }
 
+    if (Storage::GetSensorState(Configuration::Sensor::Loudness) &&
+        Mic::IsOK()) {
+        const auto bands = Mic::GetBandEnergies();
+        JsonObject bandsObj = doc["bands"].to<JsonObject>();
+        for (int b = 0; b < sensorhub::core::kThirdOctaveBandCount; ++b) {
+            if (bands.samples[b] == 0) {
+                continue;
+            }
+            const std::string hz =
+                std::to_string(sensorhub::core::kThirdOctaveNominalHz[b]);
+            bandsObj[hz] = static_cast<int>(bands.Level(b));
+        }
+    }
+
     std::string payload;
     serializeJson(doc, payload);
 
@@ -1,8 +1,15 @@
 #include "Mic.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "AdpcmRecorder.h"
 #include "Audio.h"
@@ -16,43 +23,117 @@
 #include "WiFi.h"
 #include "driver/i2s_std.h"
 #include "esp_crt_bundle.h"
+#include "esp_heap_caps.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
 #include "esp_tls.h"
+#include "sensorhub_core/EventDescriptor.h"
+#include "sensorhub_core/EventTrigger.h"
+#include "sensorhub_core/FrequencyWeighting.h"
+#include "sensorhub_core/I2sSlots.h"
+#include "sensorhub_core/LevelStatistics.h"
+#include "sensorhub_core/LoudnessMath.h"
+#include "sensorhub_core/Rms.h"
+#include "sensorhub_core/SilenceRuns.h"
+#include "sensorhub_core/SpscChunkQueue.h"
+#include "sensorhub_core/ThirdOctaveAnalyzer.h"
+#include "sensorhub_core/TimeWeighting.h"
 #include "sensors/ISensor.h"
 #include "sensors/SensorRegistry.h"
 
 namespace Mic {
 namespace Constants {
 
-static const float Sensitivity = 26.0f, RefDB = 94.0f, OffsetDB = -3.0f,
-                   PeakDB = 116.0f, FloorDB = 29.0f;
-
-static const float Amplitude =
-    powf(10.f, -Sensitivity / 20.0f) * ((1 << (16 - 1)) - 1);
+static const float PeakDB = sensorhub::core::kInmp441PeakDb,
+                   FloorDB = sensorhub::core::kInmp441FloorDb;
 
 static const float LoudnessOffset = 0;
 
+static const sensorhub::core::FrequencyWeighting Weighting =
+    sensorhub::core::FrequencyWeighting::A;
+
+static const sensorhub::core::TimeWeighting Integration =
+    sensorhub::core::TimeWeighting::Fast;
+
+static const float TriggerMarginDb = 12.0f, TriggerHysteresisDb = 3.0f;
+
+// Speed of the trigger's noise floor tracker: with the default quantile
+// the floor rises 0.32 dB and falls 2.9 dB a second.
+static const float TriggerFloorStepDbPerSecond = 3.2f;
+
+static const uint32_t TriggerOnsetMs = 60, TriggerCooldownSeconds = 20;
+
+// With silence runs on, event blocks within SilenceMarginDb of the noise
+// floor are left out of the upload once SilenceHoldMs of them follow one
+// another.
+static const float SilenceMarginDb = 6.0f;
+static const uint32_t SilenceHoldMs = 250;
+
+// Recording reads I2S this many 32-bit slots at a time, one DMA buffer,
+// and queues up to CaptureQueueChunks of them (128 ms at 32 kHz) for the
+// analysis task.
+static const uint32_t SlotChunk = 256, CaptureQueueChunks = 16;
+
+// The capture task only waits on I2S and queues what it reads, so it can
+// share core 0 with Wi-Fi. Filters, trigger and encoder get the other core
+// and cannot hold up a read however long a block takes.
+static const BaseType_t CaptureCore = 0,
+                        AnalysisCore = portNUM_PROCESSORS - 1;
+static const UBaseType_t CapturePriority = tskIDLE_PRIORITY + 6;
+static const uint32_t CaptureStackBytes = 2048;
+
 }
 
 static const char* TAG = "Sound";
 static const char* TAG_SENDER = "SoundSender";
+static const char* BlocksTrailer = "X-Recording-Blocks";
+static const char* HistoryHeader = "X-Recording-History-Blocks";
+static const char* GainHeader = "X-Recording-Gain-Db";
+static const char* SilenceHeader = "X-Recording-Silence-Runs";
 static TaskHandle_t xHandle = nullptr;
 static TaskHandle_t xSenderHandle = nullptr;
+static TaskHandle_t xCaptureHandle = nullptr;
+static TaskHandle_t xAnalysisHandle = nullptr;
 
 static i2s_chan_handle_t i2sHandle = nullptr;
+static std::atomic<uint32_t> dmaOverruns{0};
+
+using CaptureQueue = sensorhub::core::SpscChunkQueue<int32_t>;
+static std::unique_ptr<CaptureQueue> captureQueue;
+// Slots of the front chunk already taken by the analysis task.
+static uint32_t chunkOffset = 0;
+static uint32_t reportedDrops = 0;
 
 static std::unique_ptr<Audio> audio;
+static AdpcmFormat format(AdpcmConfig::CaptureRateHz);
 static std::unique_ptr<AdpcmEncoderState> encoder;
 static std::unique_ptr<AdpcmRing> ring;
+static std::unique_ptr<AdpcmHistory> history;
+static uint32_t eventsQueued = 0;
+// Gain of each queued event, by its number modulo the queue length. The
+// slot is written before the event is queued and read before it is
+// finished, so it is never reused while the sender needs it.
+static std::array<int, AdpcmRing::kMaxEvents> eventGainDb{};
+using DescriptorQueue =
+    sensorhub::core::SpscChunkQueue<sensorhub::core::EventDescriptor>;
+static std::unique_ptr<sensorhub::core::DescriptorBuilder> descriptors;
+static std::unique_ptr<DescriptorQueue> descriptorQueue;
+static std::unique_ptr<PartitionFlash> spoolFlash;
+static std::unique_ptr<AdpcmSpool> spool;
 static Reading loudness;
+static sensorhub::core::WeightingFilter weighting;
+static sensorhub::core::ExponentialLevel level;
+static sensorhub::core::LevelStatistics levelStats;
+static sensorhub::core::EventTrigger trigger;
+static sensorhub::core::EventExtent extent;
+static sensorhub::core::SilenceGate silence;
+static std::unique_ptr<sensorhub::core::ThirdOctaveAnalyzer> bandAnalyzer;
+static sensorhub::core::BandEnergies bandTotals;
+static std::mutex statsMutex;
 static bool isOK = false;
 static bool recordingMode = false;
-
-static std::atomic<uint32_t> s_preRollAtTrigger{0};
-
-alignas(uint32_t) static uint8_t
-    s_ringStorage[AdpcmConfig::RingCapacityBlocks * AdpcmConfig::BlockAlign];
+static bool featuresOnly = false;
+static bool silenceRuns = false;
 
 namespace {
 
@@ -60,7 +141,9 @@ class LoudnessSensor : public Sensors::ISensor {
    public:
     const char* Name() const override { return "Loudness"; }
 
-    const char* Unit() const override { return "dB"; }
+    const char* Unit() const override {
+        return sensorhub::core::WeightingUnit(Constants::Weighting);
+    }
 
     uint8_t Id() const override { return Configuration::Sensor::Loudness; }
 
@@ -77,86 +160,455 @@ class LoudnessSensor : public Sensors::ISensor {
     }
 };
 
+class LevelStatisticSensor : public Sensors::ISensor {
+   public:
+    using Statistic = float (*)(const sensorhub::core::LevelStatistics&);
+
+    LevelStatisticSensor(const char* name, uint8_t id, Statistic statistic)
+        : m_name(name), m_id(id), m_statistic(statistic) {}
+
+    const char* Name() const override { return m_name; }
+
+    const char* Unit() const override {
+        return sensorhub::core::WeightingUnit(Constants::Weighting);
+    }
+
+    uint8_t Id() const override { return m_id; }
+
+    bool IsOk() const override {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return isOK && levelStats.Observations() > 0;
+    }
+
+    Reading Snapshot() const override {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        const float value = m_statistic(levelStats);
+        return Reading(value, value, value);
+    }
+
+    void ResetMinMax() override {}
+
+   private:
+    const char* m_name;
+    uint8_t m_id;
+    Statistic m_statistic;
+};
+
 LoudnessSensor s_loudness;
 
+LevelStatisticSensor s_leq("Leq",
+                           Configuration::Sensor::LoudnessLeq,
+                           [](const sensorhub::core::LevelStatistics& s) {
+                               return s.Leq();
+                           });
+LevelStatisticSensor s_l10("L10",
+                           Configuration::Sensor::LoudnessL10,
+                           [](const sensorhub::core::LevelStatistics& s) {
+                               return s.Exceeded(10.0f);
+                           });
+LevelStatisticSensor s_l50("L50",
+                           Configuration::Sensor::LoudnessL50,
+                           [](const sensorhub::core::LevelStatistics& s) {
+                               return s.Exceeded(50.0f);
+                           });
+LevelStatisticSensor s_l90("L90",
+                           Configuration::Sensor::LoudnessL90,
+                           [](const sensorhub::core::LevelStatistics& s) {
+                               return s.Exceeded(90.0f);
+                           });
+
 }
 
 static std::string address, httpPayload;
 static uint32_t transferLength = 0, transferCount = 0;
 
-static float ComputeDbFromPcm(const int16_t* samples, uint32_t count) {
-    const float rms = CalculateRMS(samples, count);
-    return 20.0f * log10f(rms / Constants::Amplitude) + Constants::RefDB +
-           Constants::OffsetDB;
+// Weighted and band energies of one block, gathered from its 24-bit
+// samples as they are read.
+struct BlockMeasurement {
+    uint64_t sumSquares = 0;
+    uint32_t count = 0;
+    sensorhub::core::BandEnergies bands;
+};
+
+static void Measure(const int32_t* samples, uint32_t count,
+                    BlockMeasurement& block) {
+    block.sumSquares += weighting.SumOfSquaresQ8(samples, count);
+    block.count += count;
+    bandAnalyzer->ProcessQ8(samples, count, block.bands);
+}
+
+static float ComputeDb(const BlockMeasurement& block) {
+    level.Add(block.sumSquares, block.count);
+    const float decibel = level.Spl();
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        levelStats.Add(decibel, block.sumSquares, block.count);
+        bandTotals.Add(block.bands);
+    }
+    return decibel;
 }
 
-static void UpdateLoudnessFromPcm(const int16_t* samples, uint32_t count) {
-    const float decibel = ComputeDbFromPcm(samples, count);
+static void UpdateLoudnessFromBlock(const BlockMeasurement& block) {
+    const float decibel = ComputeDb(block);
     if (decibel > Constants::FloorDB && decibel < Constants::PeakDB) {
         loudness.Update(decibel + Constants::LoudnessOffset);
         isOK = true;
     }
 }
 
-static void CaptureRecordingIteration() {
-    int16_t* pcm = encoder->PcmBuffer();
-    if (i2s_channel_read(i2sHandle,
-                         pcm,
-                         encoder->PcmBufferBytes(),
-                         nullptr,
-                         portMAX_DELAY) != ESP_OK) {
-        return;
-    }
+// Runs in the I2S DMA interrupt when the driver had no free buffer.
+static bool IRAM_ATTR OnDmaOverrun(i2s_chan_handle_t, i2s_event_data_t*,
+                                   void*) {
+    dmaOverruns.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
 
-    UpdateLoudnessFromPcm(pcm, AdpcmConfig::SamplesPerBlock);
+// Hands every DMA buffer to the analysis task as is. While the queue is
+// full, e.g. as the analysis task catches up after a flash stall, the
+// audio waits in the DMA buffers; past those the driver drops the oldest
+// and counts a DMA overrun.
+static void CaptureTask(void* arg) {
+    const size_t bytes = Constants::SlotChunk * sizeof(int32_t);
+    for (;;) {
+        while (captureQueue->Full()) {
+            vTaskDelay(1);
+        }
+        int32_t* chunk = captureQueue->Acquire();
+        const esp_err_t err = i2s_channel_read(i2sHandle,
+                                               chunk,
+                                               bytes,
+                                               nullptr,
+                                               portMAX_DELAY);
+        if (err == ESP_OK) {
+            captureQueue->Publish();
+            xTaskNotifyGive(xAnalysisHandle);
+        }
+    }
+}
 
-    const AdpcmRing::State state = ring->CurrentState();
+static void StartCapture() {
+    xAnalysisHandle = xTaskGetCurrentTaskHandle();
+    if (xTaskCreatePinnedToCore(&CaptureTask,
+                                "MicCapture",
+                                Constants::CaptureStackBytes,
+                                nullptr,
+                                Constants::CapturePriority,
+                                &xCaptureHandle,
+                                Constants::CaptureCore) != pdPASS) {
+        ESP_LOGE(TAG, "Capture task spawn failed");
+        std::abort();
+    }
+}
 
-    if (state == AdpcmRing::State::PostCaptureDrain) {
-        return;
+// Takes one block of 24-bit samples from the capture queue, waiting for
+// chunks as needed. They are measured, and their rounding to 16 bits fills
+// the encoder's buffer. Chunks are split in place; blocks need not line up
+// with them.
+static void ReadCaptureBlock(BlockMeasurement& block) {
+    int16_t* pcm = encoder->PcmBuffer();
+    const uint32_t count = encoder->PcmSamples();
+    for (uint32_t at = 0; at < count;) {
+        int32_t* chunk = captureQueue->Front();
+        if (chunk == nullptr) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        const uint32_t n =
+            std::min(Constants::SlotChunk - chunkOffset, count - at);
+        sensorhub::core::SplitI2sSlots(chunk + chunkOffset, n, pcm + at);
+        Measure(chunk + chunkOffset, n, block);
+        at += n;
+        chunkOffset += n;
+        if (chunkOffset == Constants::SlotChunk) {
+            captureQueue->Release();
+            chunkOffset = 0;
+        }
     }
+}
 
-    uint8_t block[AdpcmConfig::BlockAlign];
-    if (!encoder->Encode(block)) {
+static void ReportCaptureDrops() {
+    const CaptureStats stats = GetCaptureStats();
+    if (stats.dmaOverruns == reportedDrops) {
         return;
     }
+    reportedDrops = stats.dmaOverruns;
+    ESP_LOGW(TAG,
+             "Capture fell behind - %lu DMA overruns, queue max %lu of %lu",
+             (unsigned long)stats.dmaOverruns,
+             (unsigned long)stats.maxQueueDepth,
+             (unsigned long)stats.queueChunks);
+}
 
-    if (state == AdpcmRing::State::Idle) {
-        ring->PushOverwrite(block);
-
-        if (!WiFi::IsConnected()) {
+// Feature-only recording keeps no audio. Every block is described, and
+// an event ends as one descriptor queued for the sender.
+static void DescribeBlock(const BlockMeasurement& block, bool triggered) {
+    descriptors->Add(block.sumSquares,
+                     block.count,
+                     block.bands,
+                     loudness.Current());
+    if (descriptors->Active()) {
+        if (!extent.Update(trigger.Sustains(loudness.Current()))) {
             return;
         }
-        if ((uint32_t)loudness.Current() <= Storage::GetLoudnessThreshold()) {
+        sensorhub::core::EventDescriptor* slot = descriptorQueue->Acquire();
+        const sensorhub::core::EventDescriptor event = descriptors->Finish();
+        if (slot == nullptr) {
+            ESP_LOGW(TAG,
+                     "Event ended - descriptor dropped, queue full "
+                     "(dropped=%lu)",
+                     (unsigned long)descriptorQueue->Overruns());
             return;
         }
-
-        const uint32_t preRoll = ring->BeginRecording();
-        if (preRoll == 0) {
-            return;
+        *slot = event;
+        descriptorQueue->Publish();
+        ESP_LOGI(TAG,
+                 "Event ended - %lu ms, peak %d dB, queued=%lu",
+                 (unsigned long)event.durationMs,
+                 (int)event.peakDb,
+                 (unsigned long)descriptorQueue->Depth());
+        if (xSenderHandle != nullptr) {
+            xTaskNotifyGive(xSenderHandle);
         }
+    } else if (triggered) {
+        extent.Start(descriptors->Begin(trigger.Config().onsetBlocks));
+        ESP_LOGI(TAG,
+                 "Loud event %d dB (floor %d, threshold %d) - describing",
+                 (int)loudness.Current(),
+                 (int)trigger.NoiseFloor(),
+                 (int)trigger.Threshold());
+    }
+}
 
-        s_preRollAtTrigger.store(preRoll, std::memory_order_release);
+static void CaptureRecordingIteration() {
+    BlockMeasurement block;
+    ReadCaptureBlock(block);
+    ReportCaptureDrops();
+
+    UpdateLoudnessFromBlock(block);
+    const bool triggered = trigger.Update(loudness.Current());
+    if (featuresOnly) {
+        DescribeBlock(block, triggered);
+        return;
+    }
 
+    uint8_t* slot = ring->Reserve();
+    if (slot != nullptr && encoder->Encode(slot)) {
+        if (silenceRuns && ring->Capturing() &&
+            silence.Update(loudness.Current(), trigger.NoiseFloor())) {
+            MarkQuietBlock(slot);
+        }
+        ring->Commit();
+        if (!ring->Capturing() && history != nullptr) {
+            history->Add(encoder->PcmBuffer());
+        }
+    }
+    // Blocks the full ring dropped count towards the extent as well, so
+    // the event still ends on time while queued events hold the ring.
+    if (ring->Capturing() &&
+        extent.Update(trigger.Sustains(loudness.Current()))) {
+        ring->CloseEvent();
+        if (history != nullptr) {
+            history->Restart();
+        }
+        // No later event reaches back past this block, so the gain can
+        // change here without splitting one.
         ESP_LOGI(TAG,
-                 "Loud event %d dB (threshold %ld) - preroll=%lu blocks",
-                 (int)loudness.Current(),
-                 Storage::GetLoudnessThreshold(),
-                 (unsigned long)preRoll);
+                 "Event ended - %lu blocks, %lu stored, gain now %d dB",
+                 (unsigned long)extent.Blocks(),
+                 (unsigned long)ring->CapturedBlocks(),
+                 encoder->SettleGain());
+    }
 
-        if (xSenderHandle != nullptr) {
-            xTaskNotifyGive(xSenderHandle);
+    if (triggered && !ring->Capturing()) {
+        // The history is frozen before the event is queued, so the sender
+        // never sees the event without it.
+        const bool withHistory =
+            history != nullptr &&
+            history->Freeze(eventsQueued, ring->PreRollDepth());
+        uint32_t preRoll = 0;
+        eventGainDb[eventsQueued % eventGainDb.size()] = encoder->GainDb();
+        if (ring->QueueEvent(preRoll)) {
+            eventsQueued++;
+            extent.Start(preRoll);
+            silence.Reset();
+            ESP_LOGI(TAG,
+                     "Loud event %d dB (floor %d, threshold %d) - preroll=%lu "
+                     "blocks%s, gain %d dB, queued=%lu",
+                     (int)loudness.Current(),
+                     (int)trigger.NoiseFloor(),
+                     (int)trigger.Threshold(),
+                     (unsigned long)preRoll,
+                     withHistory ? " + history" : "",
+                     encoder->GainDb(),
+                     (unsigned long)ring->QueuedEvents());
+        } else {
+            if (withHistory) {
+                history->Ring().Cancel(eventsQueued);
+            }
+            ESP_LOGW(TAG,
+                     "Loud event %d dB dropped - queue full (dropped=%lu)",
+                     (int)loudness.Current(),
+                     (unsigned long)ring->DroppedEvents());
         }
+    }
+
+    if (ring->QueuedEvents() > 0 && xSenderHandle != nullptr) {
+        xTaskNotifyGive(xSenderHandle);
+    }
+}
+
+static const uint32_t RingCaps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+
+// 0 selects the default; values past the limit are clamped to it.
+static uint32_t ConfiguredSeconds(uint32_t value, uint32_t fallback,
+                                  uint32_t limit) {
+    return std::min(value == 0 ? fallback : value, limit);
+}
+
+// The budget from the device config, cut to what the internal heap can
+// spare once the rest of the firmware has its reserve.
+static size_t MemoryBudget() {
+    const uint32_t kb = Storage::GetRecordingMemoryKb();
+    const size_t declared =
+        size_t{kb == 0 ? AdpcmConfig::DefaultMemoryBudgetKb : kb} * 1024;
+    const size_t freeBytes = heap_caps_get_free_size(RingCaps);
+    const size_t spare = freeBytes > AdpcmConfig::HeapReserveBytes
+                             ? freeBytes - AdpcmConfig::HeapReserveBytes
+                             : 0;
+    if (spare < declared) {
+        ESP_LOGW(TAG,
+                 "Memory budget %lu KB cut to %lu KB (free heap %lu KB)",
+                 (unsigned long)(declared / 1024),
+                 (unsigned long)(spare / 1024),
+                 (unsigned long)(freeBytes / 1024));
+    }
+    return std::min(declared, spare);
+}
+
+static sensorhub::core::CapturePlan PlanCapture() {
+    sensorhub::core::CaptureRequest request;
+    request.preRollMs =
+        1000 * ConfiguredSeconds(Storage::GetRecordingPreRollSeconds(),
+                                 AdpcmConfig::DefaultPreRollSeconds,
+                                 AdpcmConfig::PreRollSecondsLimit);
+    request.fullRateMs = 1000 * AdpcmConfig::FullRateSeconds;
+    request.jitterSlackMs =
+        1000 * ConfiguredSeconds(Storage::GetRecordingJitterSlackSeconds(),
+                                 AdpcmConfig::DefaultJitterSlackSeconds,
+                                 AdpcmConfig::JitterSlackSecondsLimit);
+
+    const sensorhub::core::CapturePlan plan =
+        format.Planner().Plan(request, MemoryBudget());
+    if (plan.shortened) {
+        ESP_LOGW(TAG,
+                 "Budget too small - pre-roll %lu of %lu ms, at most %lu ms",
+                 (unsigned long)plan.preRollMs,
+                 (unsigned long)request.preRollMs,
+                 (unsigned long)plan.maxPreRollMs);
     } else {
-        ring->PushPreserve(block);
-        if (xSenderHandle != nullptr) {
-            xTaskNotifyGive(xSenderHandle);
-        }
+        ESP_LOGI(TAG,
+                 "Pre-roll %lu ms, budget allows up to %lu ms",
+                 (unsigned long)plan.preRollMs,
+                 (unsigned long)plan.maxPreRollMs);
+    }
+    return plan;
+}
 
-        if (ring->PostRollProduced() >= AdpcmConfig::PostRollBlocks) {
-            ring->MarkPostRollDone();
+// The history tier is optional: without the memory for it, recordings just
+// lose the older pre-roll.
+static void CreateHistory(const sensorhub::core::CapturePlan& plan) {
+    const uint32_t capacity = plan.historyBlocks;
+    if (capacity == 0) {
+        return;
+    }
+    uint8_t* storage = static_cast<uint8_t*>(
+        heap_caps_malloc(capacity * format.BlockAlign(), RingCaps));
+    if (storage == nullptr) {
+        ESP_LOGW(TAG, "History alloc failed, pre-roll limited to ring");
+        return;
+    }
+    history = std::make_unique<AdpcmHistory>(format, storage, capacity);
+    ESP_LOGI(TAG,
+             "History at %lu Hz, %lu blocks (%lu bytes)",
+             (unsigned long)AdpcmConfig::HistoryRateHz,
+             (unsigned long)capacity,
+             (unsigned long)(capacity * format.BlockAlign()));
+}
+
+// The ring is sized for the recording rate, so lower rates need less RAM.
+// If the heap is too fragmented for it, it shrinks to the largest free
+// block and the pre-roll with it.
+static void CreateRing(const sensorhub::core::CapturePlan& plan) {
+    uint32_t capacity = plan.ringBlocks;
+    const uint16_t blockBytes = format.BlockBytes();
+    uint8_t* storage = static_cast<uint8_t*>(
+        heap_caps_malloc(capacity * blockBytes, RingCaps));
+    if (storage == nullptr) {
+        capacity = heap_caps_get_largest_free_block(RingCaps) / blockBytes;
+        storage = static_cast<uint8_t*>(
+            heap_caps_malloc(capacity * blockBytes, RingCaps));
+        if (storage == nullptr || capacity < 2) {
+            ESP_LOGE(TAG, "Ring alloc failed");
+            std::abort();
         }
+        ESP_LOGW(TAG,
+                 "Ring shrunk to %lu of %lu blocks",
+                 (unsigned long)capacity,
+                 (unsigned long)plan.ringBlocks);
+    }
+    ring = std::make_unique<AdpcmRing>(format,
+                                       storage,
+                                       capacity,
+                                       plan.preRollBlocks);
+    ESP_LOGI(TAG,
+             "Recording %s at %lu Hz, ring %lu blocks of %u bytes",
+             format.Codec() == RecordingCodec::Flac ? "FLAC" : "IMA ADPCM",
+             (unsigned long)format.SampleRateHz(),
+             (unsigned long)capacity,
+             (unsigned)blockBytes);
+}
+
+// Allocated before the ring is planned, so the budget sees it gone.
+static void CreateCaptureQueue() {
+    const size_t bytes = size_t{Constants::CaptureQueueChunks} *
+                         Constants::SlotChunk * sizeof(int32_t);
+    int32_t* storage =
+        static_cast<int32_t*>(heap_caps_malloc(bytes, RingCaps));
+    if (storage == nullptr) {
+        ESP_LOGE(TAG, "Capture queue alloc failed (%u bytes)", (unsigned)bytes);
+        std::abort();
     }
+    captureQueue = std::make_unique<CaptureQueue>(
+        storage, Constants::SlotChunk, Constants::CaptureQueueChunks);
+}
+
+static void CreateDescriptorQueue() {
+    const size_t bytes = AdpcmConfig::DescriptorQueueEvents *
+                         sizeof(sensorhub::core::EventDescriptor);
+    auto* storage = static_cast<sensorhub::core::EventDescriptor*>(
+        heap_caps_malloc(bytes, RingCaps));
+    if (storage == nullptr) {
+        ESP_LOGE(TAG,
+                 "Descriptor queue alloc failed (%u bytes)",
+                 (unsigned)bytes);
+        std::abort();
+    }
+    descriptorQueue = std::make_unique<DescriptorQueue>(
+        storage, 1, AdpcmConfig::DescriptorQueueEvents);
+    descriptors = std::make_unique<sensorhub::core::DescriptorBuilder>(
+        AdpcmConfig::CaptureRateHz);
+    ESP_LOGI(TAG,
+             "Feature-only recording, up to %lu descriptors queued",
+             (unsigned long)AdpcmConfig::DescriptorQueueEvents);
+}
+
+// Read by both tasks, so the sender can mount the spool before the
+// recorder has set `format`.
+static AdpcmFormat ConfiguredFormat() {
+    return AdpcmFormat(
+        Storage::GetRecordingSampleRate(),
+        static_cast<RecordingCodec>(Storage::GetRecordingCodec()),
+        Storage::GetRecordingBlockBytes());
 }
 
 static void vTask(void* arg) {
@@ -166,18 +618,81 @@ static void vTask(void* arg) {
     uint32_t sampleRate = 0;
 
     if (recordingMode) {
-        encoder = std::make_unique<AdpcmEncoderState>();
-        ring = std::make_unique<AdpcmRing>(s_ringStorage);
-        sampleRate = AdpcmConfig::SampleRateHz;
+        format = ConfiguredFormat();
+        encoder = std::make_unique<AdpcmEncoderState>(format);
+        encoder->SetSearchDepth(Storage::GetRecordingSearchDepth());
+        if (format.Codec() == RecordingCodec::ImaAdpcm &&
+            encoder->SearchDepth() > 0) {
+            ESP_LOGI(TAG,
+                     "ADPCM lookahead %d samples",
+                     encoder->SearchDepth());
+        }
+        CreateCaptureQueue();
+        featuresOnly = Storage::GetRecordingFeaturesOnly();
+        if (featuresOnly) {
+            CreateDescriptorQueue();
+        } else {
+            const sensorhub::core::CapturePlan plan = PlanCapture();
+            CreateRing(plan);
+            CreateHistory(plan);
+        }
+        sampleRate = AdpcmConfig::CaptureRateHz;
+
+        sensorhub::core::TriggerConfig triggerConfig;
+        triggerConfig.marginDb = Constants::TriggerMarginDb;
+        triggerConfig.minLevelDb =
+            static_cast<float>(Storage::GetLoudnessThreshold());
+        triggerConfig.rearmHysteresisDb = Constants::TriggerHysteresisDb;
+        triggerConfig.onsetBlocks =
+            format.BlocksForMs(Constants::TriggerOnsetMs);
+        triggerConfig.cooldownBlocks =
+            format.Blocks(Constants::TriggerCooldownSeconds);
+        triggerConfig.floorStepDb = sensorhub::core::FloorStepDb(
+            Constants::TriggerFloorStepDbPerSecond,
+            format.SamplesPerBlock(),
+            format.SampleRateHz());
+        trigger = sensorhub::core::EventTrigger(triggerConfig);
+
+        const uint32_t maxSeconds =
+            ConfiguredSeconds(Storage::GetRecordingMaxSeconds(),
+                              AdpcmConfig::DefaultMaxRecordingSeconds,
+                              AdpcmConfig::MaxRecordingSecondsLimit);
+        const uint32_t postRollSeconds =
+            ConfiguredSeconds(Storage::GetRecordingPostRollSeconds(),
+                              AdpcmConfig::DefaultPostRollSeconds,
+                              AdpcmConfig::PostRollSecondsLimit);
+
+        sensorhub::core::ExtentConfig extentConfig;
+        extentConfig.minPostBlocks = format.Blocks(postRollSeconds);
+        extentConfig.releaseBlocks = format.Blocks(AdpcmConfig::ReleaseSeconds);
+        extentConfig.maxBlocks = format.Blocks(maxSeconds);
+        extent = sensorhub::core::EventExtent(extentConfig);
+
+        silenceRuns = Storage::GetRecordingSilenceRuns() &&
+                      format.Codec() == RecordingCodec::ImaAdpcm;
+        sensorhub::core::SilenceConfig silenceConfig;
+        silenceConfig.marginDb = Constants::SilenceMarginDb;
+        silenceConfig.holdBlocks = format.BlocksForMs(Constants::SilenceHoldMs);
+        silence = sensorhub::core::SilenceGate(silenceConfig);
     } else {
-        audio = std::make_unique<Audio>(16000, 16, 125, 0);
+        audio = std::make_unique<Audio>(16000, 32, 125, 0);
         transferLength = audio->BufferLength;
         transferCount = audio->BufferCount;
         sampleRate = audio->Header.SampleRate;
     }
-
-    const uint32_t dmaFrameNum = recordingMode ? 256 : audio->DMA_FrameNum;
-    const uint32_t dmaDescNum = recordingMode ? 4 : audio->DMA_DescNum;
+    weighting =
+        sensorhub::core::WeightingFilter(Constants::Weighting, sampleRate);
+    level = sensorhub::core::ExponentialLevel(Constants::Integration,
+                                              sampleRate);
+    bandAnalyzer =
+        std::make_unique<sensorhub::core::ThirdOctaveAnalyzer>(sampleRate);
+
+    const uint32_t dmaFrameNum =
+        recordingMode ? Constants::SlotChunk : audio->DMA_FrameNum;
+    // Eight 8 ms buffers ride out the cache stall of a typical spool sector
+    // erase. Only spooled events erase flash, so a slow erase only costs
+    // audio while the network is down.
+    const uint32_t dmaDescNum = recordingMode ? 8 : audio->DMA_DescNum;
 
     const i2s_std_config_t i2s_config = {
         .clk_cfg =
@@ -187,7 +702,7 @@ static void vTask(void* arg) {
                 .mclk_multiple = I2S_MCLK_MULTIPLE_512,
             },
         .slot_cfg =
-            I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT,
+            I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT,
                                                 I2S_SLOT_MODE_MONO),
         .gpio_cfg =
             {
@@ -214,20 +729,27 @@ static void vTask(void* arg) {
 
     ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, nullptr, &i2sHandle));
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(i2sHandle, &i2s_config));
+    const i2s_event_callbacks_t callbacks = {
+        .on_recv = nullptr,
+        .on_recv_q_ovf = &OnDmaOverrun,
+        .on_sent = nullptr,
+        .on_send_q_ovf = nullptr,
+    };
+    ESP_ERROR_CHECK(
+        i2s_channel_register_event_callback(i2sHandle, &callbacks, nullptr));
     ESP_ERROR_CHECK(i2s_channel_enable(i2sHandle));
 
     if (recordingMode) {
-        int16_t* pcm = encoder->PcmBuffer();
+        StartCapture();
+        BlockMeasurement block;
         for (int i = 0; i < 4; i++) {
-            ESP_ERROR_CHECK(i2s_channel_read(i2sHandle,
-                                             pcm,
-                                             encoder->PcmBufferBytes(),
-                                             nullptr,
-                                             portMAX_DELAY));
+            block = {};
+            ReadCaptureBlock(block);
         }
 
+        const int16_t* pcm = encoder->PcmBuffer();
         int32_t peakAbs = 0;
-        for (uint32_t i = 0; i < AdpcmConfig::SamplesPerBlock; i++) {
+        for (uint32_t i = 0; i < encoder->PcmSamples(); i++) {
             const int32_t v = pcm[i] < 0 ? -pcm[i] : pcm[i];
             if (v > peakAbs)
                 peakAbs = v;
@@ -235,11 +757,12 @@ static void vTask(void* arg) {
 
         if (peakAbs < 4) {
             ESP_LOGW(TAG, "No mic detected (peak=%d), skipping", (int)peakAbs);
+            vTaskDelete(xCaptureHandle);
             vTaskDelete(nullptr);
         }
 
         isOK = true;
-        UpdateLoudnessFromPcm(pcm, AdpcmConfig::SamplesPerBlock);
+        UpdateLoudnessFromBlock(block);
 
         for (;;) {
             CaptureRecordingIteration();
@@ -255,10 +778,16 @@ static void vTask(void* arg) {
     }
 
     {
-        const float decibel =
-            ComputeDbFromPcm((int16_t*)audio->Buffer.get(), transferCount);
-        if (decibel > Constants::FloorDB && decibel < Constants::PeakDB) {
-            loudness.Update(decibel + Constants::LoudnessOffset);
+        int32_t* samples = reinterpret_cast<int32_t*>(audio->Buffer.get());
+        sensorhub::core::UnpadI2sSlots(samples, transferCount);
+        const float unweighted = sensorhub::core::SplFromSumOfSquares(
+            sensorhub::core::SumOfSquaresQ8(samples, transferCount),
+            transferCount);
+        if (unweighted > Constants::FloorDB &&
+            unweighted < Constants::PeakDB) {
+            BlockMeasurement block;
+            Measure(samples, transferCount, block);
+            loudness.Update(ComputeDb(block) + Constants::LoudnessOffset);
             isOK = true;
         } else {
             ESP_LOGW(TAG, "No mic detected, skipping");
@@ -292,6 +821,485 @@ static bool ReadHttpResponse(esp_http_client_handle_t client,
     return true;
 }
 
+// Writes one chunk of a chunked request body.
+static bool WriteChunk(esp_http_client_handle_t httpClient, const void* data,
+                       uint32_t length) {
+    char size[12];
+    const int n =
+        snprintf(size, sizeof(size), "%lx\r\n", (unsigned long)length);
+    return esp_http_client_write(httpClient, size, n) == n &&
+           esp_http_client_write(httpClient, (const char*)data, length) ==
+               (int)length &&
+           esp_http_client_write(httpClient, "\r\n", 2) == 2;
+}
+
+// The final chunk carries the block count as a trailer, since the WAV
+// header went out before the length was known.
+static bool WriteLastChunk(esp_http_client_handle_t httpClient,
+                           uint32_t blocks) {
+    char trailer[64];
+    const int n = snprintf(trailer,
+                           sizeof(trailer),
+                           "0\r\n%s: %lu\r\n\r\n",
+                           BlocksTrailer,
+                           (unsigned long)blocks);
+    return esp_http_client_write(httpClient, trailer, n) == n;
+}
+
+// One chunk standing for `blocks` blocks left out as silence, if any were.
+static bool WriteSilence(esp_http_client_handle_t httpClient,
+                         uint32_t blocks) {
+    if (blocks == 0) {
+        return true;
+    }
+    uint8_t run[sensorhub::core::kSilenceRunBytes];
+    sensorhub::core::WriteSilenceRun(blocks, run);
+    return WriteChunk(httpClient, run, sizeof(run));
+}
+
+namespace {
+
+// Blocks of one event as the sender uploads them: straight from the ring
+// while it is still being captured, or from the spool after the fact.
+class BlockSource {
+   public:
+    virtual ~BlockSource() = default;
+
+    virtual bool Done() const = 0;
+
+    // Next block, or nullptr if it has not been captured yet.
+    virtual const uint8_t* Peek() = 0;
+
+    virtual void Release() = 0;
+};
+
+// Skips the first `skip` blocks of the event, which the history already
+// covers.
+class RingSource : public BlockSource {
+   public:
+    explicit RingSource(uint32_t skip = 0) : m_skip(skip) {}
+
+    bool Done() const override { return ring->EventDone(); }
+
+    const uint8_t* Peek() override {
+        while (m_skip > 0 && ring->PeekFront() != nullptr) {
+            ring->ReleaseFront();
+            m_skip--;
+        }
+        return m_skip > 0 ? nullptr : ring->PeekFront();
+    }
+
+    void Release() override { ring->ReleaseFront(); }
+
+   private:
+    uint32_t m_skip;
+};
+
+class SpoolSource : public BlockSource {
+   public:
+    explicit SpoolSource(const sensorhub::core::SpoolEvent& event)
+        : m_event(event), m_block(spool->Format().BlockBytes()) {}
+
+    bool Done() const override { return m_next == m_event.blocks; }
+
+    // A block that cannot be read ends the event there.
+    const uint8_t* Peek() override {
+        if (spool->ReadBlock(m_event, m_next, m_block.data())) {
+            return m_block.data();
+        }
+        m_event.blocks = m_next;
+        return nullptr;
+    }
+
+    void Release() override { m_next++; }
+
+   private:
+    sensorhub::core::SpoolEvent m_event;
+    uint32_t m_next = 0;
+    std::vector<uint8_t> m_block;
+};
+
+enum class UploadResult { NotOpened, Failed, Sent };
+
+}
+
+// Lossless blocks only hold the subframe; the frame header and CRC are
+// added here, numbered from the start of the upload. An ADPCM block still
+// flagged quiet - silence runs off, or turned off since it was spooled -
+// goes with its reserved byte back at 0.
+static bool WriteBlock(esp_http_client_handle_t httpClient,
+                       const AdpcmFormat& blocks, uint32_t sampleRate,
+                       uint32_t index, const uint8_t* block) {
+    if (blocks.Codec() != RecordingCodec::Flac) {
+        if (!IsQuietBlock(block)) {
+            return WriteChunk(httpClient, block, blocks.BlockAlign());
+        }
+        static uint8_t cleared[AdpcmConfig::MaxBlockAlign];
+        std::memcpy(cleared, block, blocks.BlockAlign());
+        cleared[3] = 0;
+        return WriteChunk(httpClient, cleared, blocks.BlockAlign());
+    }
+
+    static uint8_t frame[sensorhub::core::kFlacMaxFrameHeaderBytes +
+                         sensorhub::core::FlacMaxSubframeBytes(
+                             AdpcmConfig::FlacSamplesPerBlock) +
+                         sensorhub::core::kFlacFrameFooterBytes];
+    const uint16_t subframe = FlacSubframeBytes(block);
+    if (subframe > sensorhub::core::FlacMaxSubframeBytes(
+                       AdpcmConfig::FlacSamplesPerBlock)) {
+        return false;
+    }
+    size_t n = sensorhub::core::FlacFrameHeader(
+        index, AdpcmConfig::FlacSamplesPerBlock, sampleRate, frame);
+    std::memcpy(frame + n, block + 2, subframe);
+    n += subframe;
+    const uint16_t crc = sensorhub::core::FlacCrc16(frame, n);
+    frame[n++] = static_cast<uint8_t>(crc >> 8);
+    frame[n++] = static_cast<uint8_t>(crc);
+    return WriteChunk(httpClient, frame, n);
+}
+
+static bool WriteHistory(esp_http_client_handle_t httpClient,
+                         const sensorhub::core::HistoryRing& tier,
+                         const sensorhub::core::HistorySnapshot& snapshot,
+                         uint16_t blockAlign) {
+    WavHeaderImaAdpcm header(AdpcmConfig::HistoryRateHz,
+                             blockAlign,
+                             snapshot.blocks);
+    if (!WriteChunk(httpClient, &header, sizeof(header))) {
+        return false;
+    }
+    for (uint32_t i = 0; i < snapshot.blocks; i++) {
+        if (!WriteChunk(httpClient, tier.Block(i), blockAlign)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// An IMA ADPCM recording is uploaded as up to two WAV files back to back
+// in one body:
+//
+//   1. When the request carries X-Recording-History-Blocks: H, the older
+//      pre-roll comes first as a complete IMA ADPCM WAV at HistoryRateHz
+//      with H blocks and exact RIFF and data lengths.
+//   2. The recording itself follows as a streaming WAV at the recording
+//      rate, whose length is only given by the X-Recording-Blocks trailer.
+//
+// The history ends where the recording begins, so the two play back to
+// back as one timeline.
+//
+// With silence runs on, the request carries X-Recording-Silence-Runs: 1
+// and the recording's data chunk may hold silence runs in place of quiet
+// blocks, in the format of sensorhub_core/SilenceRuns.h; ExpandSilenceRuns()
+// turns the whole body back into standard WAVs. The trailer counts the
+// blocks of the runs as well.
+//
+// Both were DC blocked and scaled by the gain the event was recorded
+// with. When it is not 0 the request carries X-Recording-Gain-Db: G, and
+// dividing the samples by 10^(G / 20) gives back the captured level.
+//
+// A lossless recording is a single FLAC stream (Content-Type audio/flac)
+// of FlacSamplesPerBlock-sample frames, with the total length left unknown
+// in STREAMINFO and given by the trailer as well. It never has a history.
+//
+// `blocks` is the format the source's blocks were coded in; the sample
+// rate and gain are passed apart since spooled events keep their own.
+static UploadResult SendEvent(
+    esp_http_client_handle_t httpClient, BlockSource& source,
+    const AdpcmFormat& blocks, [[maybe_unused]] uint32_t preRoll,
+    uint32_t sampleRate, int gainDb,
+    const sensorhub::core::HistorySnapshot* historySnapshot = nullptr) {
+    const uint32_t droppedBefore = ring->DroppedBlocks();
+
+    const uint32_t historyBlocks =
+        historySnapshot != nullptr ? historySnapshot->blocks : 0;
+    ESP_LOGI(TAG_SENDER,
+             "Recording start - preroll=%lu blocks at %lu Hz, history=%lu, "
+             "gain %d dB",
+             (unsigned long)preRoll,
+             (unsigned long)sampleRate,
+             (unsigned long)historyBlocks,
+             gainDb);
+
+    UNIT_TIMER("POST request");
+
+    esp_http_client_set_header(
+        httpClient,
+        "Content-Type",
+        blocks.Codec() == RecordingCodec::Flac ? "audio/flac" : "audio/wav");
+    if (historyBlocks > 0) {
+        esp_http_client_set_header(httpClient,
+                                   HistoryHeader,
+                                   std::to_string(historyBlocks).c_str());
+    } else {
+        esp_http_client_delete_header(httpClient, HistoryHeader);
+    }
+    if (gainDb != 0) {
+        esp_http_client_set_header(httpClient,
+                                   GainHeader,
+                                   std::to_string(gainDb).c_str());
+    } else {
+        esp_http_client_delete_header(httpClient, GainHeader);
+    }
+    const bool runs =
+        silenceRuns && blocks.Codec() == RecordingCodec::ImaAdpcm;
+    if (runs) {
+        esp_http_client_set_header(httpClient, SilenceHeader, "1");
+    } else {
+        esp_http_client_delete_header(httpClient, SilenceHeader);
+    }
+
+    // A length of -1 makes the client send Transfer-Encoding: chunked, so
+    // the event can still be growing while it is uploaded.
+    esp_err_t err = esp_http_client_open(httpClient, -1);
+    if (err != ESP_OK) {
+        Failsafe::AddFailure(
+            TAG_SENDER,
+            "POST open failed - " + (err == ESP_ERR_HTTP_CONNECT
+                                         ? "URL not found: " + address
+                                         : esp_err_to_name(err)));
+        return UploadResult::NotOpened;
+    }
+
+    Output::Blink(Output::LedG, 250, true);
+
+    bool headerWritten = false;
+    if (blocks.Codec() == RecordingCodec::Flac) {
+        uint8_t header[sensorhub::core::kFlacStreamHeaderBytes];
+        sensorhub::core::FlacStreamHeader(AdpcmConfig::FlacSamplesPerBlock,
+                                          sampleRate,
+                                          header);
+        headerWritten = WriteChunk(httpClient, header, sizeof(header));
+    } else {
+        WavHeaderImaAdpcm header(sampleRate, blocks.BlockAlign());
+        headerWritten = (historyBlocks == 0 ||
+                         WriteHistory(httpClient,
+                                      history->Ring(),
+                                      *historySnapshot,
+                                      blocks.BlockAlign())) &&
+                        WriteChunk(httpClient, &header, sizeof(header));
+    }
+    if (!headerWritten) {
+        Failsafe::AddFailure(TAG_SENDER, "Writing stream header failed");
+        esp_http_client_close(httpClient);
+        Output::SetContinuity(Output::LedG, false);
+        return UploadResult::Failed;
+    }
+
+    uint32_t sent = 0;
+    uint32_t quiet = 0;
+    uint32_t silent = 0;
+    while (!source.Done()) {
+        const uint8_t* block = source.Peek();
+        if (block == nullptr) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+            continue;
+        }
+        bool written = true;
+        if (runs && IsQuietBlock(block)) {
+            quiet++;
+        } else {
+            written = WriteSilence(httpClient, quiet) &&
+                      WriteBlock(httpClient, blocks, sampleRate, sent, block);
+            silent += quiet;
+            quiet = 0;
+        }
+        source.Release();
+        if (!written) {
+            Failsafe::AddFailure(TAG_SENDER, "HTTP write failed");
+            esp_http_client_close(httpClient);
+            Output::SetContinuity(Output::LedG, false);
+            return UploadResult::Failed;
+        }
+        sent++;
+    }
+
+    silent += quiet;
+    if (!WriteSilence(httpClient, quiet) || !WriteLastChunk(httpClient, sent)) {
+        Failsafe::AddFailure(TAG_SENDER, "HTTP write failed");
+        esp_http_client_close(httpClient);
+        Output::SetContinuity(Output::LedG, false);
+        return UploadResult::Failed;
+    }
+
+    int statusCode = 0;
+    const bool responseOk = ReadHttpResponse(httpClient, statusCode);
+    esp_http_client_close(httpClient);
+    Output::SetContinuity(Output::LedG, false);
+
+    if (!responseOk) {
+        Failsafe::AddFailure(
+            TAG_SENDER,
+            "Status: " + std::to_string(statusCode) + " - empty response");
+        return UploadResult::Failed;
+    }
+    if (!Backend::CheckResponseFailed(httpPayload,
+                                      (HTTP::Status::StatusCode)statusCode)) {
+        loudness.Reset();
+    }
+
+    const uint32_t dropped = ring->DroppedBlocks() - droppedBefore;
+    if (dropped > 0) {
+        ESP_LOGW(TAG_SENDER,
+                 "Recording done - sent=%lu blocks (%lu silent) status=%d "
+                 "(dropped=%lu)",
+                 (unsigned long)sent,
+                 (unsigned long)silent,
+                 statusCode,
+                 (unsigned long)dropped);
+    } else {
+        ESP_LOGI(TAG_SENDER,
+                 "Recording done - sent=%lu blocks (%lu silent) status=%d",
+                 (unsigned long)sent,
+                 (unsigned long)silent,
+                 statusCode);
+    }
+    return UploadResult::Sent;
+}
+
+// Copies the open ring event to the spool as it is captured, from the
+// oldest block still pinned. A failed upload may have sent more than the
+// pin holds; the spooled event then starts that far in.
+static void SpoolRingEvent(const sensorhub::core::RingEvent& event,
+                           int gainDb) {
+    const uint32_t first = ring->RewindPinned();
+    if (spool == nullptr) {
+        ESP_LOGW(TAG_SENDER, "Upload failed and no spool - recording dropped");
+        return;
+    }
+
+    [[maybe_unused]] const uint32_t droppedBefore = spool->DroppedEvents();
+    spool->BeginEvent(event.preRoll > first ? event.preRoll - first : 0,
+                      format.SampleRateHz(),
+                      gainDb);
+    while (!ring->EventDone()) {
+        const uint8_t* block = ring->PeekFront();
+        if (block == nullptr) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+            continue;
+        }
+        spool->Append(block);
+        ring->ReleaseFront();
+    }
+    spool->EndEvent();
+
+    ESP_LOGI(TAG_SENDER,
+             "Recording spooled - %lu blocks from block %lu, pending=%lu, "
+             "overwritten=%lu",
+             (unsigned long)(ring->EventRead() - first),
+             (unsigned long)first,
+             (unsigned long)spool->PendingEvents(),
+             (unsigned long)(spool->DroppedEvents() - droppedBefore));
+}
+
+// Uploads spooled events oldest first, as long as nothing live is queued.
+static void DrainSpool(esp_http_client_handle_t httpClient) {
+    sensorhub::core::SpoolEvent event;
+    while (spool != nullptr && WiFi::IsConnected() &&
+           ring->QueuedEvents() == 0 && spool->OldestEvent(event)) {
+        if (event.blocks > 0) {
+            SpoolSource source(event);
+            if (SendEvent(httpClient,
+                          source,
+                          spool->Format(),
+                          event.preRoll,
+                          event.sampleRate,
+                          event.gainDb) != UploadResult::Sent) {
+                return;
+            }
+        }
+        spool->Remove(event);
+    }
+}
+
+// A feature-only event is uploaded as one JSON object (Content-Type
+// application/json) from FormatDescriptorJson(), to the same address as
+// recordings, instead of any audio.
+static UploadResult SendDescriptor(
+    esp_http_client_handle_t httpClient,
+    const sensorhub::core::EventDescriptor& event) {
+    static char body[1024];
+    const size_t length =
+        sensorhub::core::FormatDescriptorJson(event, body, sizeof(body));
+    if (length == 0) {
+        Failsafe::AddFailure(TAG_SENDER, "Descriptor too large");
+        return UploadResult::Failed;
+    }
+
+    esp_http_client_set_header(httpClient, "Content-Type", "application/json");
+    esp_err_t err = esp_http_client_open(httpClient, (int)length);
+    if (err != ESP_OK) {
+        Failsafe::AddFailure(
+            TAG_SENDER,
+            "POST open failed - " + (err == ESP_ERR_HTTP_CONNECT
+                                         ? "URL not found: " + address
+                                         : esp_err_to_name(err)));
+        return UploadResult::NotOpened;
+    }
+
+    if (esp_http_client_write(httpClient, body, (int)length) !=
+        (int)length) {
+        Failsafe::AddFailure(TAG_SENDER, "HTTP write failed");
+        esp_http_client_close(httpClient);
+        return UploadResult::Failed;
+    }
+
+    int statusCode = 0;
+    const bool responseOk = ReadHttpResponse(httpClient, statusCode);
+    esp_http_client_close(httpClient);
+
+    if (!responseOk) {
+        Failsafe::AddFailure(
+            TAG_SENDER,
+            "Status: " + std::to_string(statusCode) + " - empty response");
+        return UploadResult::Failed;
+    }
+    if (!Backend::CheckResponseFailed(httpPayload,
+                                      (HTTP::Status::StatusCode)statusCode)) {
+        loudness.Reset();
+    }
+    ESP_LOGI(TAG_SENDER,
+             "Descriptor sent - %u bytes status=%d",
+             (unsigned)length,
+             statusCode);
+    return UploadResult::Sent;
+}
+
+// Sends queued descriptors oldest first. One that could not be opened for
+// want of a network stays queued for the next try.
+static void SendDescriptors(esp_http_client_handle_t httpClient) {
+    while (descriptorQueue != nullptr && WiFi::IsConnected()) {
+        const sensorhub::core::EventDescriptor* event =
+            descriptorQueue->Front();
+        if (event == nullptr ||
+            SendDescriptor(httpClient, *event) == UploadResult::NotOpened) {
+            return;
+        }
+        descriptorQueue->Release();
+    }
+}
+
+static void MountSpool() {
+    const esp_partition_t* partition = PartitionFlash::Find();
+    if (partition == nullptr) {
+        ESP_LOGW(TAG_SENDER, "No spool partition, offline events are lost");
+        return;
+    }
+
+    spoolFlash = std::make_unique<PartitionFlash>(partition);
+    spool = std::make_unique<AdpcmSpool>(ConfiguredFormat(), *spoolFlash);
+    if (!spool->Mount()) {
+        Failsafe::AddFailure(TAG_SENDER, "Mounting spool failed");
+        spool.reset();
+        return;
+    }
+    ESP_LOGI(TAG_SENDER,
+             "Spool mounted - %lu sectors, pending=%lu",
+             (unsigned long)spool->SectorCount(),
+             (unsigned long)spool->PendingEvents());
+}
+
 static void SenderTask(void* arg) {
     ESP_LOGI(TAG_SENDER, "Initializing");
 
@@ -313,121 +1321,81 @@ static void SenderTask(void* arg) {
     const std::string authBearer = "Bearer " + Storage::GetAuthKey();
     esp_http_client_set_header(httpClient, "Authorization", authBearer.c_str());
 
-    for (;;) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-
-        if (ring == nullptr) {
-            continue;
-        }
-
-        const AdpcmRing::State state = ring->CurrentState();
-        if (state == AdpcmRing::State::Idle) {
-            continue;
+    // Feature-only devices keep no audio, so there is no spool to drain.
+    const bool describeOnly = Storage::GetRecordingFeaturesOnly();
+    if (describeOnly) {
+        for (;;) {
+            const bool pending =
+                descriptorQueue != nullptr && descriptorQueue->Depth() > 0;
+            ulTaskNotifyTake(pdTRUE,
+                             pending ? pdMS_TO_TICKS(5000) : portMAX_DELAY);
+            SendDescriptors(httpClient);
         }
+    }
 
-        const uint32_t preRoll =
-            s_preRollAtTrigger.load(std::memory_order_acquire);
-        const uint32_t total = preRoll + AdpcmConfig::PostRollBlocks;
-        const uint32_t totalBytes =
-            sizeof(WavHeaderImaAdpcm) + total * AdpcmConfig::BlockAlign;
+    esp_http_client_set_header(httpClient, "Trailer", BlocksTrailer);
+    MountSpool();
 
-        ESP_LOGI(
-            TAG_SENDER,
-            "Recording start - preroll=%lu post=%lu total=%lu blocks (%lu B)",
-            (unsigned long)preRoll,
-            (unsigned long)AdpcmConfig::PostRollBlocks,
-            (unsigned long)total,
-            (unsigned long)totalBytes);
-
-        UNIT_TIMER("POST request");
-
-        esp_err_t err = esp_http_client_open(httpClient, totalBytes);
-        if (err != ESP_OK) {
-            Failsafe::AddFailure(
-                TAG_SENDER,
-                "POST open failed - " + (err == ESP_ERR_HTTP_CONNECT
-                                             ? "URL not found: " + address
-                                             : esp_err_to_name(err)));
-            ring->EndRecording();
-            continue;
-        }
+    // Events are sent in the order they were queued, so this matches the
+    // producer's count of queued events.
+    uint32_t eventsSent = 0;
 
-        Output::Blink(Output::LedG, 250, true);
+    for (;;) {
+        // While recordings wait in the spool, wake up now and then to see
+        // whether the network is back.
+        const bool pending = spool != nullptr && spool->PendingEvents() > 0;
+        ulTaskNotifyTake(pdTRUE,
+                         pending ? pdMS_TO_TICKS(5000) : portMAX_DELAY);
 
-        WavHeaderImaAdpcm header(AdpcmConfig::SampleRateHz, total);
-        int written = esp_http_client_write(httpClient,
-                                            (const char*)&header,
-                                            sizeof(header));
-        if (written < 0) {
-            Failsafe::AddFailure(TAG_SENDER, "Writing WAV header failed");
-            esp_http_client_close(httpClient);
-            Output::SetContinuity(Output::LedG, false);
-            ring->EndRecording();
+        if (ring == nullptr) {
             continue;
         }
 
-        uint32_t sent = 0;
-        bool failed = false;
-        uint8_t block[AdpcmConfig::BlockAlign];
-
-        while (sent < total) {
-            if (ring->Pop(block)) {
-                int n = esp_http_client_write(httpClient,
-                                              (const char*)block,
-                                              AdpcmConfig::BlockAlign);
-                if (n != AdpcmConfig::BlockAlign) {
-                    Failsafe::AddFailure(TAG_SENDER, "HTTP write failed");
-                    failed = true;
-                    break;
-                }
-                sent++;
-            } else {
-                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+        // Events that fired during an upload are queued behind it with
+        // their own pre-roll; send them back to back. Without a network,
+        // or if the upload fails, they go to the spool instead.
+        // Spooled events leave their history behind.
+        sensorhub::core::RingEvent event;
+        while (ring->BeginEvent(event)) {
+            sensorhub::core::HistorySnapshot snapshot;
+            const bool withHistory =
+                history != nullptr &&
+                history->Ring().Snapshot(eventsSent, snapshot);
+            const uint32_t skip = withHistory ? snapshot.skipPreRoll : 0;
+            const int gainDb = eventGainDb[eventsSent % eventGainDb.size()];
+            // Sent blocks stay pinned in the ring until the upload went
+            // through, so a failed one can still be spooled from there.
+            ring->PinEvent();
+            RingSource source(skip);
+            if (!WiFi::IsConnected() ||
+                SendEvent(httpClient,
+                          source,
+                          format,
+                          event.preRoll - skip,
+                          format.SampleRateHz(),
+                          gainDb,
+                          withHistory ? &snapshot : nullptr) !=
+                    UploadResult::Sent) {
+                SpoolRingEvent(event, gainDb);
             }
+            if (withHistory) {
+                history->Ring().Release(eventsSent);
+            }
+            ring->FinishEvent();
+            eventsSent++;
         }
 
-        if (failed) {
-            esp_http_client_close(httpClient);
-            Output::SetContinuity(Output::LedG, false);
-            ring->EndRecording();
-            continue;
-        }
-
-        int statusCode = 0;
-        const bool responseOk = ReadHttpResponse(httpClient, statusCode);
-        esp_http_client_close(httpClient);
-
-        if (!responseOk) {
-            Failsafe::AddFailure(
-                TAG_SENDER,
-                "Status: " + std::to_string(statusCode) + " - empty response");
-        } else if (!Backend::CheckResponseFailed(
-                       httpPayload,
-                       (HTTP::Status::StatusCode)statusCode)) {
-            ResetValues();
-        }
-
-        const uint32_t dropped = ring->DroppedDuringRecording();
-        if (dropped > 0) {
-            ESP_LOGW(TAG_SENDER,
-                     "Recording done - sent=%lu blocks status=%d (dropped=%lu)",
-                     (unsigned long)sent,
-                     statusCode,
-                     (unsigned long)dropped);
-        } else {
-            ESP_LOGI(TAG_SENDER,
-                     "Recording done - sent=%lu blocks status=%d",
-                     (unsigned long)sent,
-                     statusCode);
-        }
-
-        Output::SetContinuity(Output::LedG, false);
-        ring->EndRecording();
+        DrainSpool(httpClient);
     }
 }
 
 static void RegisterSensors() {
-    Sensors::SensorRegistry::Instance().Register(&s_loudness);
+    auto& registry = Sensors::SensorRegistry::Instance();
+    registry.Register(&s_loudness);
+    registry.Register(&s_leq);
+    registry.Register(&s_l10);
+    registry.Register(&s_l50);
+    registry.Register(&s_l90);
 }
 
 static bool ShouldStart() {
@@ -452,6 +1420,7 @@ const Kernel::Service kService = {
     .task_entry = &vTask,
     .stack_bytes = 8192,
     .priority = tskIDLE_PRIORITY + 4,
+    .core = Constants::AnalysisCore,
     .out_handle = &xHandle,
     .should_start = &ShouldStart,
 };
@@ -503,9 +1472,11 @@ bool UpdateLoudness() {
 }
 
 float CalculateLoudness() {
-    float rms = CalculateRMS((int16_t*)audio->Buffer.get(), audio->BufferCount);
-    float decibel = 20.0f * log10f(rms / Constants::Amplitude) +
-                    Constants::RefDB + Constants::OffsetDB;
+    int32_t* samples = reinterpret_cast<int32_t*>(audio->Buffer.get());
+    sensorhub::core::UnpadI2sSlots(samples, audio->BufferCount);
+    BlockMeasurement block;
+    Measure(samples, audio->BufferCount, block);
+    float decibel = ComputeDb(block);
 
     ESP_LOGD(TAG, "Loudness: %ddB", (int)decibel);
 
@@ -520,8 +1491,29 @@ bool IsOK() {
     return isOK;
 }
 
+// Ends the reading interval once its readings are registered. Uploads
+// only reset the loudness, so the statistics cover the whole interval.
 void ResetValues() {
     loudness.Reset();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    levelStats.Reset();
+    bandTotals.Reset();
+}
+
+CaptureStats GetCaptureStats() {
+    CaptureStats stats;
+    stats.dmaOverruns = dmaOverruns.load(std::memory_order_relaxed);
+    if (captureQueue != nullptr) {
+        stats.queueDepth = captureQueue->Depth();
+        stats.maxQueueDepth = captureQueue->MaxDepth();
+        stats.queueChunks = captureQueue->Capacity();
+    }
+    return stats;
+}
+
+sensorhub::core::BandEnergies GetBandEnergies() {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return bandTotals;
 }
 
 const Reading& GetLoudness() {
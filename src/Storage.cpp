@@ -23,6 +23,17 @@ static constexpr const char* kApPass = "ap_pass";
 static constexpr const char* kDevId = "dev_id";
 static constexpr const char* kLoudThresh = "loud_thresh";
 static constexpr const char* kRegInterval = "reg_interval";
+static constexpr const char* kRecMaxSeconds = "rec_max_s";
+static constexpr const char* kRecRate = "rec_rate";
+static constexpr const char* kRecPreRoll = "rec_pre_s";
+static constexpr const char* kRecPostRoll = "rec_post_s";
+static constexpr const char* kRecSlack = "rec_slack_s";
+static constexpr const char* kRecMemory = "rec_mem_kb";
+static constexpr const char* kRecCodec = "rec_codec";
+static constexpr const char* kRecSearch = "rec_search";
+static constexpr const char* kRecBlock = "rec_block";
+static constexpr const char* kRecFeatures = "rec_features";
+static constexpr const char* kRecSilence = "rec_silence";
 static constexpr const char* kSensorsMask = "sensors_mask";
 static constexpr const char* kCfgMode = "cfg_mode";
 
@@ -52,6 +63,17 @@ static struct {
     uint32_t deviceId = 0;
     uint32_t loudnessThreshold = 0;
     uint32_t registerInterval = 0;
+    uint32_t recordingMaxSeconds = 0;
+    uint32_t recordingSampleRate = 0;
+    uint32_t recordingPreRollSeconds = 0;
+    uint32_t recordingPostRollSeconds = 0;
+    uint32_t recordingJitterSlackSeconds = 0;
+    uint32_t recordingMemoryKb = 0;
+    uint32_t recordingCodec = 0;
+    uint32_t recordingSearchDepth = 0;
+    uint32_t recordingBlockBytes = 0;
+    bool recordingFeaturesOnly = false;
+    bool recordingSilenceRuns = false;
     uint32_t sensorsMask = 0;
     bool configMode = true;
 } g_cache;
@@ -118,8 +140,30 @@ void LoadAll() {
     ESP_ERROR_CHECK(ReadU32(Keys::kDevId, g_cache.deviceId));
     ESP_ERROR_CHECK(ReadU32(Keys::kLoudThresh, g_cache.loudnessThreshold));
     ESP_ERROR_CHECK(ReadU32(Keys::kRegInterval, g_cache.registerInterval));
+    ESP_ERROR_CHECK(
+        ReadU32(Keys::kRecMaxSeconds, g_cache.recordingMaxSeconds));
+    ESP_ERROR_CHECK(ReadU32(Keys::kRecRate, g_cache.recordingSampleRate));
+    ESP_ERROR_CHECK(
+        ReadU32(Keys::kRecPreRoll, g_cache.recordingPreRollSeconds));
+    ESP_ERROR_CHECK(
+        ReadU32(Keys::kRecPostRoll, g_cache.recordingPostRollSeconds));
+    ESP_ERROR_CHECK(
+        ReadU32(Keys::kRecSlack, g_cache.recordingJitterSlackSeconds));
+    ESP_ERROR_CHECK(ReadU32(Keys::kRecMemory, g_cache.recordingMemoryKb));
+    ESP_ERROR_CHECK(ReadU32(Keys::kRecCodec, g_cache.recordingCodec));
+    ESP_ERROR_CHECK(
+        ReadU32(Keys::kRecSearch, g_cache.recordingSearchDepth));
+    ESP_ERROR_CHECK(ReadU32(Keys::kRecBlock, g_cache.recordingBlockBytes));
     ESP_ERROR_CHECK(ReadU32(Keys::kSensorsMask, g_cache.sensorsMask));
 
+    uint8_t features = 0;
+    ESP_ERROR_CHECK(ReadU8(Keys::kRecFeatures, features, 0));
+    g_cache.recordingFeaturesOnly = (features != 0);
+
+    uint8_t silence = 0;
+    ESP_ERROR_CHECK(ReadU8(Keys::kRecSilence, silence, 0));
+    g_cache.recordingSilenceRuns = (silence != 0);
+
     uint8_t cfg = 1;
     ESP_ERROR_CHECK(ReadU8(Keys::kCfgMode, cfg, 1));
     g_cache.configMode = (cfg != 0);
@@ -193,8 +237,23 @@ void WriteAll() {
     WriteU32IfChanged(Keys::kDevId, g_cache.deviceId);
     WriteU32IfChanged(Keys::kLoudThresh, g_cache.loudnessThreshold);
     WriteU32IfChanged(Keys::kRegInterval, g_cache.registerInterval);
+    WriteU32IfChanged(Keys::kRecMaxSeconds, g_cache.recordingMaxSeconds);
+    WriteU32IfChanged(Keys::kRecRate, g_cache.recordingSampleRate);
+    WriteU32IfChanged(Keys::kRecPreRoll, g_cache.recordingPreRollSeconds);
+    WriteU32IfChanged(Keys::kRecPostRoll, g_cache.recordingPostRollSeconds);
+    WriteU32IfChanged(Keys::kRecSlack, g_cache.recordingJitterSlackSeconds);
+    WriteU32IfChanged(Keys::kRecMemory, g_cache.recordingMemoryKb);
+    WriteU32IfChanged(Keys::kRecCodec, g_cache.recordingCodec);
+    WriteU32IfChanged(Keys::kRecSearch, g_cache.recordingSearchDepth);
+    WriteU32IfChanged(Keys::kRecBlock, g_cache.recordingBlockBytes);
     WriteU32IfChanged(Keys::kSensorsMask, g_cache.sensorsMask);
 
+    WriteU8IfChanged(
+        Keys::kRecFeatures,
+        static_cast<uint8_t>(g_cache.recordingFeaturesOnly ? 1 : 0));
+    WriteU8IfChanged(
+        Keys::kRecSilence,
+        static_cast<uint8_t>(g_cache.recordingSilenceRuns ? 1 : 0));
     WriteU8IfChanged(Keys::kCfgMode,
                      static_cast<uint8_t>(g_cache.configMode ? 1 : 0));
 }
@@ -365,6 +424,50 @@ uint32_t GetRegisterInterval() {
     return g_cache.registerInterval;
 }
 
+uint32_t GetRecordingMaxSeconds() {
+    return g_cache.recordingMaxSeconds;
+}
+
+uint32_t GetRecordingSampleRate() {
+    return g_cache.recordingSampleRate;
+}
+
+uint32_t GetRecordingPreRollSeconds() {
+    return g_cache.recordingPreRollSeconds;
+}
+
+uint32_t GetRecordingPostRollSeconds() {
+    return g_cache.recordingPostRollSeconds;
+}
+
+uint32_t GetRecordingJitterSlackSeconds() {
+    return g_cache.recordingJitterSlackSeconds;
+}
+
+uint32_t GetRecordingMemoryKb() {
+    return g_cache.recordingMemoryKb;
+}
+
+uint32_t GetRecordingCodec() {
+    return g_cache.recordingCodec;
+}
+
+uint32_t GetRecordingSearchDepth() {
+    return g_cache.recordingSearchDepth;
+}
+
+uint32_t GetRecordingBlockBytes() {
+    return g_cache.recordingBlockBytes;
+}
+
+bool GetRecordingFeaturesOnly() {
+    return g_cache.recordingFeaturesOnly;
+}
+
+bool GetRecordingSilenceRuns() {
+    return g_cache.recordingSilenceRuns;
+}
+
 bool GetConfigMode() {
     return g_cache.configMode;
 }
@@ -409,6 +512,50 @@ void SetRegisterInterval(uint32_t v) {
     g_cache.registerInterval = v;
 }
 
+void SetRecordingMaxSeconds(uint32_t v) {
+    g_cache.recordingMaxSeconds = v;
+}
+
+void SetRecordingSampleRate(uint32_t v) {
+    g_cache.recordingSampleRate = v;
+}
+
+void SetRecordingPreRollSeconds(uint32_t v) {
+    g_cache.recordingPreRollSeconds = v;
+}
+
+void SetRecordingPostRollSeconds(uint32_t v) {
+    g_cache.recordingPostRollSeconds = v;
+}
+
+void SetRecordingJitterSlackSeconds(uint32_t v) {
+    g_cache.recordingJitterSlackSeconds = v;
+}
+
+void SetRecordingMemoryKb(uint32_t v) {
+    g_cache.recordingMemoryKb = v;
+}
+
+void SetRecordingCodec(uint32_t v) {
+    g_cache.recordingCodec = v;
+}
+
+void SetRecordingSearchDepth(uint32_t v) {
+    g_cache.recordingSearchDepth = v;
+}
+
+void SetRecordingBlockBytes(uint32_t v) {
+    g_cache.recordingBlockBytes = v;
+}
+
+void SetRecordingFeaturesOnly(bool v) {
+    g_cache.recordingFeaturesOnly = v;
+}
+
+void SetRecordingSilenceRuns(bool v) {
+    g_cache.recordingSilenceRuns = v;
+}
+
 void SetConfigMode(bool v) {
     g_cache.configMode = v;
 }
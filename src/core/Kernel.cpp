@@ -51,12 +51,13 @@ void Boot(const Service* const* services, std::size_t count) {
             continue;
 
         TaskHandle_t handle = nullptr;
-        const BaseType_t rc = xTaskCreate(s.task_entry,
-                                          s.name,
-                                          s.stack_bytes,
-                                          nullptr,
-                                          s.priority,
-                                          &handle);
+        const BaseType_t rc = xTaskCreatePinnedToCore(s.task_entry,
+                                                      s.name,
+                                                      s.stack_bytes,
+                                                      nullptr,
+                                                      s.priority,
+                                                      &handle,
+                                                      s.core);
         if (rc != pdPASS) {
             ESP_LOGE(TAG,
                      "spawn %s FAILED rc=%d",
@@ -68,10 +69,11 @@ void Boot(const Service* const* services, std::size_t count) {
         if (s.out_handle)
             *s.out_handle = handle;
         ESP_LOGI(TAG,
-                 "spawn %s prio=%u stack=%u",
+                 "spawn %s prio=%u stack=%u core=%d",
                  s.name,
                  static_cast<unsigned>(s.priority),
-                 static_cast<unsigned>(s.stack_bytes));
+                 static_cast<unsigned>(s.stack_bytes),
+                 s.core == tskNO_AFFINITY ? -1 : static_cast<int>(s.core));
     }
 
     ESP_LOGI(TAG, "Boot complete");
@@ -0,0 +1,111 @@
+#include "Bench.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace {
+
+std::atomic<uint64_t> g_allocCount{0};
+std::atomic<uint64_t> g_allocBytes{0};
+
+std::vector<bench::Result>& Results() {
+    static std::vector<bench::Result> s_results;
+    return s_results;
+}
+
+void PrintJson(std::FILE* out, const bench::Result& r) {
+    std::fprintf(out,
+                 "{\"name\":\"%s\",\"iterations\":%llu,"
+                 "\"ns_per_op\":%.3f,\"cycles_per_op\":%.1f,"
+                 "\"cycles_per_item\":%.2f,"
+                 "\"items_per_s\":%.1f,\"bytes_per_s\":%.1f,"
+                 "\"allocs_per_op\":%.3f,\"alloc_bytes_per_op\":%.1f,"
+                 "\"compression_ratio\":%.3f,\"snr_db\":%.2f}",
+                 r.name.c_str(),
+                 static_cast<unsigned long long>(r.iterations),
+                 r.nsPerOp,
+                 r.cyclesPerOp,
+                 r.cyclesPerItem,
+                 r.itemsPerSecond,
+                 r.bytesPerSecond,
+                 r.allocationsPerOp,
+                 r.allocatedBytesPerOp,
+                 r.compressionRatio,
+                 r.snrDb);
+}
+
+void* CountedAlloc(std::size_t size) {
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+}
+
+void* operator new(std::size_t size) {
+    return CountedAlloc(size);
+}
+
+void* operator new[](std::size_t size) {
+    return CountedAlloc(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace bench {
+
+AllocCounters Allocations() {
+    return {g_allocCount.load(std::memory_order_relaxed),
+            g_allocBytes.load(std::memory_order_relaxed)};
+}
+
+void Record(const Result& result) {
+    Results().push_back(result);
+    std::printf("BENCH ");
+    PrintJson(stdout, result);
+    std::printf("\n");
+}
+
+void WriteJson() {
+    const char* path = std::getenv("SENSORHUB_BENCH_JSON");
+    if (path == nullptr || *path == '\0') {
+        return;
+    }
+    std::FILE* out = std::fopen(path, "w");
+    if (out == nullptr) {
+        std::fprintf(stderr, "bench: cannot open %s\n", path);
+        return;
+    }
+    std::fprintf(out, "[\n");
+    const auto& results = Results();
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        std::fprintf(out, "  ");
+        PrintJson(out, results[i]);
+        std::fprintf(out, i + 1 < results.size() ? ",\n" : "\n");
+    }
+    std::fprintf(out, "]\n");
+    std::fclose(out);
+}
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace bench {
+
+struct Options {
+    uint64_t itemsPerOp = 1;
+    uint64_t bytesPerOp = 0;
+    double minSeconds = 0.05;
+    int repeats = 3;
+    uint64_t fixedIterations = 0;
+    // Input bytes per output byte of a codec, measured by the caller and
+    // reported as is; 0 when it does not apply.
+    double compressionRatio = 0.0;
+    // Signal-to-noise ratio of a lossy codec, likewise; 0 when it does not
+    // apply.
+    double snrDb = 0.0;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations = 0;
+    double nsPerOp = 0.0;
+    double cyclesPerOp = 0.0;
+    double cyclesPerItem = 0.0;
+    double itemsPerSecond = 0.0;
+    double bytesPerSecond = 0.0;
+    double allocationsPerOp = 0.0;
+    double allocatedBytesPerOp = 0.0;
+    double compressionRatio = 0.0;
+    double snrDb = 0.0;
+};
+
+struct AllocCounters {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+AllocCounters Allocations();
+
+// Prints the result as one "BENCH {json}" line and keeps it for WriteJson().
+void Record(const Result& result);
+
+// Writes every recorded result as a JSON array to $SENSORHUB_BENCH_JSON,
+// if set.
+void WriteJson();
+
+inline uint64_t ReadCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void ClobberMemory() {
+    asm volatile("" : : : "memory");
+}
+
+// Runs `body(iterations)` with a doubling iteration count until one pass
+// takes at least `minSeconds`, then keeps the fastest of `repeats` passes.
+// Allocation counts are per op, averaged over the fastest pass; cycles
+// come from the TSC where available and are 0 elsewhere.
+template <typename Body>
+Result Run(const char* name, Body&& body, const Options& opts = {}) {
+    using Clock = std::chrono::steady_clock;
+
+    struct Pass {
+        double seconds;
+        uint64_t cycles;
+        AllocCounters allocs;
+    };
+
+    auto timePass = [&](uint64_t iterations) {
+        const AllocCounters before = Allocations();
+        const uint64_t startCycles = ReadCycles();
+        const auto start = Clock::now();
+        body(iterations);
+        ClobberMemory();
+        const double seconds =
+            std::chrono::duration<double>(Clock::now() - start).count();
+        const uint64_t cycles = ReadCycles() - startCycles;
+        const AllocCounters after = Allocations();
+        return Pass{seconds,
+                    cycles,
+                    {after.count - before.count, after.bytes - before.bytes}};
+    };
+
+    uint64_t iterations = opts.fixedIterations ? opts.fixedIterations : 1;
+    Pass pass = timePass(iterations);
+    while (opts.fixedIterations == 0 && pass.seconds < opts.minSeconds &&
+           iterations < (1ull << 40)) {
+        iterations *= 2;
+        pass = timePass(iterations);
+    }
+
+    Pass best = pass;
+    for (int i = 1; i < opts.repeats; ++i) {
+        pass = timePass(iterations);
+        if (pass.seconds < best.seconds) {
+            best = pass;
+        }
+    }
+
+    Result r;
+    r.name = name;
+    r.iterations = iterations;
+    r.nsPerOp = best.seconds * 1e9 / static_cast<double>(iterations);
+    r.cyclesPerOp =
+        static_cast<double>(best.cycles) / static_cast<double>(iterations);
+    r.cyclesPerItem = r.cyclesPerOp / static_cast<double>(opts.itemsPerOp);
+    r.itemsPerSecond =
+        static_cast<double>(iterations * opts.itemsPerOp) / best.seconds;
+    r.bytesPerSecond =
+        static_cast<double>(iterations * opts.bytesPerOp) / best.seconds;
+    r.allocationsPerOp = static_cast<double>(best.allocs.count) /
+                         static_cast<double>(iterations);
+    r.allocatedBytesPerOp = static_cast<double>(best.allocs.bytes) /
+                            static_cast<double>(iterations);
+    r.compressionRatio = opts.compressionRatio;
+    r.snrDb = opts.snrDb;
+    Record(r);
+    return r;
+}
+
+}
@@ -1,16 +1,40 @@
 #include <unity.h>
 
+#include <atomic>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <numbers>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "sensorhub_core/Altitude.h"
+#include "sensorhub_core/CapturePlanner.h"
+#include "sensorhub_core/EventDescriptor.h"
+#include "sensorhub_core/EventTrigger.h"
+#include "sensorhub_core/FlacLossless.h"
+#include "sensorhub_core/FrequencyWeighting.h"
+#include "sensorhub_core/HistoryRing.h"
+#include "sensorhub_core/I2sSlots.h"
 #include "sensorhub_core/ImaAdpcm.h"
+#include "sensorhub_core/ImaAdpcmBatch.h"
+#include "sensorhub_core/ImaWavStream.h"
+#include "sensorhub_core/LevelStatistics.h"
 #include "sensorhub_core/LoudnessMath.h"
 #include "sensorhub_core/MapValue.h"
+#include "sensorhub_core/PolyphaseDecimator.h"
 #include "sensorhub_core/Reading.h"
+#include "sensorhub_core/RecordingSpool.h"
 #include "sensorhub_core/Rms.h"
+#include "sensorhub_core/SignalConditioner.h"
+#include "sensorhub_core/SilenceRuns.h"
+#include "sensorhub_core/SpscBlockRing.h"
+#include "sensorhub_core/SpscChunkQueue.h"
+#include "sensorhub_core/SpscEventRing.h"
 #include "sensorhub_core/Strings.h"
+#include "sensorhub_core/ThirdOctaveAnalyzer.h"
+#include "sensorhub_core/TimeWeighting.h"
 #include "sensorhub_core/UrlValidator.h"
 
 using namespace sensorhub::core;
@@ -125,6 +149,778 @@ void test_loudness_in_range_returns_positive_db() {
     TEST_ASSERT_TRUE(spl < kInmp441PeakDb);
 }
 
+void test_sum_of_squares_is_exact_for_full_scale() {
+    std::vector<int16_t> buf(100000, -32768);
+    TEST_ASSERT_EQUAL_UINT64(100000ull * 32768ull * 32768ull,
+                             SumOfSquares(buf.data(), 100000));
+}
+
+void test_rms_keeps_precision_on_long_buffers() {
+    std::vector<int16_t> buf(1 << 20);
+    for (std::size_t i = 0; i < buf.size(); ++i) {
+        buf[i] = static_cast<int16_t>(i % 2 ? 30001 : -30001);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01f,
+                             30001.0f,
+                             CalculateRms(buf.data(),
+                                          static_cast<uint32_t>(buf.size())));
+}
+
+void test_log2_q16_matches_libm() {
+    for (uint64_t x = 1; x < (1ull << 62); x = x * 3 + 1) {
+        const double expected = std::log2(static_cast<double>(x));
+        TEST_ASSERT_FLOAT_WITHIN(1e-4, expected, Log2Q16(x) / 65536.0);
+    }
+    for (uint64_t x = 1; x < 5000; ++x) {
+        const double expected = std::log2(static_cast<double>(x));
+        TEST_ASSERT_FLOAT_WITHIN(1e-4, expected, Log2Q16(x) / 65536.0);
+    }
+}
+
+void test_fixed_spl_matches_float_path() {
+    const float amp = FullScaleAmplitude16Bit();
+    std::vector<int16_t> buf(2000);
+    for (double level = 3.0; level < 32000.0; level *= 1.37) {
+        for (std::size_t i = 0; i < buf.size(); ++i) {
+            buf[i] = static_cast<int16_t>(
+                level * std::sin(static_cast<double>(i) * 0.031));
+        }
+        const uint32_t n = static_cast<uint32_t>(buf.size());
+        const float rms = CalculateRms(buf.data(), n);
+        const float expected = 20.0f * std::log10(rms / amp) +
+                               kInmp441ReferenceSpl + kInmp441OffsetDb;
+        TEST_ASSERT_FLOAT_WITHIN(0.01f,
+                                 expected,
+                                 SplFromSumOfSquares(
+                                     SumOfSquares(buf.data(), n), n));
+
+        const float gated = RmsToSpl(rms, amp);
+        if (gated != 0.0f) {
+            TEST_ASSERT_FLOAT_WITHIN(0.01f,
+                                     gated,
+                                     SplFromSumOfSquares(
+                                         SumOfSquares(buf.data(), n), n));
+        }
+    }
+}
+
+void test_fixed_spl_of_silence_is_zero() {
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, SplFromSumOfSquares(0, 100));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, SplFromSumOfSquares(100, 0));
+}
+
+namespace {
+
+// IEC 61672-1 nominal weightings and class 1 acceptance limits.
+struct WeightingRow {
+    double freqHz;
+    double aDb;
+    double cDb;
+    double upper;
+    double lower;
+};
+
+constexpr WeightingRow kIecTable[] = {
+    {20.0, -50.5, -6.2, 2.5, 2.5},    {25.0, -44.7, -4.4, 2.5, 2.0},
+    {31.5, -39.4, -3.0, 2.0, 1.5},    {40.0, -34.6, -2.0, 1.5, 1.5},
+    {63.0, -26.2, -0.8, 1.0, 1.0},    {125.0, -16.1, -0.2, 1.0, 1.0},
+    {250.0, -8.6, 0.0, 1.0, 1.0},     {500.0, -3.2, 0.0, 1.0, 1.0},
+    {1000.0, 0.0, 0.0, 0.7, 0.7},     {2000.0, 1.2, -0.2, 1.0, 1.0},
+    {4000.0, 1.0, -0.8, 1.0, 1.0},    {5000.0, 0.5, -1.3, 1.5, 2.0},
+    {6300.0, -0.1, -2.0, 1.5, 2.0},   {8000.0, -1.1, -3.0, 1.5, 2.5},
+    {10000.0, -2.5, -4.4, 2.0, 3.0},
+};
+
+void CheckAgainstIecTable(FrequencyWeighting weighting, uint32_t fs,
+                          double maxFreqHz) {
+    const WeightingFilter filter(weighting, fs);
+    for (const WeightingRow& row : kIecTable) {
+        if (row.freqHz > maxFreqHz) {
+            break;
+        }
+        const double nominal =
+            weighting == FrequencyWeighting::A ? row.aDb : row.cDb;
+        const double got = filter.ResponseDb(row.freqHz, fs);
+        TEST_ASSERT_TRUE_MESSAGE(got <= nominal + row.upper &&
+                                     got >= nominal - row.lower,
+                                 std::to_string(row.freqHz).c_str());
+        TEST_ASSERT_FLOAT_WITHIN(
+            0.15, WeightingNominalDb(weighting, row.freqHz), nominal);
+    }
+}
+
+std::vector<int16_t> Sine(double freqHz, uint32_t fs, uint32_t count,
+                          double amplitude) {
+    std::vector<int16_t> pcm(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        pcm[i] = static_cast<int16_t>(std::lround(
+            amplitude * std::sin(2.0 * std::numbers::pi * freqHz * i / fs)));
+    }
+    return pcm;
+}
+
+}
+
+void test_a_weighting_matches_iec_table_at_32k() {
+    CheckAgainstIecTable(FrequencyWeighting::A, 32000, 10000.0);
+}
+
+void test_a_weighting_matches_iec_table_at_16k() {
+    CheckAgainstIecTable(FrequencyWeighting::A, 16000, 5000.0);
+}
+
+void test_c_weighting_matches_iec_table_at_32k() {
+    CheckAgainstIecTable(FrequencyWeighting::C, 32000, 10000.0);
+}
+
+void test_a_weighting_fixed_point_gain_matches_design() {
+    constexpr uint32_t fs = 32000;
+    for (double freq : {32.0, 250.0, 1000.0, 4000.0, 8000.0}) {
+        WeightingFilter filter(FrequencyWeighting::A, fs);
+        const auto pcm = Sine(freq, fs, fs, 12000.0);
+        filter.SumOfSquares(pcm.data(), fs / 2);
+        const uint64_t out = filter.SumOfSquares(pcm.data(), fs);
+        const uint64_t in = SumOfSquares(pcm.data(), fs);
+        const double gainDb =
+            10.0 * std::log10(static_cast<double>(out) / in);
+        TEST_ASSERT_FLOAT_WITHIN(0.05, filter.ResponseDb(freq, fs), gainDb);
+    }
+}
+
+void test_weighting_process_in_place_matches_sum_of_squares() {
+    const auto pcm = Sine(440.0, 32000, 4096, 20000.0);
+    WeightingFilter streaming(FrequencyWeighting::A, 32000);
+    WeightingFilter inPlace(FrequencyWeighting::A, 32000);
+
+    std::vector<int16_t> weighted = pcm;
+    inPlace.Process(weighted.data(), weighted.data(), 4096);
+    TEST_ASSERT_EQUAL_UINT64(SumOfSquares(weighted.data(), 4096),
+                             streaming.SumOfSquares(pcm.data(), 4096));
+}
+
+void test_weighting_rejects_dc_and_stays_silent() {
+    WeightingFilter filter(FrequencyWeighting::A, 16000);
+    std::vector<int16_t> pcm(16000, 0);
+    TEST_ASSERT_EQUAL_UINT64(0, filter.SumOfSquares(pcm.data(), 16000));
+
+    std::fill(pcm.begin(), pcm.end(), int16_t{1500});
+    filter.SumOfSquares(pcm.data(), 16000);
+    TEST_ASSERT_EQUAL_UINT64(0, filter.SumOfSquares(pcm.data(), 16000));
+}
+
+namespace {
+
+// 24-bit sine on the 16-bit scale with 8 bits of fraction.
+std::vector<int32_t> SineQ8(double freqHz, uint32_t fs, uint32_t count,
+                            double amplitude) {
+    std::vector<int32_t> pcm(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        pcm[i] = static_cast<int32_t>(std::lround(
+            256.0 * amplitude *
+            std::sin(2.0 * std::numbers::pi * freqHz * i / fs)));
+    }
+    return pcm;
+}
+
+}
+
+void test_i2s_slots_split_into_24_and_16_bits() {
+    int32_t slots[] = {0x7FFFFF00,
+                       static_cast<int32_t>(0x80000000),
+                       0x00018000,
+                       -0x00018000,
+                       0x00017F00,
+                       0x12345600};
+    int16_t out[6];
+    SplitI2sSlots(slots, 6, out);
+    const int32_t samples[] = {0x7FFFFF, -0x800000, 0x180, -0x180, 0x17F,
+                               0x123456};
+    TEST_ASSERT_EQUAL_INT32_ARRAY(samples, slots, 6);
+    // Rounded to nearest, halves up; the top saturates.
+    const int16_t rounded[] = {32767, -32768, 2, -1, 1, 0x1234};
+    TEST_ASSERT_EQUAL_INT16_ARRAY(rounded, out, 6);
+
+    int32_t padded[] = {0x00000100, -0x00000100, 0x7FFFFF00};
+    UnpadI2sSlots(padded, 3);
+    TEST_ASSERT_EQUAL_INT32(1, padded[0]);
+    TEST_ASSERT_EQUAL_INT32(-1, padded[1]);
+    TEST_ASSERT_EQUAL_INT32(0x7FFFFF, padded[2]);
+}
+
+void test_weighting_q8_measures_below_one_lsb() {
+    constexpr uint32_t fs = 32000;
+    // 0.8 LSB peak at 1 kHz, where A-weighting is 0 dB: 0.32 LSB^2.
+    const auto fine = SineQ8(1000.0, fs, fs, 0.8);
+    const auto coarse = Sine(1000.0, fs, fs, 0.8);
+    const double expected = 10.0 * std::log10(0.32);
+
+    WeightingFilter q8(FrequencyWeighting::A, fs);
+    WeightingFilter q0(FrequencyWeighting::A, fs);
+    q8.SumOfSquaresQ8(fine.data(), fs / 2);
+    q0.SumOfSquares(coarse.data(), fs / 2);
+    uint64_t fineSum = 0;
+    for (uint32_t at = fs / 2; at < fs; at += 101) {
+        fineSum += q8.SumOfSquaresQ8(fine.data() + at,
+                                     std::min<uint32_t>(101, fs - at));
+    }
+    const uint64_t coarseSum = q0.SumOfSquares(coarse.data() + fs / 2, fs / 2);
+
+    const double fineDb = 10.0 * std::log10(fineSum / (fs / 2.0));
+    const double coarseDb = 10.0 * std::log10(coarseSum / (fs / 2.0));
+    TEST_ASSERT_FLOAT_WITHIN(0.1, expected, fineDb);
+    TEST_ASSERT_TRUE(std::fabs(coarseDb - expected) > 1.0);
+
+    // Loud signals measure the same either way.
+    const auto loud = Sine(1000.0, fs, 4096, 20000.0);
+    std::vector<int32_t> loudQ8(loud.begin(), loud.end());
+    for (auto& s : loudQ8) {
+        s *= 256;
+    }
+    WeightingFilter a(FrequencyWeighting::A, fs);
+    WeightingFilter b(FrequencyWeighting::A, fs);
+    const double ratio =
+        static_cast<double>(a.SumOfSquaresQ8(loudQ8.data(), 4096)) /
+        static_cast<double>(b.SumOfSquares(loud.data(), 4096));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 1.0, ratio);
+    TEST_ASSERT_EQUAL_UINT64(
+        (SumOfSquaresQ8(loudQ8.data(), 4096)),
+        SumOfSquares(loud.data(), 4096));
+}
+
+void test_z_weighting_passes_through() {
+    WeightingFilter filter;
+    const auto pcm = Sine(1000.0, 16000, 512, 30000.0);
+    std::vector<int16_t> out(512);
+    filter.Process(pcm.data(), out.data(), 512);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(pcm.data(), out.data(), 512);
+    TEST_ASSERT_EQUAL_STRING("dB", WeightingUnit(filter.Weighting()));
+}
+
+namespace {
+
+void FeedConstant(ExponentialLevel& level, float meanSquare, uint32_t block,
+                  uint32_t samples) {
+    for (uint32_t done = 0; done < samples; done += block) {
+        level.Add(static_cast<uint64_t>(meanSquare * block), block);
+    }
+}
+
+}
+
+void test_spl_from_mean_square_matches_sum_of_squares() {
+    TEST_ASSERT_FLOAT_WITHIN(
+        0.01f, SplFromSumOfSquares(4000000ull * 505, 505),
+        SplFromMeanSquare(4000000.0f));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, SplFromMeanSquare(0.0f));
+}
+
+void test_fast_level_is_block_size_independent() {
+    ExponentialLevel small(TimeWeighting::Fast, 32000);
+    ExponentialLevel large(TimeWeighting::Fast, 32000);
+    FeedConstant(small, 1.0e6f, 500, 64000);
+    FeedConstant(large, 1.0e6f, 4000, 64000);
+    FeedConstant(small, 1.0e4f, 500, 16000);
+    FeedConstant(large, 1.0e4f, 4000, 16000);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, large.Spl(), small.Spl());
+}
+
+void test_slow_step_response_follows_time_constant() {
+    ExponentialLevel level(TimeWeighting::Slow, 16000);
+    FeedConstant(level, 1.0e6f, 2000, 16000 * 10);
+    FeedConstant(level, 0.0f, 2000, 16000);
+    TEST_ASSERT_FLOAT_WITHIN(
+        100.0f, 1.0e6f * std::exp(-1.0f), level.MeanSquare());
+}
+
+void test_impulse_rises_fast_and_decays_slowly() {
+    ExponentialLevel level(TimeWeighting::Impulse, 32000);
+    FeedConstant(level, 1.0e2f, 505, 32000);
+    const float quiet = level.Spl();
+
+    FeedConstant(level, 1.0e6f, 505, 32000 / 5);
+    const float loud = level.Spl();
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, quiet + 40.0f, loud);
+
+    ExponentialLevel fall = level;
+    FeedConstant(fall, 1.0e2f, 505, 32000 / 5);
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, loud - 0.58f, fall.Spl());
+}
+
+void test_level_statistics_percentiles_of_uniform_levels() {
+    LevelStatistics stats;
+    for (int i = 0; i < 4000; ++i) {
+        stats.Add(40.0f + i * 0.01f, 1000, 100);
+    }
+    TEST_ASSERT_EQUAL_UINT32(4000, stats.Observations());
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, 76.0f, stats.Exceeded(10.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, 60.0f, stats.Exceeded(50.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, 44.0f, stats.Exceeded(90.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 79.99f, stats.Max());
+}
+
+void test_level_statistics_leq_is_energy_average() {
+    LevelStatistics stats;
+    for (int i = 0; i < 100; ++i) {
+        stats.Add(50.0f, 10000ull * 505, 505);
+        stats.Add(70.0f, 1000000ull * 505, 505);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, SplFromMeanSquare(505000.0f), stats.Leq());
+}
+
+void test_level_statistics_reset_and_empty() {
+    LevelStatistics stats;
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.Exceeded(10.0f));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.Leq());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.Max());
+
+    stats.Add(200.0f, 1, 1);
+    stats.Add(-20.0f, 1, 1);
+    TEST_ASSERT_TRUE(stats.Exceeded(10.0f) <= 128.0f);
+    TEST_ASSERT_TRUE(stats.Exceeded(90.0f) >= 0.0f);
+
+    stats.Reset();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Observations());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.Leq());
+}
+
+void test_third_octave_band_layout_follows_sample_rate() {
+    const ThirdOctaveAnalyzer at32k(32000);
+    TEST_ASSERT_EQUAL_INT(23, at32k.TopBand());
+    TEST_ASSERT_EQUAL_INT(8, at32k.StageCount());
+
+    const ThirdOctaveAnalyzer at16k(16000);
+    TEST_ASSERT_EQUAL_UINT16(5000, kThirdOctaveNominalHz[at16k.TopBand()]);
+    TEST_ASSERT_EQUAL_INT(7, at16k.StageCount());
+}
+
+void test_third_octave_band_edges_are_half_power() {
+    const ThirdOctaveAnalyzer analyzer(32000);
+    const double edge = std::exp2(1.0 / 6.0);
+    for (int band = 0; band <= analyzer.TopBand(); ++band) {
+        const double fc = ThirdOctaveCentreHz(band);
+        TEST_ASSERT_FLOAT_WITHIN(
+            0.05, 0.0, analyzer.ResponseDb(band, fc, 32000));
+        TEST_ASSERT_FLOAT_WITHIN(
+            0.05, -3.01, analyzer.ResponseDb(band, fc * edge, 32000));
+        TEST_ASSERT_FLOAT_WITHIN(
+            0.05, -3.01, analyzer.ResponseDb(band, fc / edge, 32000));
+    }
+}
+
+void test_third_octave_tone_lands_in_its_band() {
+    constexpr uint32_t fs = 32000;
+    for (int band : {1, 8, 13, 19, 22}) {
+        ThirdOctaveAnalyzer analyzer(fs);
+        const auto pcm = Sine(ThirdOctaveCentreHz(band), fs, 2 * fs, 10000.0);
+        BandEnergies energies;
+        analyzer.Process(pcm.data(), fs, energies);
+        energies.Reset();
+        analyzer.Process(pcm.data() + fs, fs, energies);
+
+        const float expected =
+            SplFromSumOfSquares(SumOfSquares(pcm.data(), fs), fs);
+        TEST_ASSERT_FLOAT_WITHIN(0.3f, expected, energies.Level(band));
+        for (int other = 0; other < kThirdOctaveBandCount; ++other) {
+            if (other != band) {
+                TEST_ASSERT_TRUE(energies.Level(other) < expected - 10.0f);
+            }
+        }
+    }
+}
+
+void test_third_octave_q8_keeps_quiet_bands() {
+    constexpr uint32_t fs = 16000;
+    constexpr int band = 13;
+    const auto fine = SineQ8(1000.0, fs, 2 * fs, 0.8);
+    const auto coarse = Sine(1000.0, fs, 2 * fs, 0.8);
+
+    ThirdOctaveAnalyzer q8(fs);
+    ThirdOctaveAnalyzer q0(fs);
+    BandEnergies fineBands;
+    BandEnergies coarseBands;
+    q8.ProcessQ8(fine.data(), fs, fineBands);
+    q0.Process(coarse.data(), fs, coarseBands);
+    fineBands.Reset();
+    coarseBands.Reset();
+    for (uint32_t at = fs; at < 2 * fs; at += 505) {
+        q8.ProcessQ8(fine.data() + at,
+                     std::min<uint32_t>(505, 2 * fs - at),
+                     fineBands);
+    }
+    q0.Process(coarse.data() + fs, fs, coarseBands);
+
+    const float expected = SplFromMeanSquare(0.32f);
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, expected, fineBands.Level(band));
+    TEST_ASSERT_TRUE(std::fabs(coarseBands.Level(band) - expected) > 1.0f);
+}
+
+void test_band_energies_merge_and_reset() {
+    BandEnergies a;
+    BandEnergies b;
+    a.energy[3] = 100;
+    a.samples[3] = 10;
+    b.energy[3] = 300;
+    b.samples[3] = 10;
+    a.Add(b);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, SplFromSumOfSquares(20, 1), a.Level(3));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, a.Level(4));
+    a.Reset();
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, a.Level(3));
+}
+
+void test_decimator_response_is_flat_then_stops() {
+    for (int factor : {2, 4}) {
+        PolyphaseDecimator decimator(factor);
+        // Frequencies as fractions of the output rate.
+        for (double f = 0.0; f <= 0.43; f += 0.01) {
+            const float db =
+                static_cast<float>(decimator.ResponseDb(f / factor));
+            TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, db);
+        }
+        for (double f = 0.57; f <= factor / 2.0; f += 0.01) {
+            TEST_ASSERT_TRUE(decimator.ResponseDb(f / factor) < -70.0);
+        }
+    }
+}
+
+void test_decimator_passes_tone_and_rejects_alias() {
+    constexpr uint32_t fs = 32000;
+    for (int factor : {2, 4}) {
+        const uint32_t outRate = fs / factor;
+        const auto pass = Sine(0.2 * outRate, fs, fs, 10000.0);
+        const auto alias = Sine(0.75 * outRate, fs, fs, 10000.0);
+
+        for (const auto* pcm : {&pass, &alias}) {
+            PolyphaseDecimator decimator(factor);
+            std::vector<int16_t> out(pcm->size());
+            const uint32_t n = decimator.Process(pcm->data(),
+                                                 fs,
+                                                 out.data());
+            TEST_ASSERT_EQUAL_UINT32(outRate, n);
+
+            // Skip the filter's settling time.
+            const uint32_t skip = PolyphaseDecimator::kTapsPerPhase;
+            const float in = SplFromSumOfSquares(SumOfSquares(pcm->data(), fs),
+                                                 fs);
+            const float level = SplFromSumOfSquares(
+                SumOfSquares(out.data() + skip, n - skip),
+                n - skip);
+            if (pcm == &pass) {
+                TEST_ASSERT_FLOAT_WITHIN(0.05f, in, level);
+            } else {
+                TEST_ASSERT_TRUE(level < in - 60.0f);
+            }
+        }
+    }
+}
+
+void test_decimator_carries_partial_periods_in_place() {
+    const auto pcm = Sine(1000.0, 32000, 4000, 12000.0);
+
+    PolyphaseDecimator whole(4);
+    std::vector<int16_t> expected(pcm.size());
+    const uint32_t n = whole.Process(pcm.data(), 4000, expected.data());
+    TEST_ASSERT_EQUAL_UINT32(1000, n);
+
+    PolyphaseDecimator split(4);
+    std::vector<int16_t> buffer = pcm;
+    uint32_t written = 0;
+    for (uint32_t at = 0; at < 4000;) {
+        const uint32_t count = std::min<uint32_t>(37, 4000 - at);
+        written += split.Process(buffer.data() + at,
+                                 count,
+                                 buffer.data() + written);
+        at += count;
+    }
+    TEST_ASSERT_EQUAL_UINT32(n, written);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), buffer.data(), n);
+
+    PolyphaseDecimator bypass(1);
+    TEST_ASSERT_EQUAL_UINT32(4000,
+                             bypass.Process(pcm.data(), 4000, buffer.data()));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(pcm.data(), buffer.data(), 4000);
+}
+
+namespace {
+
+// Feeds `blocks` copies of `levelDb` and returns how many events fired.
+int FeedLevel(EventTrigger& trigger, float levelDb, int blocks) {
+    int events = 0;
+    for (int i = 0; i < blocks; ++i) {
+        events += trigger.Update(levelDb) ? 1 : 0;
+    }
+    return events;
+}
+
+TriggerConfig QuickTrigger() {
+    TriggerConfig config;
+    config.marginDb = 12.0f;
+    config.rearmHysteresisDb = 3.0f;
+    config.onsetBlocks = 3;
+    return config;
+}
+
+}
+
+void test_trigger_needs_consecutive_onset_blocks() {
+    EventTrigger trigger(QuickTrigger());
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 40.0f, 50));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 52.0f, trigger.Threshold());
+
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 60.0f, 2));
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 40.0f, 1));
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 60.0f, 2));
+    TEST_ASSERT_TRUE(trigger.Update(60.0f));
+    TEST_ASSERT_FALSE(trigger.Armed());
+}
+
+void test_trigger_rearms_below_hysteresis_band() {
+    EventTrigger trigger(QuickTrigger());
+    FeedLevel(trigger, 40.0f, 50);
+    TEST_ASSERT_EQUAL_INT(1, FeedLevel(trigger, 60.0f, 20));
+
+    // Between threshold - hysteresis and threshold: still disarmed.
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 50.0f, 5));
+    TEST_ASSERT_FALSE(trigger.Armed());
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 60.0f, 5));
+
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 40.0f, 1));
+    TEST_ASSERT_TRUE(trigger.Armed());
+    TEST_ASSERT_EQUAL_INT(1, FeedLevel(trigger, 60.0f, 3));
+}
+
+void test_trigger_cooldown_spaces_events() {
+    TriggerConfig config = QuickTrigger();
+    config.cooldownBlocks = 100;
+    EventTrigger trigger(config);
+    FeedLevel(trigger, 40.0f, 50);
+    TEST_ASSERT_EQUAL_INT(1, FeedLevel(trigger, 60.0f, 3));
+
+    FeedLevel(trigger, 40.0f, 10);
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 60.0f, 80));
+    TEST_ASSERT_EQUAL_INT(1, FeedLevel(trigger, 60.0f, 10));
+}
+
+void test_trigger_floor_adapts_to_steady_noise() {
+    EventTrigger trigger(QuickTrigger());
+    FeedLevel(trigger, 40.0f, 50);
+    // A site that gets permanently louder fires once, then learns the new
+    // floor instead of firing again.
+    TEST_ASSERT_EQUAL_INT(1, FeedLevel(trigger, 60.0f, 10000));
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 60.0f, trigger.NoiseFloor());
+    TEST_ASSERT_TRUE(trigger.Armed());
+
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 70.0f, 10));
+    TEST_ASSERT_EQUAL_INT(1, FeedLevel(trigger, 75.0f, 3));
+}
+
+void test_trigger_floor_speed_does_not_follow_block_size() {
+    constexpr uint32_t kRate = 16000;
+    float seconds[2] = {};
+    const uint32_t blockSamples[2] = {505, 4081};
+    for (int i = 0; i < 2; ++i) {
+        TriggerConfig config = QuickTrigger();
+        config.floorStepDb = FloorStepDb(3.2f, blockSamples[i], kRate);
+        EventTrigger trigger(config);
+        FeedLevel(trigger, 40.0f, 1);
+        const float start = trigger.NoiseFloor();
+        uint32_t blocks = 0;
+        while (trigger.NoiseFloor() < start + 10.0f) {
+            trigger.Update(60.0f);
+            ++blocks;
+        }
+        seconds[i] = static_cast<float>(blocks * blockSamples[i]) / kRate;
+    }
+    // 10 dB at 0.32 dB/s, to within one of the longer blocks.
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, 31.25f, seconds[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, seconds[0], seconds[1]);
+}
+
+void test_trigger_respects_absolute_minimum() {
+    TriggerConfig config = QuickTrigger();
+    config.minLevelDb = 70.0f;
+    EventTrigger trigger(config);
+    FeedLevel(trigger, 30.0f, 50);
+    TEST_ASSERT_EQUAL_FLOAT(70.0f, trigger.Threshold());
+    TEST_ASSERT_EQUAL_INT(0, FeedLevel(trigger, 65.0f, 10));
+    TEST_ASSERT_EQUAL_INT(1, FeedLevel(trigger, 72.0f, 3));
+}
+
+void test_extent_runs_while_sustained_and_releases() {
+    ExtentConfig config;
+    config.minPostBlocks = 3;
+    config.releaseBlocks = 2;
+    EventExtent extent(config);
+
+    // Dies away at once: ends after the minimum post-roll.
+    extent.Start(5);
+    TEST_ASSERT_FALSE(extent.Update(false));
+    TEST_ASSERT_FALSE(extent.Update(false));
+    TEST_ASSERT_TRUE(extent.Update(false));
+    TEST_ASSERT_EQUAL_UINT32(8, extent.Blocks());
+
+    // Sustained: runs on, then ends `releaseBlocks` after it goes quiet.
+    extent.Start(5);
+    for (int i = 0; i < 20; ++i) {
+        TEST_ASSERT_FALSE(extent.Update(true));
+    }
+    TEST_ASSERT_FALSE(extent.Update(false));
+    TEST_ASSERT_FALSE(extent.Update(true));
+    TEST_ASSERT_FALSE(extent.Update(false));
+    TEST_ASSERT_TRUE(extent.Update(false));
+    TEST_ASSERT_EQUAL_UINT32(29, extent.Blocks());
+}
+
+void test_extent_stops_at_maximum_length() {
+    ExtentConfig config;
+    config.releaseBlocks = 2;
+    config.maxBlocks = 10;
+    EventExtent extent(config);
+
+    extent.Start(4);
+    int blocks = 0;
+    while (!extent.Update(true)) {
+        ++blocks;
+    }
+    TEST_ASSERT_EQUAL_INT(5, blocks);
+    TEST_ASSERT_EQUAL_UINT32(10, extent.Blocks());
+}
+
+void test_trigger_sustains_within_hysteresis_band() {
+    EventTrigger trigger(QuickTrigger());
+    FeedLevel(trigger, 40.0f, 50);
+    TEST_ASSERT_TRUE(trigger.Sustains(52.0f));
+    TEST_ASSERT_TRUE(trigger.Sustains(49.5f));
+    TEST_ASSERT_FALSE(trigger.Sustains(48.5f));
+}
+
+namespace {
+
+constexpr uint32_t kDescriptorRate = 16000;
+constexpr uint32_t kDescriptorBlock = 505;
+
+// Measures blocks the way the recorder does and feeds them to a builder.
+struct DescriptorRig {
+    WeightingFilter weighting{FrequencyWeighting::A, kDescriptorRate};
+    ThirdOctaveAnalyzer analyzer{kDescriptorRate};
+    ExponentialLevel level{TimeWeighting::Fast, kDescriptorRate};
+    DescriptorBuilder builder{kDescriptorRate};
+
+    void Feed(const std::vector<int16_t>& pcm, uint32_t blocks) {
+        for (uint32_t i = 0; i < blocks; ++i) {
+            const int16_t* block = pcm.data() + i * kDescriptorBlock;
+            BandEnergies bands;
+            analyzer.Process(block, kDescriptorBlock, bands);
+            const uint64_t sum =
+                weighting.SumOfSquares(block, kDescriptorBlock);
+            level.Add(sum, kDescriptorBlock);
+            builder.Add(sum, kDescriptorBlock, bands, level.Spl());
+        }
+    }
+};
+
+std::vector<int16_t> ToneBlocks(uint32_t blocks) {
+    return Sine(1000.0, kDescriptorRate, blocks * kDescriptorBlock, 10000.0);
+}
+
+std::vector<int16_t> SilentBlocks(uint32_t blocks) {
+    return std::vector<int16_t>(blocks * kDescriptorBlock);
+}
+
+}
+
+void test_descriptor_summarises_a_tone_event() {
+    DescriptorRig rig;
+    rig.Feed(SilentBlocks(20), 20);
+    const auto tone = ToneBlocks(40);
+    rig.Feed(tone, 2);
+    TEST_ASSERT_EQUAL_UINT32(2, rig.builder.Begin(2));
+    TEST_ASSERT_TRUE(rig.builder.Active());
+    rig.Feed(std::vector<int16_t>(tone.begin() + 2 * kDescriptorBlock,
+                                  tone.end()),
+             38);
+    const EventDescriptor d = rig.builder.Finish();
+    TEST_ASSERT_FALSE(rig.builder.Active());
+
+    TEST_ASSERT_EQUAL_UINT32(40 * kDescriptorBlock * 1000 / kDescriptorRate,
+                             d.durationMs);
+    const float tonePower = SplFromSumOfSquares(
+        SumOfSquares(tone.data(), kDescriptorBlock), kDescriptorBlock);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, tonePower, d.leqDb);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, tonePower, d.peakDb);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, tonePower, d.bandDb[13]);
+    for (int b = 0; b < kThirdOctaveBandCount; ++b) {
+        if (b != 13) {
+            TEST_ASSERT_TRUE(d.bandDb[b] < d.bandDb[13] - 10.0f);
+        }
+    }
+    TEST_ASSERT_FLOAT_WITHIN(100.0f, 1000.0f, d.centroidHz);
+    // The onset is in the pre-roll; a steady tone has no other.
+    TEST_ASSERT_EQUAL_UINT32(1, d.onsets);
+    TEST_ASSERT_TRUE(d.flux > 0.0f && d.flux < 0.1f);
+}
+
+void test_descriptor_counts_onsets_of_bursts() {
+    DescriptorRig rig;
+    // 5 ms fades, so a burst stops without a click of its own.
+    auto tone = ToneBlocks(6);
+    constexpr uint32_t kFade = kDescriptorRate / 200;
+    for (uint32_t i = 0; i < kFade; ++i) {
+        const double gain = 0.5 - 0.5 * std::cos(std::numbers::pi * i / kFade);
+        tone[i] = static_cast<int16_t>(std::lround(tone[i] * gain));
+        tone[tone.size() - 1 - i] = static_cast<int16_t>(
+            std::lround(tone[tone.size() - 1 - i] * gain));
+    }
+    const auto silence = SilentBlocks(6);
+    rig.Feed(silence, 6);
+    rig.Feed(tone, 1);
+    rig.builder.Begin(1);
+    rig.Feed(std::vector<int16_t>(tone.begin() + kDescriptorBlock,
+                                  tone.end()),
+             5);
+    for (int burst = 1; burst < 5; ++burst) {
+        rig.Feed(silence, 6);
+        rig.Feed(tone, 6);
+    }
+    const EventDescriptor d = rig.builder.Finish();
+    TEST_ASSERT_EQUAL_UINT32(5, d.onsets);
+    TEST_ASSERT_TRUE(d.flux > 0.1f);
+
+    // Blocks held before the next event do not carry this one's onsets.
+    rig.Feed(tone, 3);
+    rig.builder.Begin(2);
+    TEST_ASSERT_EQUAL_UINT32(0, rig.builder.Finish().onsets);
+}
+
+void test_descriptor_json_stays_under_one_kilobyte() {
+    EventDescriptor d;
+    d.durationMs = 600000;
+    d.peakDb = 119.9f;
+    d.leqDb = 110.25f;
+    d.centroidHz = 9999.6f;
+    d.flux = 0.12345f;
+    d.onsets = 4000000000u;
+    d.bandDb.fill(-100.5f);
+    d.bandDb[3] = 0.0f;
+
+    char json[1024];
+    const size_t n = FormatDescriptorJson(d, json, sizeof(json));
+    TEST_ASSERT_TRUE(n > 0 && n < 1024);
+    TEST_ASSERT_EQUAL_size_t(std::strlen(json), n);
+    const std::string text(json, n);
+    TEST_ASSERT_EQUAL_INT(0,
+                          text.find("{\"duration_ms\":600000,\"peak_db\":119.9,"
+                                    "\"leq_db\":110.2,\"centroid_hz\":10000,"
+                                    "\"flux\":0.123,\"onsets\":4000000000,"
+                                    "\"bands\":{\"50\":-100.5,"));
+    TEST_ASSERT_TRUE(text.find("\"100\"") == std::string::npos);
+    TEST_ASSERT_TRUE(text.ends_with(",\"10000\":-100.5}}"));
+
+    TEST_ASSERT_EQUAL_size_t(0, FormatDescriptorJson(d, json, n));
+    TEST_ASSERT_EQUAL_size_t(n, FormatDescriptorJson(d, json, n + 1));
+    TEST_ASSERT_EQUAL_size_t(0, FormatDescriptorJson(d, json, 40));
+}
+
 void test_url_accepts_well_formed_https() {
     TEST_ASSERT_TRUE(IsAllowedBackendUrl("https://sadra.nl/api/"));
     TEST_ASSERT_TRUE(IsAllowedBackendUrl("https://example.com"));
@@ -251,46 +1047,2050 @@ void test_adpcm_block_rejects_wrong_size() {
     TEST_ASSERT_FALSE(enc.EncodeWavBlock(samples, 10, block));
 }
 
-int main(int, char**) {
-    UNITY_BEGIN();
+void test_adpcm_batch_kernel_matches_reference() {
+    ImaAdpcmEncoder fast;
+    ImaAdpcmEncoder reference;
+    int16_t samples[kImaWavSamplesPerBlock];
+    uint8_t fastBlock[kImaWavBlockAlign];
+    uint8_t refBlock[kImaWavBlockAlign];
 
-    RUN_TEST(test_reading_default_state_accepts_negative_values);
-    RUN_TEST(test_reading_tracks_min_and_max);
-    RUN_TEST(test_reading_reset_collapses_to_current);
+    uint32_t lcg = 12345;
+    for (int block = 0; block < 64; ++block) {
+        for (std::size_t i = 0; i < kImaWavSamplesPerBlock; ++i) {
+            lcg = lcg * 1664525u + 1013904223u;
+            const int noise = static_cast<int16_t>(lcg >> 16);
+            const double tone =
+                std::sin(static_cast<double>(block * 505 + i) * 0.05);
+            int v = 0;
+            switch (block % 4) {
+                case 0:
+                    v = noise;
+                    break;
+                case 1:
+                    v = static_cast<int>(tone * 32767.0);
+                    break;
+                case 2:
+                    v = (i / 7) % 2 ? 32767 : -32768;
+                    break;
+                default:
+                    v = noise >> 6;
+                    break;
+            }
+            samples[i] = static_cast<int16_t>(v);
+        }
 
-    RUN_TEST(test_mapvalue_linear);
-    RUN_TEST(test_mapvalue_zero_range_returns_sentinel);
+        TEST_ASSERT_TRUE(
+            fast.EncodeWavBlock(samples, kImaWavSamplesPerBlock, fastBlock));
+        TEST_ASSERT_TRUE(reference.EncodeWavBlockReference(
+            samples, kImaWavSamplesPerBlock, refBlock));
+        TEST_ASSERT_EQUAL_MEMORY(refBlock, fastBlock, kImaWavBlockAlign);
+        TEST_ASSERT_EQUAL_INT16(reference.Predictor(), fast.Predictor());
+        TEST_ASSERT_EQUAL_INT8(reference.Index(), fast.Index());
+    }
+}
 
-    RUN_TEST(test_remove_trailing_whitespace_basic);
-    RUN_TEST(test_remove_trailing_whitespace_all_blank);
-    RUN_TEST(test_remove_trailing_whitespace_empty);
+void test_adpcm_fast_sample_matches_reference_exhaustively() {
+    for (int index = 0; index <= 88; ++index) {
+        for (int predictor = -32768; predictor <= 32767; predictor += 4093) {
+            for (int sample = -32768; sample <= 32767; sample += 37) {
+                ImaAdpcmEncoder reference;
+                reference.SetState(static_cast<int16_t>(predictor),
+                                   static_cast<int8_t>(index));
+                ImaChannelState st{predictor, index};
 
-    RUN_TEST(test_altitude_at_sea_level_is_zero);
-    RUN_TEST(test_altitude_decreases_with_lower_pressure);
+                const uint8_t code =
+                    reference.EncodeSample(static_cast<int16_t>(sample));
+                TEST_ASSERT_EQUAL_UINT8(code, ImaEncodeSampleFast(st, sample));
+                TEST_ASSERT_EQUAL_INT(reference.Predictor(), st.predictor);
+                TEST_ASSERT_EQUAL_INT(reference.Index(), st.index);
+            }
+        }
+    }
+}
 
-    RUN_TEST(test_rms_of_zeros_is_zero);
-    RUN_TEST(test_rms_of_empty_buffer_is_zero);
-    RUN_TEST(test_rms_of_constant_signal);
-    RUN_TEST(test_rms_of_alternating_signal);
+namespace {
 
-    RUN_TEST(test_loudness_zero_rms_returns_zero);
-    RUN_TEST(test_loudness_below_floor_returns_zero);
-    RUN_TEST(test_loudness_in_range_returns_positive_db);
+// Squared error of `blocks` blocks of tone and noise through `enc` and a
+// standard IMA decoder, which must agree with the encoder's state.
+double LookaheadError(ImaAdpcmEncoder& enc, int blocks) {
+    int16_t samples[kImaWavSamplesPerBlock];
+    uint8_t block[kImaWavBlockAlign];
+    uint32_t lcg = 99;
+    double error = 0.0;
+    for (int b = 0; b < blocks; ++b) {
+        for (std::size_t i = 0; i < kImaWavSamplesPerBlock; ++i) {
+            lcg = lcg * 1664525u + 1013904223u;
+            const double tone =
+                12000.0 * std::sin(static_cast<double>(b * 505 + i) * 0.07);
+            samples[i] = static_cast<int16_t>(
+                tone + static_cast<int16_t>(lcg >> 16) / 16);
+        }
+        TEST_ASSERT_TRUE(
+            enc.EncodeWavBlock(samples, kImaWavSamplesPerBlock, block));
 
-    RUN_TEST(test_url_accepts_well_formed_https);
-    RUN_TEST(test_url_rejects_http_by_default);
-    RUN_TEST(test_url_rejects_other_schemes);
-    RUN_TEST(test_url_rejects_userinfo);
-    RUN_TEST(test_url_rejects_ip_literal_by_default);
-    RUN_TEST(test_url_accepts_ip_literal_when_allowed);
-    RUN_TEST(test_url_rejects_no_host);
-    RUN_TEST(test_url_rejects_whitespace);
-    RUN_TEST(test_url_rejects_oversized);
-    RUN_TEST(test_url_rejects_bare_localhost);
+        ImaAdpcmDecoder dec;
+        dec.SetState(static_cast<int16_t>(block[0] | (block[1] << 8)),
+                     static_cast<int8_t>(block[2]));
+        int16_t decoded = samples[0];
+        for (std::size_t i = 1; i < kImaWavSamplesPerBlock; ++i) {
+            const uint8_t byte = block[4 + (i - 1) / 2];
+            decoded = dec.DecodeSample(i % 2 ? byte & 0x0F : byte >> 4);
+            const double err = samples[i] - decoded;
+            error += err * err;
+        }
+        TEST_ASSERT_EQUAL_INT16(enc.Predictor(), decoded);
+    }
+    return error;
+}
 
-    RUN_TEST(test_adpcm_round_trip_silence);
-    RUN_TEST(test_adpcm_round_trip_ramp_is_close);
-    RUN_TEST(test_adpcm_block_rejects_wrong_size);
+}
+
+void test_adpcm_lookahead_lowers_error_for_standard_decoder() {
+    ImaAdpcmEncoder greedy;
+    const double greedyError = LookaheadError(greedy, 8);
+
+    double previous = greedyError;
+    for (int depth = 1; depth <= kImaMaxSearchDepth; ++depth) {
+        ImaAdpcmEncoder enc;
+        enc.SetSearchDepth(depth);
+        const double error = LookaheadError(enc, 8);
+        TEST_ASSERT_TRUE(error < previous);
+        previous = error;
+    }
+    // 0.8 is about 1 dB better at the deepest search.
+    TEST_ASSERT_TRUE(previous < greedyError * 0.8);
+}
+
+void test_adpcm_lookahead_depth_zero_is_greedy() {
+    ImaAdpcmEncoder enc;
+    enc.SetSearchDepth(kImaMaxSearchDepth + 3);
+    TEST_ASSERT_EQUAL_INT(kImaMaxSearchDepth, enc.SearchDepth());
+    enc.SetSearchDepth(-1);
+    TEST_ASSERT_EQUAL_INT(0, enc.SearchDepth());
+
+    int16_t samples[kImaWavSamplesPerBlock];
+    for (std::size_t i = 0; i < kImaWavSamplesPerBlock; ++i) {
+        samples[i] = static_cast<int16_t>(20000.0 * std::sin(i * 0.3));
+    }
+    ImaChannelState greedy{samples[0], 0};
+    ImaChannelState search = greedy;
+    uint8_t a[kImaWavBlockAlign - 4];
+    uint8_t b[kImaWavBlockAlign - 4];
+    ImaEncodeNibbles(greedy, samples + 1, kImaWavSamplesPerBlock - 1, a);
+    ImaEncodeNibblesLookahead(search,
+                              samples + 1,
+                              kImaWavSamplesPerBlock - 1,
+                              0,
+                              b);
+    TEST_ASSERT_EQUAL_MEMORY(a, b, sizeof(a));
+    TEST_ASSERT_EQUAL_INT(greedy.predictor, search.predictor);
+    TEST_ASSERT_EQUAL_INT(greedy.index, search.index);
+}
+
+void test_dc_blocker_removes_offset_and_passes_audio() {
+    TEST_ASSERT_EQUAL_INT(8, DcBlocker(32000).Shift());
+    TEST_ASSERT_EQUAL_INT(7, DcBlocker(16000).Shift());
+    TEST_ASSERT_EQUAL_INT(6, DcBlocker(8000).Shift());
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 20.0, DcBlocker(8000).CutoffHz(8000));
+
+    constexpr uint32_t fs = 16000;
+    auto pcm = Sine(1000.0, fs, fs, 8000.0);
+    for (auto& s : pcm) {
+        s = static_cast<int16_t>(s - 1500);
+    }
+    DcBlocker dc(fs);
+    std::vector<int16_t> out(pcm.size());
+    dc.Process(pcm.data(), static_cast<uint32_t>(pcm.size()), out.data());
+
+    // No step at start-up, and no offset once settled.
+    TEST_ASSERT_INT_WITHIN(1, 0, out[0]);
+    double sum = 0.0, inPower = 0.0, outPower = 0.0;
+    for (uint32_t i = fs / 4; i < fs; ++i) {
+        sum += out[i];
+        inPower += (pcm[i] + 1500.0) * (pcm[i] + 1500.0);
+        outPower += static_cast<double>(out[i]) * out[i];
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 0.0, sum / (fs - fs / 4));
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 0.0, 10.0 * std::log10(outPower / inPower));
+}
+
+void test_agc_gain_only_moves_on_settle() {
+    AgcConfig config;
+    config.maxGainDb = 24;
+    config.targetPeak = 8192;
+    config.releaseBlocks = 64;
+    BlockAgc agc(config);
+    TEST_ASSERT_EQUAL_INT(0, agc.GainDb());
+
+    // A quiet level asks for more gain than allowed.
+    agc.Track(100);
+    TEST_ASSERT_EQUAL_INT(0, agc.GainDb());
+    TEST_ASSERT_EQUAL_INT(24, agc.Settle());
+
+    // A loud block raises the level at once; 8192 / 4000 is 6.2 dB.
+    agc.Track(4000);
+    TEST_ASSERT_EQUAL_INT(4000, agc.Level());
+    TEST_ASSERT_EQUAL_INT(24, agc.GainDb());
+    TEST_ASSERT_EQUAL_INT(6, agc.Settle());
+
+    // It falls back by 1/e over the release.
+    for (int i = 0; i < 64; ++i) {
+        agc.Track(0);
+    }
+    TEST_ASSERT_INT_WITHIN(30, 1472, agc.Level());
+    TEST_ASSERT_EQUAL_INT(14, agc.Settle());
+
+    agc.SetGainDb(24);
+    TEST_ASSERT_INT_WITHIN(2, 15849, agc.Scale(1000));
+    TEST_ASSERT_INT_WITHIN(2, -15849, agc.Scale(-1000));
+    TEST_ASSERT_EQUAL_INT(INT16_MAX, agc.Scale(INT16_MAX));
+    TEST_ASSERT_EQUAL_INT(INT16_MIN, agc.Scale(INT16_MIN));
+}
+
+namespace {
+
+// One second of INMP441-like capture at 16 kHz: a DC offset, hiss below
+// an LSB with more energy low down, and a voice-like tone stack at about
+// `level` peak that comes and goes four times a second.
+std::vector<int16_t> MicFixture(int offset, double level, uint32_t seed) {
+    constexpr uint32_t fs = 16000;
+    std::vector<int16_t> pcm(fs);
+    double hiss = 0.0;
+    for (uint32_t i = 0; i < fs; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        hiss = 0.9 * hiss + static_cast<int16_t>(seed >> 16) / 32768.0;
+        const double t = static_cast<double>(i) / fs;
+        double voice = 0.0;
+        for (int h = 1; h <= 4; ++h) {
+            voice += std::sin(2.0 * std::numbers::pi * 180.0 * h * t) / h;
+        }
+        const double envelope =
+            0.5 + 0.5 * std::sin(2.0 * std::numbers::pi * 4.0 * t);
+        pcm[i] = static_cast<int16_t>(
+            std::lround(offset + hiss + level * 0.5 * envelope * voice));
+    }
+    return pcm;
+}
+
+// Coding SNR of IMA ADPCM on `pcm`, against its AC part, with the blocks
+// scaled by `gain` on the way in and back on the way out.
+double AdpcmSnrDb(const std::vector<int16_t>& pcm,
+                  const std::vector<int16_t>& coded, double gain) {
+    ImaAdpcmEncoder enc;
+    uint8_t block[kImaWavBlockAlign];
+    double mean = 0.0;
+    for (int16_t s : pcm) {
+        mean += s;
+    }
+    mean /= static_cast<double>(pcm.size());
+
+    double signal = 0.0, error = 0.0;
+    for (std::size_t at = 0; at + kImaWavSamplesPerBlock <= coded.size();
+         at += kImaWavSamplesPerBlock) {
+        const int16_t* in = coded.data() + at;
+        TEST_ASSERT_TRUE(enc.EncodeWavBlock(in, kImaWavSamplesPerBlock, block));
+        ImaAdpcmDecoder dec;
+        dec.SetState(static_cast<int16_t>(block[0] | (block[1] << 8)),
+                     static_cast<int8_t>(block[2]));
+        for (std::size_t i = 1; i < kImaWavSamplesPerBlock; ++i) {
+            const uint8_t byte = block[4 + (i - 1) / 2];
+            const int16_t decoded =
+                dec.DecodeSample(i % 2 ? byte & 0x0F : byte >> 4);
+            const double err = (decoded - in[i]) / gain;
+            const double ac = pcm[at + i] - mean;
+            signal += ac * ac;
+            error += err * err;
+        }
+    }
+    return 10.0 * std::log10(signal / error);
+}
+
+}
+
+void test_conditioning_improves_adpcm_snr_on_mic_fixtures() {
+    // Quiet audio sits at the bottom of the IMA step table, where the gain
+    // buys several dB. From a few hundred LSB up the coder's SNR hardly
+    // depends on the level, and the gain must not cost much there.
+    struct Fixture {
+        int offset;
+        double level;
+        double minImprovementDb;
+    };
+    for (const Fixture& f : {Fixture{-900, 20.0, 5.0},
+                             Fixture{-900, 60.0, 5.0},
+                             Fixture{-300, 400.0, -1.5},
+                             Fixture{200, 5000.0, -0.5}}) {
+        const auto pcm = MicFixture(f.offset, f.level, 7);
+        const double raw = AdpcmSnrDb(pcm, pcm, 1.0);
+
+        // A first pass stands in for the audio before the event, and
+        // settles the gain the event is coded with.
+        AgcConfig agc;
+        SignalConditioner conditioner(16000, 20.0, agc);
+        auto coded = pcm;
+        conditioner.Process(coded.data(), static_cast<uint32_t>(coded.size()));
+        conditioner.Agc().Settle();
+        coded = pcm;
+        conditioner.Process(coded.data(), static_cast<uint32_t>(coded.size()));
+        const int gainDb = conditioner.Agc().GainDb();
+        const double conditioned =
+            AdpcmSnrDb(pcm, coded, std::pow(10.0, gainDb / 20.0));
+
+        const std::string what = std::to_string(f.level) + ": " +
+                                 std::to_string(raw) + " -> " +
+                                 std::to_string(conditioned) + " dB at +" +
+                                 std::to_string(gainDb) + " dB";
+        TEST_ASSERT_TRUE_MESSAGE(conditioned > raw + f.minImprovementDb,
+                                 what.c_str());
+    }
+}
+
+namespace {
+
+void PutLe16(std::vector<uint8_t>& v, uint16_t x) {
+    v.push_back(static_cast<uint8_t>(x));
+    v.push_back(static_cast<uint8_t>(x >> 8));
+}
+
+void PutLe32(std::vector<uint8_t>& v, uint32_t x) {
+    PutLe16(v, static_cast<uint16_t>(x));
+    PutLe16(v, static_cast<uint16_t>(x >> 16));
+}
+
+void PutLe32At(std::vector<uint8_t>& v, std::size_t at, uint32_t x) {
+    for (int i = 0; i < 4; ++i) {
+        v[at + i] = static_cast<uint8_t>(x >> (8 * i));
+    }
+}
+
+void PutTag(std::vector<uint8_t>& v, const char* tag) {
+    for (int i = 0; i < 4; ++i) {
+        v.push_back(static_cast<uint8_t>(tag[i]));
+    }
+}
+
+std::vector<uint8_t> EncodeTestBlocks(
+    std::size_t blocks, uint16_t blockAlign = kImaWavBlockAlign) {
+    const std::size_t spb = ImaSamplesPerBlock(blockAlign);
+    std::vector<uint8_t> out(blocks * blockAlign);
+    std::vector<int16_t> samples(spb);
+    ImaAdpcmEncoder enc;
+    uint32_t lcg = 99;
+    for (std::size_t b = 0; b < blocks; ++b) {
+        for (std::size_t i = 0; i < spb; ++i) {
+            lcg = lcg * 1664525u + 1013904223u;
+            const double t = static_cast<double>(b * spb + i);
+            samples[i] = static_cast<int16_t>(
+                20000.0 * std::sin(t * 0.01 * (1 + b % 3)) +
+                static_cast<int16_t>(lcg >> 16) / 32);
+        }
+        enc.EncodeWavBlock(samples.data(),
+                           spb,
+                           out.data() + b * blockAlign,
+                           blockAlign);
+    }
+    return out;
+}
+
+std::vector<int16_t> DecodeWithReference(
+    const std::vector<uint8_t>& adpcm,
+    uint16_t blockAlign = kImaWavBlockAlign) {
+    std::vector<int16_t> pcm;
+    for (std::size_t off = 0; off < adpcm.size(); off += blockAlign) {
+        const uint8_t* block = adpcm.data() + off;
+        ImaAdpcmDecoder dec;
+        const int16_t first = static_cast<int16_t>(block[0] | (block[1] << 8));
+        dec.SetState(first, static_cast<int8_t>(block[2]));
+        pcm.push_back(first);
+        for (std::size_t i = 4; i < blockAlign; ++i) {
+            pcm.push_back(dec.DecodeSample(block[i] & 0x0F));
+            pcm.push_back(dec.DecodeSample(block[i] >> 4));
+        }
+    }
+    return pcm;
+}
+
+std::vector<uint8_t> BuildImaWav(const std::vector<uint8_t>& adpcm,
+                                 bool withListChunk,
+                                 uint16_t blockAlign = kImaWavBlockAlign) {
+    const uint32_t spb = static_cast<uint32_t>(ImaSamplesPerBlock(blockAlign));
+    const uint32_t blocks = static_cast<uint32_t>(adpcm.size() / blockAlign);
+    std::vector<uint8_t> wav;
+    PutTag(wav, "RIFF");
+    PutLe32(wav, 0);
+    PutTag(wav, "WAVE");
+
+    PutTag(wav, "fmt ");
+    PutLe32(wav, 20);
+    PutLe16(wav, 0x0011);
+    PutLe16(wav, 1);
+    PutLe32(wav, 32000);
+    PutLe32(wav, 32000 * blockAlign / spb);
+    PutLe16(wav, blockAlign);
+    PutLe16(wav, 4);
+    PutLe16(wav, 2);
+    PutLe16(wav, static_cast<uint16_t>(spb));
+
+    if (withListChunk) {
+        PutTag(wav, "LIST");
+        PutLe32(wav, 3);
+        wav.insert(wav.end(), {'a', 'b', 'c', 0});
+    }
+
+    PutTag(wav, "fact");
+    PutLe32(wav, 4);
+    PutLe32(wav, blocks * spb);
+
+    PutTag(wav, "data");
+    PutLe32(wav, static_cast<uint32_t>(adpcm.size()));
+    wav.insert(wav.end(), adpcm.begin(), adpcm.end());
+    return wav;
+}
+
+}
+
+void test_adpcm_lane_decoder_matches_reference() {
+    const auto adpcm = EncodeTestBlocks(21);
+    const auto expected = DecodeWithReference(adpcm);
+
+    std::vector<int16_t> pcm(expected.size());
+    ImaDecodeBlocks(adpcm.data(), 21, kImaWavBlockAlign, pcm.data());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), pcm.data(), pcm.size());
+
+    std::vector<int16_t> parallel(expected.size());
+    ImaDecodeBlocksParallel(adpcm.data(),
+                            21,
+                            kImaWavBlockAlign,
+                            parallel.data(),
+                            3);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(),
+                                  parallel.data(),
+                                  parallel.size());
+}
+
+void test_adpcm_parallel_decoder_splits_large_inputs() {
+    const auto adpcm = EncodeTestBlocks(300);
+    const auto expected = DecodeWithReference(adpcm);
+
+    std::vector<int16_t> pcm(expected.size());
+    ImaDecodeBlocksParallel(adpcm.data(),
+                            300,
+                            kImaWavBlockAlign,
+                            pcm.data(),
+                            4);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), pcm.data(), pcm.size());
+}
+
+void test_wav_stream_parser_decodes_across_odd_chunks() {
+    const auto adpcm = EncodeTestBlocks(10);
+    const auto expected = DecodeWithReference(adpcm);
+    const auto wav = BuildImaWav(adpcm, true);
+
+    ImaWavStreamParser parser;
+    std::vector<int16_t> pcm;
+    auto sink = [&](const uint8_t* blocks, std::size_t count) {
+        const std::size_t at = pcm.size();
+        pcm.resize(at + count * kImaWavSamplesPerBlock);
+        ImaDecodeBlocks(blocks, count, kImaWavBlockAlign, pcm.data() + at);
+    };
+
+    ImaWavStreamParser::Status status = ImaWavStreamParser::Status::NeedMore;
+    for (std::size_t off = 0; off < wav.size(); off += 37) {
+        const std::size_t n = std::min<std::size_t>(37, wav.size() - off);
+        status = parser.Feed(wav.data() + off, n, sink);
+    }
+
+    TEST_ASSERT_TRUE(status == ImaWavStreamParser::Status::Done);
+    TEST_ASSERT_EQUAL_UINT32(32000, parser.Format().sampleRate);
+    TEST_ASSERT_EQUAL_UINT16(kImaWavBlockAlign, parser.Format().blockAlign);
+    TEST_ASSERT_EQUAL_UINT32(10 * kImaWavSamplesPerBlock,
+                             parser.Format().numSamples);
+    TEST_ASSERT_EQUAL_UINT32(10, parser.BlocksEmitted());
+    TEST_ASSERT_EQUAL_size_t(expected.size(), pcm.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), pcm.data(), pcm.size());
+}
+
+void test_wav_stream_parser_decodes_larger_blocks() {
+    for (uint16_t blockAlign : {512, 1024, 2048}) {
+        const std::size_t spb = ImaSamplesPerBlock(blockAlign);
+        const auto adpcm = EncodeTestBlocks(5, blockAlign);
+        const auto expected = DecodeWithReference(adpcm, blockAlign);
+        const auto wav = BuildImaWav(adpcm, false, blockAlign);
+
+        ImaWavStreamParser parser;
+        std::vector<int16_t> pcm;
+        auto sink = [&](const uint8_t* blocks, std::size_t count) {
+            const std::size_t at = pcm.size();
+            pcm.resize(at + count * spb);
+            ImaDecodeBlocks(blocks, count, blockAlign, pcm.data() + at);
+        };
+        TEST_ASSERT_TRUE(parser.Feed(wav.data(), wav.size(), sink) ==
+                         ImaWavStreamParser::Status::Done);
+        TEST_ASSERT_EQUAL_UINT16(blockAlign, parser.Format().blockAlign);
+        TEST_ASSERT_EQUAL_UINT32(5 * spb, parser.Format().numSamples);
+        TEST_ASSERT_EQUAL_size_t(5 * spb, pcm.size());
+        TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), pcm.data(), pcm.size());
+    }
+}
+
+void test_adpcm_block_size_must_match_sample_count() {
+    ImaAdpcmEncoder enc;
+    std::vector<int16_t> samples(ImaSamplesPerBlock(1024));
+    std::vector<uint8_t> block(1024);
+    TEST_ASSERT_EQUAL_size_t(2041, samples.size());
+    TEST_ASSERT_TRUE(
+        enc.EncodeWavBlock(samples.data(), 2041, block.data(), 1024));
+    TEST_ASSERT_TRUE(enc.EncodeWavBlockReference(samples.data(),
+                                                 2041,
+                                                 block.data(),
+                                                 1024));
+    TEST_ASSERT_FALSE(enc.EncodeWavBlock(samples.data(),
+                                         kImaWavSamplesPerBlock,
+                                         block.data(),
+                                         1024));
+    TEST_ASSERT_FALSE(enc.EncodeWavBlock(samples.data(), 2041, block.data()));
+    TEST_ASSERT_FALSE(enc.EncodeWavBlock(samples.data(), 1, block.data(), 4));
+}
+
+void test_wav_stream_parser_reads_streamed_length_to_end() {
+    const auto adpcm = EncodeTestBlocks(6);
+    auto wav = BuildImaWav(adpcm, false);
+    const std::size_t header = wav.size() - adpcm.size();
+    for (std::size_t at : {std::size_t{4}, header - 4}) {
+        PutLe32At(wav, at, kImaWavStreamingLength);
+    }
+    // Plus half a block that never completed.
+    wav.insert(wav.end(), kImaWavBlockAlign / 2, 0);
+
+    ImaWavStreamParser parser;
+    uint32_t blocks = 0;
+    auto sink = [&](const uint8_t*, std::size_t count) {
+        blocks += static_cast<uint32_t>(count);
+    };
+    TEST_ASSERT_TRUE(parser.Feed(wav.data(), wav.size(), sink) ==
+                     ImaWavStreamParser::Status::NeedMore);
+    TEST_ASSERT_TRUE(parser.Finish() == ImaWavStreamParser::Status::Done);
+    TEST_ASSERT_EQUAL_UINT32(6, blocks);
+    TEST_ASSERT_EQUAL_UINT32(6 * kImaWavBlockAlign,
+                             parser.Format().dataLength);
+    TEST_ASSERT_EQUAL_UINT32(6 * kImaWavSamplesPerBlock,
+                             parser.Format().numSamples);
+}
+
+void test_wav_stream_parser_splits_history_from_recording() {
+    auto body = BuildImaWav(EncodeTestBlocks(3), false);
+    const std::size_t historyBytes = body.size();
+    const auto adpcm = EncodeTestBlocks(4);
+    auto recording = BuildImaWav(adpcm, false);
+    const std::size_t header = recording.size() - adpcm.size();
+    for (std::size_t at : {std::size_t{4}, header - 4}) {
+        PutLe32At(recording, at, kImaWavStreamingLength);
+    }
+    body.insert(body.end(), recording.begin(), recording.end());
+
+    uint32_t blocks = 0;
+    auto sink = [&](const uint8_t*, std::size_t count) {
+        blocks += static_cast<uint32_t>(count);
+    };
+    ImaWavStreamParser history;
+    TEST_ASSERT_TRUE(history.Feed(body.data(), body.size(), sink) ==
+                     ImaWavStreamParser::Status::Done);
+    TEST_ASSERT_EQUAL_UINT32(3, blocks);
+    TEST_ASSERT_TRUE(history.BytesConsumed() == historyBytes);
+
+    blocks = 0;
+    ImaWavStreamParser main;
+    main.Feed(body.data() + historyBytes, body.size() - historyBytes, sink);
+    TEST_ASSERT_TRUE(main.Finish() == ImaWavStreamParser::Status::Done);
+    TEST_ASSERT_EQUAL_UINT32(4, blocks);
+}
+
+void test_wav_stream_parser_stops_after_empty_data_chunk() {
+    auto body = BuildImaWav({}, false);
+    const std::size_t historyBytes = body.size();
+    const auto recording = BuildImaWav(EncodeTestBlocks(2), false);
+    body.insert(body.end(), recording.begin(), recording.end());
+
+    uint32_t blocks = 0;
+    auto sink = [&](const uint8_t*, std::size_t count) {
+        blocks += static_cast<uint32_t>(count);
+    };
+    ImaWavStreamParser history;
+    TEST_ASSERT_TRUE(history.Feed(body.data(), body.size(), sink) ==
+                     ImaWavStreamParser::Status::Done);
+    TEST_ASSERT_EQUAL_UINT32(0, blocks);
+    TEST_ASSERT_TRUE(history.BytesConsumed() == historyBytes);
+
+    ImaWavStreamParser main;
+    TEST_ASSERT_TRUE(main.Feed(body.data() + historyBytes,
+                               body.size() - historyBytes,
+                               sink) == ImaWavStreamParser::Status::Done);
+    TEST_ASSERT_EQUAL_UINT32(2, blocks);
+}
+
+void test_wav_stream_parser_finish_rejects_short_fixed_length() {
+    const auto wav = BuildImaWav(EncodeTestBlocks(3), false);
+
+    ImaWavStreamParser parser;
+    parser.Feed(wav.data(),
+                wav.size() - kImaWavBlockAlign,
+                [](const uint8_t*, std::size_t) {});
+    TEST_ASSERT_TRUE(parser.Finish() == ImaWavStreamParser::Status::Error);
+}
+
+void test_wav_stream_parser_rejects_pcm_format() {
+    auto wav = BuildImaWav(EncodeTestBlocks(1), false);
+    wav[20] = 0x01;
+
+    ImaWavStreamParser parser;
+    const auto status =
+        parser.Feed(wav.data(), wav.size(), [](const uint8_t*, std::size_t) {
+            TEST_FAIL_MESSAGE("sink must not run");
+        });
+    TEST_ASSERT_TRUE(status == ImaWavStreamParser::Status::Error);
+}
+
+void test_wav_stream_parser_rejects_data_before_fmt() {
+    std::vector<uint8_t> wav;
+    PutTag(wav, "RIFF");
+    PutLe32(wav, 0);
+    PutTag(wav, "WAVE");
+    PutTag(wav, "data");
+    PutLe32(wav, 0);
+
+    ImaWavStreamParser parser;
+    const auto status = parser.Feed(wav.data(),
+                                    wav.size(),
+                                    [](const uint8_t*, std::size_t) {});
+    TEST_ASSERT_TRUE(status == ImaWavStreamParser::Status::Error);
+}
+
+void test_silence_gate_holds_before_leaving_out() {
+    SilenceConfig config;
+    config.marginDb = 6.0f;
+    config.holdBlocks = 3;
+    SilenceGate gate(config);
+
+    TEST_ASSERT_FALSE(gate.Update(70.0f, 40.0f));
+    for (int i = 0; i < 3; ++i) {
+        TEST_ASSERT_FALSE(gate.Update(45.0f, 40.0f));
+    }
+    TEST_ASSERT_TRUE(gate.Update(46.0f, 40.0f));
+    TEST_ASSERT_TRUE(gate.Update(30.0f, 40.0f));
+
+    // One block above the margin and the hold starts over.
+    TEST_ASSERT_FALSE(gate.Update(46.5f, 40.0f));
+    for (int i = 0; i < 3; ++i) {
+        TEST_ASSERT_FALSE(gate.Update(40.0f, 40.0f));
+    }
+    TEST_ASSERT_TRUE(gate.Update(40.0f, 40.0f));
+    gate.Reset();
+    TEST_ASSERT_FALSE(gate.Update(40.0f, 40.0f));
+}
+
+namespace {
+
+std::vector<uint8_t> StreamedImaWavHeader() {
+    auto wav = BuildImaWav({}, false);
+    for (std::size_t at : {std::size_t{4}, wav.size() - 12, wav.size() - 4}) {
+        PutLe32At(wav, at, kImaWavStreamingLength);
+    }
+    return wav;
+}
+
+}
+
+void test_silence_runs_expand_to_standard_wav() {
+    const auto adpcm = EncodeTestBlocks(8);
+    const auto block = [&](std::size_t i) {
+        return adpcm.begin() + i * kImaWavBlockAlign;
+    };
+    auto upload = StreamedImaWavHeader();
+    const std::size_t header = upload.size();
+    upload.insert(upload.end(), block(0), block(2));
+    uint8_t run[kSilenceRunBytes];
+    WriteSilenceRun(5, run);
+    upload.insert(upload.end(), run, run + sizeof(run));
+    upload.insert(upload.end(), block(7), block(8));
+    // Plus half a block that never completed.
+    upload.insert(upload.end(), kImaWavBlockAlign / 2, 0);
+
+    std::vector<uint8_t> wav;
+    TEST_ASSERT_TRUE(ExpandSilenceRuns(upload.data(), upload.size(), wav));
+    TEST_ASSERT_TRUE(wav.size() == header + 8 * kImaWavBlockAlign);
+
+    // Exact lengths, so the parser is done without Finish().
+    ImaWavStreamParser parser;
+    std::vector<uint8_t> blocks;
+    auto sink = [&](const uint8_t* data, std::size_t count) {
+        blocks.insert(blocks.end(), data, data + count * kImaWavBlockAlign);
+    };
+    TEST_ASSERT_TRUE(parser.Feed(wav.data(), wav.size(), sink) ==
+                     ImaWavStreamParser::Status::Done);
+    TEST_ASSERT_EQUAL_UINT32(8 * kImaWavSamplesPerBlock,
+                             parser.Format().numSamples);
+    TEST_ASSERT_EQUAL_UINT32(wav.size() - 8,
+                             wav[4] | (wav[5] << 8) | (wav[6] << 16) |
+                                 (wav[7] << 24));
+
+    const auto expected = DecodeWithReference(adpcm);
+    const auto pcm = DecodeWithReference(blocks);
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), pcm.size());
+    for (std::size_t i = 0; i < pcm.size(); ++i) {
+        const std::size_t n = i / kImaWavSamplesPerBlock;
+        TEST_ASSERT_EQUAL_INT16(n >= 2 && n < 7 ? 0 : expected[i], pcm[i]);
+    }
+}
+
+void test_silence_runs_expand_every_wav_in_upload_body() {
+    // History WAV with exact lengths, then the streamed recording, as
+    // SendEvent() writes them.
+    auto history = BuildImaWav(EncodeTestBlocks(3), false);
+    PutLe32At(history, 4, static_cast<uint32_t>(history.size() - 8));
+    const auto adpcm = EncodeTestBlocks(4);
+    auto upload = history;
+    const auto recording = StreamedImaWavHeader();
+    upload.insert(upload.end(), recording.begin(), recording.end());
+    upload.insert(upload.end(), adpcm.begin(),
+                  adpcm.begin() + kImaWavBlockAlign);
+    uint8_t run[kSilenceRunBytes];
+    WriteSilenceRun(2, run);
+    upload.insert(upload.end(), run, run + sizeof(run));
+    upload.insert(upload.end(), adpcm.end() - kImaWavBlockAlign, adpcm.end());
+
+    std::vector<uint8_t> wav;
+    TEST_ASSERT_TRUE(ExpandSilenceRuns(upload.data(), upload.size(), wav));
+    TEST_ASSERT_TRUE(wav.size() ==
+                     history.size() + recording.size() + 4 * kImaWavBlockAlign);
+    TEST_ASSERT_TRUE(std::equal(history.begin(), history.end(), wav.begin()));
+
+    ImaWavStreamParser parser;
+    std::size_t blocks = 0;
+    auto sink = [&](const uint8_t*, std::size_t count) { blocks += count; };
+    TEST_ASSERT_TRUE(parser.Feed(wav.data() + history.size(),
+                                 wav.size() - history.size(),
+                                 sink) == ImaWavStreamParser::Status::Done);
+    TEST_ASSERT_EQUAL_UINT32(4, blocks);
+    TEST_ASSERT_EQUAL_UINT32(4 * kImaWavSamplesPerBlock,
+                             parser.Format().numSamples);
+
+    // Bytes after a WAV with exact lengths that are not another WAV.
+    upload = history;
+    upload.insert(upload.end(), 16, 0);
+    TEST_ASSERT_FALSE(ExpandSilenceRuns(upload.data(), upload.size(), wav));
+}
+
+void test_silence_runs_reject_bad_streams() {
+    const auto adpcm = EncodeTestBlocks(1);
+    auto upload = StreamedImaWavHeader();
+    upload.insert(upload.end(), adpcm.begin(), adpcm.end());
+    std::vector<uint8_t> wav;
+
+    auto pcm = upload;
+    pcm[20] = 0x01;
+    TEST_ASSERT_FALSE(ExpandSilenceRuns(pcm.data(), pcm.size(), wav));
+
+    // A run that would pass 4 GB.
+    uint8_t run[kSilenceRunBytes];
+    WriteSilenceRun(UINT32_MAX / kImaWavBlockAlign, run);
+    upload.insert(upload.end(), run, run + sizeof(run));
+    TEST_ASSERT_FALSE(ExpandSilenceRuns(upload.data(), upload.size(), wav));
+
+    const uint8_t text[] = "not a wav file";
+    TEST_ASSERT_FALSE(ExpandSilenceRuns(text, sizeof(text), wav));
+}
+
+namespace {
+
+constexpr uint16_t kRingBlock = 16;
+
+void FillBlock(uint8_t* block, uint32_t seq) {
+    for (uint16_t i = 0; i < kRingBlock; ++i) {
+        block[i] = static_cast<uint8_t>(seq + i);
+    }
+}
+
+bool BlockMatches(const uint8_t* block, uint32_t seq) {
+    for (uint16_t i = 0; i < kRingBlock; ++i) {
+        if (block[i] != static_cast<uint8_t>(seq + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+void test_ring_idle_keeps_newest_preroll_window() {
+    uint8_t storage[8 * kRingBlock];
+    SpscBlockRing ring(storage, kRingBlock, 8, 5);
+    uint8_t block[kRingBlock];
+
+    for (uint32_t seq = 0; seq < 20; ++seq) {
+        FillBlock(block, seq);
+        ring.PushOverwrite(block);
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, ring.Size());
+    TEST_ASSERT_FALSE(ring.Pop(block));
+
+    TEST_ASSERT_EQUAL_UINT32(5, ring.BeginRecording());
+    for (uint32_t seq = 15; seq < 20; ++seq) {
+        TEST_ASSERT_TRUE(ring.Pop(block));
+        TEST_ASSERT_TRUE(BlockMatches(block, seq));
+    }
+    TEST_ASSERT_FALSE(ring.Pop(block));
+}
+
+void test_ring_recording_drops_when_full() {
+    uint8_t storage[4 * kRingBlock];
+    SpscBlockRing ring(storage, kRingBlock, 4, 2);
+    uint8_t block[kRingBlock];
+
+    FillBlock(block, 0);
+    ring.PushOverwrite(block);
+    TEST_ASSERT_EQUAL_UINT32(1, ring.BeginRecording());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.BeginRecording());
+
+    for (uint32_t seq = 1; seq < 6; ++seq) {
+        FillBlock(block, seq);
+        ring.PushPreserve(block);
+    }
+    TEST_ASSERT_EQUAL_UINT32(4, ring.Size());
+    TEST_ASSERT_EQUAL_UINT32(3, ring.PostRollProduced());
+    TEST_ASSERT_EQUAL_UINT32(2, ring.DroppedDuringRecording());
+
+    ring.PushOverwrite(block);
+    TEST_ASSERT_EQUAL_UINT32(4, ring.Size());
+}
+
+void test_ring_state_transitions() {
+    uint8_t storage[4 * kRingBlock];
+    SpscBlockRing ring(storage, kRingBlock, 4, 2);
+    uint8_t block[kRingBlock] = {0};
+
+    ring.MarkPostRollDone();
+    TEST_ASSERT_TRUE(ring.CurrentState() == SpscBlockRing::State::Idle);
+
+    ring.PushOverwrite(block);
+    ring.BeginRecording();
+    TEST_ASSERT_TRUE(ring.CurrentState() == SpscBlockRing::State::Recording);
+
+    ring.MarkPostRollDone();
+    TEST_ASSERT_TRUE(ring.CurrentState() ==
+                     SpscBlockRing::State::PostCaptureDrain);
+    TEST_ASSERT_FALSE(ring.PushPreserve(block));
+
+    ring.EndRecording();
+    TEST_ASSERT_TRUE(ring.CurrentState() == SpscBlockRing::State::Idle);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.Size());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.PostRollProduced());
+}
+
+void test_ring_reserve_commit_writes_in_place() {
+    uint8_t storage[4 * kRingBlock];
+    SpscBlockRing ring(storage, kRingBlock, 4, 2);
+
+    TEST_ASSERT_NULL(ring.ReservePreserve());
+    uint8_t* slot = ring.ReserveOverwrite();
+    TEST_ASSERT_TRUE(slot >= storage && slot < storage + sizeof(storage));
+    FillBlock(slot, 7);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.Size());
+    ring.CommitOverwrite();
+    TEST_ASSERT_EQUAL_UINT32(1, ring.Size());
+
+    TEST_ASSERT_NULL(ring.PeekFront());
+    ring.BeginRecording();
+    TEST_ASSERT_NULL(ring.ReserveOverwrite());
+
+    slot = ring.ReservePreserve();
+    TEST_ASSERT_NOT_NULL(slot);
+    FillBlock(slot, 8);
+    ring.CommitPreserve();
+    TEST_ASSERT_EQUAL_UINT32(1, ring.PostRollProduced());
+
+    const uint8_t* front = ring.PeekFront();
+    TEST_ASSERT_NOT_NULL(front);
+    TEST_ASSERT_TRUE(BlockMatches(front, 7));
+    TEST_ASSERT_TRUE(front == ring.PeekFront());
+    ring.ReleaseFront();
+
+    front = ring.PeekFront();
+    TEST_ASSERT_NOT_NULL(front);
+    TEST_ASSERT_TRUE(BlockMatches(front, 8));
+    ring.ReleaseFront();
+    TEST_ASSERT_NULL(ring.PeekFront());
+}
+
+void test_ring_reserve_preserve_counts_drop_when_full() {
+    uint8_t storage[2 * kRingBlock];
+    SpscBlockRing ring(storage, kRingBlock, 2, 1);
+    uint8_t block[kRingBlock] = {0};
+
+    ring.PushOverwrite(block);
+    ring.BeginRecording();
+    TEST_ASSERT_NOT_NULL(ring.ReservePreserve());
+    ring.CommitPreserve();
+    TEST_ASSERT_NULL(ring.ReservePreserve());
+    TEST_ASSERT_EQUAL_UINT32(1, ring.DroppedDuringRecording());
+}
+
+void test_ring_spsc_stress_preserves_order() {
+    constexpr uint32_t kCapacity = 7;
+    constexpr uint32_t kEvents = 200;
+    constexpr uint32_t kPostRoll = 50;
+
+    std::vector<uint8_t> storage(kCapacity * kRingBlock);
+    SpscBlockRing ring(storage.data(), kRingBlock, kCapacity, 3);
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> orderErrors{0};
+    std::atomic<uint32_t> received{0};
+
+    std::thread consumer([&] {
+        uint8_t block[kRingBlock];
+        uint32_t expected = 0;
+        bool synced = false;
+        while (!done.load(std::memory_order_acquire)) {
+            if (ring.CurrentState() == SpscBlockRing::State::Idle) {
+                synced = false;
+                std::this_thread::yield();
+                continue;
+            }
+            if (!ring.Pop(block)) {
+                if (ring.CurrentState() ==
+                        SpscBlockRing::State::PostCaptureDrain &&
+                    ring.Size() == 0) {
+                    ring.EndRecording();
+                    synced = false;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            const uint32_t seq = block[0];
+            if (synced && seq != static_cast<uint8_t>(expected)) {
+                orderErrors.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (!BlockMatches(block, seq)) {
+                orderErrors.fetch_add(1, std::memory_order_relaxed);
+            }
+            expected = seq + 1;
+            synced = true;
+            received.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    uint8_t block[kRingBlock];
+    uint32_t seq = 0;
+    for (uint32_t event = 0; event < kEvents; ++event) {
+        while (ring.CurrentState() != SpscBlockRing::State::Idle) {
+            std::this_thread::yield();
+        }
+        for (uint32_t i = 0; i < 5; ++i) {
+            FillBlock(block, seq++);
+            ring.PushOverwrite(block);
+        }
+        ring.BeginRecording();
+        while (ring.PostRollProduced() < kPostRoll) {
+            FillBlock(block, seq);
+            if (ring.PushPreserve(block)) {
+                ++seq;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        ring.MarkPostRollDone();
+    }
+    while (ring.CurrentState() != SpscBlockRing::State::Idle) {
+        std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, orderErrors.load());
+    TEST_ASSERT_TRUE(received.load() >= kEvents * kPostRoll);
+}
+
+namespace {
+
+void PushSequence(SpscEventRing& ring, uint32_t from, uint32_t to) {
+    uint8_t block[kRingBlock];
+    for (uint32_t seq = from; seq < to; ++seq) {
+        FillBlock(block, seq);
+        ring.Push(block);
+    }
+}
+
+// Reads the whole open event, checking it holds `first` onwards in order.
+bool ReadEvent(SpscEventRing& ring, uint32_t first, uint32_t blocks) {
+    RingEvent event;
+    if (!ring.BeginEvent(event)) {
+        return false;
+    }
+    uint8_t block[kRingBlock];
+    for (uint32_t i = 0; i < blocks; ++i) {
+        if (!ring.Pop(block) || !BlockMatches(block, first + i)) {
+            return false;
+        }
+    }
+    if (!ring.EventDone()) {
+        return false;
+    }
+    ring.FinishEvent();
+    return true;
+}
+
+}
+
+void test_event_ring_idle_keeps_preroll_window() {
+    uint8_t storage[8 * kRingBlock];
+    SpscEventRing ring(storage, kRingBlock, 8, 3);
+    RingEvent event;
+
+    PushSequence(ring, 0, 10);
+    TEST_ASSERT_EQUAL_UINT32(3, ring.Size());
+    TEST_ASSERT_FALSE(ring.BeginEvent(event));
+
+    uint32_t preRoll = 0;
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    TEST_ASSERT_EQUAL_UINT32(3, preRoll);
+    TEST_ASSERT_TRUE(ring.Capturing());
+    PushSequence(ring, 10, 12);
+    TEST_ASSERT_EQUAL_UINT32(5, ring.CapturedBlocks());
+    ring.CloseEvent();
+    TEST_ASSERT_FALSE(ring.Capturing());
+
+    TEST_ASSERT_TRUE(ReadEvent(ring, 7, 5));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.QueuedEvents());
+    PushSequence(ring, 12, 20);
+    TEST_ASSERT_EQUAL_UINT32(3, ring.Size());
+}
+
+void test_event_ring_streams_open_event_longer_than_ring() {
+    uint8_t storage[4 * kRingBlock];
+    SpscEventRing ring(storage, kRingBlock, 4, 2);
+    RingEvent event;
+    uint8_t block[kRingBlock];
+    uint32_t preRoll = 0;
+
+    PushSequence(ring, 0, 5);
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    TEST_ASSERT_TRUE(ring.BeginEvent(event));
+    TEST_ASSERT_EQUAL_UINT32(2, event.preRoll);
+
+    uint32_t expected = 3;
+    for (uint32_t seq = 5; seq < 30; ++seq) {
+        FillBlock(block, seq);
+        TEST_ASSERT_TRUE(ring.Push(block));
+        while (ring.Pop(block)) {
+            TEST_ASSERT_TRUE(BlockMatches(block, expected++));
+        }
+        TEST_ASSERT_FALSE(ring.EventDone());
+    }
+    ring.CloseEvent();
+    TEST_ASSERT_TRUE(ring.EventDone());
+    TEST_ASSERT_EQUAL_UINT32(27, ring.EventRead());
+    TEST_ASSERT_NULL(ring.PeekFront());
+    ring.FinishEvent();
+}
+
+void test_event_ring_queues_event_during_upload() {
+    uint8_t storage[24 * kRingBlock];
+    SpscEventRing ring(storage, kRingBlock, 24, 4);
+    uint32_t preRoll = 0;
+
+    PushSequence(ring, 0, 10);
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    PushSequence(ring, 10, 12);
+    TEST_ASSERT_FALSE(ring.QueueEvent(preRoll));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.DroppedEvents());
+    PushSequence(ring, 12, 13);
+    ring.CloseEvent();
+    PushSequence(ring, 13, 21);
+
+    // Nothing read yet: the second event still gets its full pre-roll.
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    TEST_ASSERT_EQUAL_UINT32(4, preRoll);
+    TEST_ASSERT_EQUAL_UINT32(2, ring.QueuedEvents());
+    PushSequence(ring, 21, 24);
+    ring.CloseEvent();
+
+    TEST_ASSERT_TRUE(ReadEvent(ring, 6, 7));
+    TEST_ASSERT_TRUE(ReadEvent(ring, 17, 7));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.QueuedEvents());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.DroppedBlocks());
+}
+
+void test_event_ring_preroll_stops_at_previous_event() {
+    uint8_t storage[16 * kRingBlock];
+    SpscEventRing ring(storage, kRingBlock, 16, 4);
+    uint32_t preRoll = 0;
+
+    PushSequence(ring, 0, 6);
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    PushSequence(ring, 6, 9);
+    ring.CloseEvent();
+    PushSequence(ring, 9, 11);
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    TEST_ASSERT_EQUAL_UINT32(2, preRoll);
+    PushSequence(ring, 11, 14);
+    ring.CloseEvent();
+
+    TEST_ASSERT_TRUE(ReadEvent(ring, 2, 7));
+    TEST_ASSERT_TRUE(ReadEvent(ring, 9, 5));
+}
+
+void test_event_ring_counts_drops_under_memory_pressure() {
+    uint8_t storage[10 * kRingBlock];
+    SpscEventRing ring(storage, kRingBlock, 10, 1);
+    uint32_t preRoll = 0;
+
+    for (uint32_t i = 0; i < SpscEventRing::kMaxEvents; ++i) {
+        PushSequence(ring, 2 * i, 2 * i + 1);
+        TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+        TEST_ASSERT_EQUAL_UINT32(1, preRoll);
+        PushSequence(ring, 2 * i + 1, 2 * i + 2);
+        ring.CloseEvent();
+    }
+    PushSequence(ring, 8, 9);
+    TEST_ASSERT_FALSE(ring.QueueEvent(preRoll));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.DroppedEvents());
+
+    // Queued data is never overwritten; new blocks are dropped instead.
+    PushSequence(ring, 9, 12);
+    TEST_ASSERT_EQUAL_UINT32(10, ring.Size());
+    TEST_ASSERT_EQUAL_UINT32(2, ring.DroppedBlocks());
+    TEST_ASSERT_TRUE(ReadEvent(ring, 0, 2));
+    TEST_ASSERT_TRUE(ReadEvent(ring, 2, 2));
+}
+
+void test_event_ring_event_ends_at_maximum_while_ring_full() {
+    uint8_t storage[6 * kRingBlock];
+    SpscEventRing ring(storage, kRingBlock, 6, 2);
+    ExtentConfig config;
+    config.releaseBlocks = 100;
+    config.maxBlocks = 10;
+    EventExtent extent(config);
+    uint32_t preRoll = 0;
+
+    PushSequence(ring, 0, 4);
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    extent.Start(preRoll);
+
+    // As the recorder does it: the extent counts every captured block,
+    // stored in the ring or not, so nothing read still ends the event.
+    uint8_t block[kRingBlock];
+    uint32_t seq = 4;
+    for (;; ++seq) {
+        FillBlock(block, seq);
+        ring.Push(block);
+        if (extent.Update(true)) {
+            ring.CloseEvent();
+            break;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(11, seq);
+    TEST_ASSERT_FALSE(ring.Capturing());
+    TEST_ASSERT_EQUAL_UINT32(6, ring.CapturedBlocks());
+    TEST_ASSERT_EQUAL_UINT32(4, ring.DroppedBlocks());
+
+    TEST_ASSERT_TRUE(ReadEvent(ring, 2, 6));
+    PushSequence(ring, 12, 14);
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    TEST_ASSERT_EQUAL_UINT32(2, preRoll);
+}
+
+void test_event_ring_pins_read_blocks_until_rewound() {
+    uint8_t storage[16 * kRingBlock];
+    SpscEventRing ring(storage, kRingBlock, 16, 4);
+    uint32_t preRoll = 0;
+    RingEvent event;
+    uint8_t block[kRingBlock];
+
+    PushSequence(ring, 0, 4);
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    TEST_ASSERT_TRUE(ring.BeginEvent(event));
+    ring.PinEvent();
+    for (uint32_t seq = 0; seq < 4; ++seq) {
+        TEST_ASSERT_TRUE(ring.Pop(block));
+    }
+    TEST_ASSERT_EQUAL_UINT32(4, ring.Pinned());
+
+    // Pinned blocks never hold more than the pre-roll window.
+    PushSequence(ring, 4, 6);
+    TEST_ASSERT_TRUE(ring.Pop(block));
+    TEST_ASSERT_EQUAL_UINT32(3, ring.Pinned());
+    TEST_ASSERT_TRUE(ring.Pop(block));
+    TEST_ASSERT_EQUAL_UINT32(4, ring.Pinned());
+    ring.CloseEvent();
+    TEST_ASSERT_TRUE(ring.EventDone());
+
+    TEST_ASSERT_EQUAL_UINT32(2, ring.RewindPinned());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.Pinned());
+    TEST_ASSERT_TRUE(ReadEvent(ring, 2, 4));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.Size());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.DroppedBlocks());
+
+    // Finishing a pinned event frees what it pinned.
+    PushSequence(ring, 6, 8);
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    PushSequence(ring, 8, 10);
+    ring.CloseEvent();
+    TEST_ASSERT_TRUE(ring.BeginEvent(event));
+    ring.PinEvent();
+    while (ring.Pop(block)) {
+    }
+    TEST_ASSERT_EQUAL_UINT32(4, ring.Pinned());
+    ring.FinishEvent();
+    TEST_ASSERT_EQUAL_UINT32(0, ring.Size());
+}
+
+void test_event_ring_abandoned_event_frees_memory() {
+    uint8_t storage[8 * kRingBlock];
+    SpscEventRing ring(storage, kRingBlock, 8, 2);
+    RingEvent event;
+    uint32_t preRoll = 0;
+
+    PushSequence(ring, 0, 4);
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    TEST_ASSERT_TRUE(ring.BeginEvent(event));
+    ring.FinishEvent();
+    TEST_ASSERT_TRUE(ring.EventDone());
+
+    PushSequence(ring, 4, 20);
+    ring.CloseEvent();
+    TEST_ASSERT_EQUAL_UINT32(2, ring.Size());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.DroppedBlocks());
+    TEST_ASSERT_TRUE(ring.QueueEvent(preRoll));
+    PushSequence(ring, 20, 24);
+    ring.CloseEvent();
+    TEST_ASSERT_TRUE(ReadEvent(ring, 18, 6));
+}
+
+void test_event_ring_spsc_stress_back_to_back() {
+    constexpr uint32_t kCapacity = 11;
+    constexpr uint32_t kEvents = 300;
+
+    std::vector<uint8_t> storage(kCapacity * kRingBlock);
+    SpscEventRing ring(storage.data(), kRingBlock, kCapacity, 3);
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> errors{0};
+    std::vector<uint32_t> sentLengths;
+    std::vector<uint32_t> readLengths;
+
+    std::thread consumer([&] {
+        uint8_t block[kRingBlock];
+        uint8_t last = 0;
+        bool any = false;
+        for (;;) {
+            const bool finished = done.load(std::memory_order_acquire);
+            RingEvent event;
+            if (!ring.BeginEvent(event)) {
+                if (finished) {
+                    break;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t i = 0;
+            while (!ring.EventDone()) {
+                if (!ring.Pop(block)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                const uint8_t seq = block[0];
+                bool ok = BlockMatches(block, seq);
+                if (i > 0) {
+                    ok = ok && seq == static_cast<uint8_t>(last + 1);
+                } else if (any) {
+                    // Events start after the previous one ended.
+                    ok = ok && static_cast<uint8_t>(seq - last - 1) < 127;
+                }
+                if (!ok) {
+                    errors.fetch_add(1, std::memory_order_relaxed);
+                }
+                last = seq;
+                any = true;
+                ++i;
+            }
+            ring.FinishEvent();
+            readLengths.push_back(i);
+        }
+    });
+
+    uint8_t block[kRingBlock];
+    uint32_t seq = 0;
+    uint32_t postRoll = 0;
+    while (sentLengths.size() < kEvents || ring.Capturing()) {
+        FillBlock(block, seq);
+        if (!ring.Push(block)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ++seq;
+        if (ring.Capturing()) {
+            if (--postRoll == 0) {
+                sentLengths.push_back(ring.CapturedBlocks());
+                ring.CloseEvent();
+            }
+            continue;
+        }
+        uint32_t preRoll = 0;
+        if (seq % 4 == 0 && sentLengths.size() < kEvents &&
+            ring.QueueEvent(preRoll)) {
+            postRoll = 1 + seq % 23;
+        }
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, errors.load());
+    TEST_ASSERT_EQUAL_size_t(kEvents, readLengths.size());
+    TEST_ASSERT_TRUE(readLengths == sentLengths);
+}
+
+void test_chunk_queue_counts_depth_and_overruns() {
+    int32_t storage[3 * 4];
+    SpscChunkQueue<int32_t> queue(storage, 4, 3);
+
+    for (int32_t round = 0; round < 5; ++round) {
+        for (int32_t c = 0; c < 3; ++c) {
+            int32_t* chunk = queue.Acquire();
+            TEST_ASSERT_NOT_NULL(chunk);
+            TEST_ASSERT_EQUAL_PTR(chunk, queue.Acquire());
+            std::fill(chunk, chunk + 4, round * 3 + c);
+            queue.Publish();
+        }
+        TEST_ASSERT_TRUE(queue.Full());
+        TEST_ASSERT_NULL(queue.Acquire());
+        TEST_ASSERT_EQUAL_UINT32(3, queue.Depth());
+        for (int32_t c = 0; c < 3; ++c) {
+            const int32_t* chunk = queue.Front();
+            TEST_ASSERT_NOT_NULL(chunk);
+            TEST_ASSERT_EQUAL_INT32(round * 3 + c, chunk[0]);
+            TEST_ASSERT_EQUAL_INT32(round * 3 + c, chunk[3]);
+            queue.Release();
+            TEST_ASSERT_FALSE(queue.Full());
+        }
+        TEST_ASSERT_NULL(queue.Front());
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, queue.Depth());
+    TEST_ASSERT_EQUAL_UINT32(3, queue.MaxDepth());
+    TEST_ASSERT_EQUAL_UINT32(5, queue.Overruns());
+    TEST_ASSERT_EQUAL_UINT32(15, queue.Published());
+}
+
+void test_chunk_queue_spsc_stress_drops_whole_chunks() {
+    constexpr uint32_t kItems = 64;
+    constexpr uint32_t kCapacity = 5;
+    constexpr uint32_t kChunks = 100000;
+
+    std::vector<uint32_t> storage(kItems * kCapacity);
+    SpscChunkQueue<uint32_t> queue(storage.data(), kItems, kCapacity);
+    std::atomic<bool> done{false};
+    uint32_t errors = 0;
+    uint32_t received = 0;
+    uint32_t skipped = 0;
+
+    std::thread consumer([&] {
+        uint32_t next = 0;
+        for (;;) {
+            const bool finished = done.load(std::memory_order_acquire);
+            uint32_t* chunk = queue.Front();
+            if (chunk == nullptr) {
+                if (finished) {
+                    break;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            const uint32_t seq = chunk[0];
+            for (uint32_t i = 1; i < kItems; ++i) {
+                errors += chunk[i] != seq + i;
+            }
+            errors += seq < next;
+            skipped += seq - next;
+            next = seq + 1;
+            ++received;
+            queue.Release();
+        }
+    });
+
+    for (uint32_t seq = 0; seq < kChunks; ++seq) {
+        uint32_t* chunk = queue.Acquire();
+        if (chunk == nullptr) {
+            continue;
+        }
+        for (uint32_t i = 0; i < kItems; ++i) {
+            chunk[i] = seq + i;
+        }
+        queue.Publish();
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, errors);
+    TEST_ASSERT_EQUAL_UINT32(queue.Published(), received);
+    // Gaps before the last chunk, plus any chunks dropped after it.
+    TEST_ASSERT_TRUE(skipped <= queue.Overruns());
+    TEST_ASSERT_EQUAL_UINT32(kChunks, received + queue.Overruns());
+    TEST_ASSERT_TRUE(queue.MaxDepth() <= kCapacity);
+}
+
+namespace {
+
+constexpr uint16_t kSpoolBlock = 256;
+
+// NOR flash: erase sets bytes to 0xFF, writes can only clear bits.
+struct FakeFlash {
+    explicit FakeFlash(uint32_t sectors)
+        : bytes(sectors * RecordingSpool<FakeFlash>::kSectorBytes, 0xFF) {}
+
+    bool Read(uint32_t offset, void* dst, uint32_t len) {
+        std::memcpy(dst, bytes.data() + offset, len);
+        return true;
+    }
+
+    bool Write(uint32_t offset, const void* src, uint32_t len) {
+        const uint8_t* in = static_cast<const uint8_t*>(src);
+        for (uint32_t i = 0; i < len; ++i) {
+            bytes[offset + i] &= in[i];
+        }
+        ++writes;
+        return true;
+    }
+
+    bool Erase(uint32_t offset, uint32_t len) {
+        std::memset(bytes.data() + offset, 0xFF, len);
+        ++erases;
+        return true;
+    }
+
+    uint32_t Size() const { return static_cast<uint32_t>(bytes.size()); }
+
+    std::vector<uint8_t> bytes;
+    uint32_t writes = 0;
+    uint32_t erases = 0;
+};
+
+using Spool = RecordingSpool<FakeFlash>;
+
+void SpoolEventOf(Spool& spool, uint32_t preRoll, uint32_t from,
+                  uint32_t blocks) {
+    uint8_t block[kSpoolBlock];
+    spool.BeginEvent(preRoll, 16000);
+    for (uint32_t seq = from; seq < from + blocks; ++seq) {
+        for (uint16_t i = 0; i < kSpoolBlock; ++i) {
+            block[i] = static_cast<uint8_t>(seq * 7 + i);
+        }
+        spool.Append(block);
+    }
+    spool.EndEvent();
+}
+
+bool SpooledEventMatches(Spool& spool, const SpoolEvent& event,
+                         uint32_t from) {
+    uint8_t block[kSpoolBlock];
+    for (uint32_t n = 0; n < event.blocks; ++n) {
+        if (!spool.ReadBlock(event, n, block)) {
+            return false;
+        }
+        for (uint16_t i = 0; i < kSpoolBlock; ++i) {
+            if (block[i] != static_cast<uint8_t>((from + n) * 7 + i)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+void test_spool_round_trips_through_mount() {
+    FakeFlash flash(8);
+    {
+        Spool spool(flash, flash.Size(), kSpoolBlock);
+        TEST_ASSERT_TRUE(spool.Mount());
+        TEST_ASSERT_EQUAL_UINT32(15, spool.BlocksPerSector());
+        SpoolEventOf(spool, 5, 100, 20);
+        // One whole-sector write per 15 blocks, plus the tail.
+        TEST_ASSERT_EQUAL_UINT32(2, flash.writes);
+    }
+
+    Spool spool(flash, flash.Size(), kSpoolBlock);
+    TEST_ASSERT_TRUE(spool.Mount());
+    TEST_ASSERT_EQUAL_UINT32(1, spool.PendingEvents());
+    SpoolEvent event;
+    TEST_ASSERT_TRUE(spool.OldestEvent(event));
+    TEST_ASSERT_EQUAL_UINT32(5, event.preRoll);
+    TEST_ASSERT_EQUAL_UINT32(16000, event.sampleRate);
+    TEST_ASSERT_EQUAL_UINT32(20, event.blocks);
+    TEST_ASSERT_TRUE(SpooledEventMatches(spool, event, 100));
+    uint8_t block[kSpoolBlock];
+    TEST_ASSERT_FALSE(spool.ReadBlock(event, 20, block));
+}
+
+void test_spool_sectors_span_flash_sectors_for_large_blocks() {
+    TEST_ASSERT_EQUAL_UINT32(4096, Spool::SpoolSectorBytes(256));
+    TEST_ASSERT_EQUAL_UINT32(4096, Spool::SpoolSectorBytes(1024));
+    TEST_ASSERT_EQUAL_UINT32(8192, Spool::SpoolSectorBytes(2048));
+
+    constexpr uint16_t kLarge = 2048;
+    FakeFlash flash(8);
+    {
+        Spool spool(flash, flash.Size(), kLarge);
+        TEST_ASSERT_TRUE(spool.Mount());
+        TEST_ASSERT_EQUAL_UINT32(4, spool.SectorCount());
+        TEST_ASSERT_EQUAL_UINT32(3, spool.BlocksPerSector());
+        std::vector<uint8_t> block(kLarge);
+        spool.BeginEvent(2, 8000, 18);
+        for (uint32_t n = 0; n < 7; ++n) {
+            std::fill(block.begin(), block.end(), static_cast<uint8_t>(n));
+            TEST_ASSERT_TRUE(spool.Append(block.data()));
+        }
+        TEST_ASSERT_TRUE(spool.EndEvent());
+        TEST_ASSERT_EQUAL_UINT32(3, flash.writes);
+    }
+
+    Spool spool(flash, flash.Size(), kLarge);
+    TEST_ASSERT_TRUE(spool.Mount());
+    SpoolEvent event;
+    TEST_ASSERT_TRUE(spool.OldestEvent(event));
+    TEST_ASSERT_EQUAL_UINT32(7, event.blocks);
+    TEST_ASSERT_EQUAL_INT(18, event.gainDb);
+    std::vector<uint8_t> block(kLarge);
+    for (uint32_t n = 0; n < 7; ++n) {
+        TEST_ASSERT_TRUE(spool.ReadBlock(event, n, block.data()));
+        TEST_ASSERT_EQUAL_UINT8(n, block[kLarge - 1]);
+    }
+
+    // The same flash read with another block size holds nothing valid.
+    Spool other(flash, flash.Size(), kSpoolBlock);
+    TEST_ASSERT_TRUE(other.Mount());
+    TEST_ASSERT_EQUAL_UINT32(0, other.PendingEvents());
+}
+
+void test_spool_drains_oldest_first() {
+    FakeFlash flash(8);
+    Spool spool(flash, flash.Size(), kSpoolBlock);
+    TEST_ASSERT_TRUE(spool.Mount());
+    SpoolEventOf(spool, 1, 0, 10);
+    SpoolEventOf(spool, 2, 10, 30);
+    SpoolEventOf(spool, 3, 40, 4);
+    TEST_ASSERT_EQUAL_UINT32(3, spool.PendingEvents());
+
+    const uint32_t starts[] = {0, 10, 40};
+    const uint32_t lengths[] = {10, 30, 4};
+    for (int i = 0; i < 3; ++i) {
+        Spool reopened(flash, flash.Size(), kSpoolBlock);
+        TEST_ASSERT_TRUE(reopened.Mount());
+        SpoolEvent event;
+        TEST_ASSERT_TRUE(reopened.OldestEvent(event));
+        TEST_ASSERT_EQUAL_UINT32(i + 1, event.preRoll);
+        TEST_ASSERT_EQUAL_UINT32(lengths[i], event.blocks);
+        TEST_ASSERT_TRUE(SpooledEventMatches(reopened, event, starts[i]));
+        TEST_ASSERT_TRUE(reopened.Remove(event));
+    }
+    Spool reopened(flash, flash.Size(), kSpoolBlock);
+    TEST_ASSERT_TRUE(reopened.Mount());
+    SpoolEvent event;
+    TEST_ASSERT_FALSE(reopened.OldestEvent(event));
+    TEST_ASSERT_EQUAL_UINT32(0, reopened.PendingEvents());
+}
+
+void test_spool_overwrites_oldest_event_when_full() {
+    FakeFlash flash(4);
+    Spool spool(flash, flash.Size(), kSpoolBlock);
+    TEST_ASSERT_TRUE(spool.Mount());
+    for (uint32_t e = 0; e < 6; ++e) {
+        SpoolEventOf(spool, e, e * 100, 20);
+    }
+    // Two sectors per event: only the newest two fit.
+    TEST_ASSERT_EQUAL_UINT32(4, spool.DroppedEvents());
+    TEST_ASSERT_EQUAL_UINT32(2, spool.PendingEvents());
+
+    Spool reopened(flash, flash.Size(), kSpoolBlock);
+    TEST_ASSERT_TRUE(reopened.Mount());
+    SpoolEvent event;
+    TEST_ASSERT_TRUE(reopened.OldestEvent(event));
+    TEST_ASSERT_EQUAL_UINT32(4, event.preRoll);
+    TEST_ASSERT_TRUE(SpooledEventMatches(reopened, event, 400));
+    TEST_ASSERT_TRUE(reopened.Remove(event));
+
+    // New events keep going after the newest one on flash.
+    SpoolEventOf(reopened, 6, 600, 15);
+    TEST_ASSERT_TRUE(reopened.OldestEvent(event));
+    TEST_ASSERT_EQUAL_UINT32(5, event.preRoll);
+    TEST_ASSERT_EQUAL_UINT32(2, reopened.PendingEvents());
+}
+
+void test_spool_ignores_torn_sectors() {
+    FakeFlash flash(4);
+    {
+        Spool spool(flash, flash.Size(), kSpoolBlock);
+        TEST_ASSERT_TRUE(spool.Mount());
+        SpoolEventOf(spool, 1, 0, 15);
+        SpoolEventOf(spool, 2, 15, 15);
+    }
+    // A bit that never got programmed in the second sector.
+    flash.bytes[Spool::kSectorBytes + 3 * kSpoolBlock] &= 0xF0;
+
+    Spool spool(flash, flash.Size(), kSpoolBlock);
+    TEST_ASSERT_TRUE(spool.Mount());
+    TEST_ASSERT_EQUAL_UINT32(1, spool.PendingEvents());
+    SpoolEvent event;
+    TEST_ASSERT_TRUE(spool.OldestEvent(event));
+    TEST_ASSERT_EQUAL_UINT32(1, event.preRoll);
+    TEST_ASSERT_TRUE(SpooledEventMatches(spool, event, 0));
+
+    // The torn sector is erased before it is written again.
+    TEST_ASSERT_TRUE(spool.Remove(event));
+    for (uint32_t e = 0; e < 3; ++e) {
+        SpoolEventOf(spool, 10 + e, 1000 + e * 15, 15);
+    }
+    Spool reopened(flash, flash.Size(), kSpoolBlock);
+    TEST_ASSERT_TRUE(reopened.Mount());
+    TEST_ASSERT_EQUAL_UINT32(3, reopened.PendingEvents());
+    for (uint32_t e = 0; e < 3; ++e) {
+        TEST_ASSERT_TRUE(reopened.OldestEvent(event));
+        TEST_ASSERT_EQUAL_UINT32(10 + e, event.preRoll);
+        TEST_ASSERT_TRUE(SpooledEventMatches(reopened, event, 1000 + e * 15));
+        TEST_ASSERT_TRUE(reopened.Remove(event));
+    }
+}
+
+void test_spool_truncates_event_larger_than_spool() {
+    FakeFlash flash(4);
+    Spool spool(flash, flash.Size(), kSpoolBlock);
+    TEST_ASSERT_TRUE(spool.Mount());
+    SpoolEventOf(spool, 0, 0, 15);
+
+    uint8_t block[kSpoolBlock] = {};
+    TEST_ASSERT_TRUE(spool.BeginEvent(3, 8000));
+    for (uint32_t i = 0; i < 100; ++i) {
+        spool.Append(block);
+    }
+    // The event being written is not offered for upload.
+    SpoolEvent event;
+    TEST_ASSERT_FALSE(spool.OldestEvent(event));
+    spool.EndEvent();
+
+    TEST_ASSERT_EQUAL_UINT32(1, spool.DroppedEvents());
+    TEST_ASSERT_EQUAL_UINT32(40, spool.DroppedBlocks());
+    TEST_ASSERT_TRUE(spool.OldestEvent(event));
+    TEST_ASSERT_EQUAL_UINT32(3, event.preRoll);
+    TEST_ASSERT_EQUAL_UINT32(8000, event.sampleRate);
+    TEST_ASSERT_EQUAL_UINT32(60, event.blocks);
+}
+
+namespace {
+
+using sensorhub::core::HistoryRing;
+using sensorhub::core::HistorySnapshot;
+using sensorhub::core::HistorySplit;
+using sensorhub::core::SplitHistory;
+
+constexpr uint16_t kHistoryBlock = 4;
+
+void PushHistory(HistoryRing& history, uint32_t value) {
+    uint8_t* slot = history.Reserve();
+    TEST_ASSERT_NOT_NULL(slot);
+    std::memcpy(slot, &value, sizeof(value));
+    history.Commit();
+}
+
+uint32_t HistoryValue(const HistoryRing& history, uint32_t i) {
+    uint32_t value = 0;
+    std::memcpy(&value, history.Block(i), sizeof(value));
+    return value;
+}
+
+}
+
+void test_history_ring_freezes_newest_blocks_until_released() {
+    uint8_t storage[5 * kHistoryBlock];
+    HistoryRing history(storage, kHistoryBlock, 5);
+    for (uint32_t v = 0; v < 8; ++v) {
+        PushHistory(history, v);
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, history.Size());
+
+    HistorySplit split;
+    split.dropNewest = 2;
+    split.skipPreRoll = 1;
+    TEST_ASSERT_TRUE(history.Freeze(7, split));
+    TEST_ASSERT_TRUE(history.Frozen());
+    TEST_ASSERT_NULL(history.Reserve());
+    TEST_ASSERT_FALSE(history.Freeze(8, HistorySplit{}));
+
+    HistorySnapshot snapshot;
+    TEST_ASSERT_FALSE(history.Snapshot(6, snapshot));
+    TEST_ASSERT_TRUE(history.Snapshot(7, snapshot));
+    TEST_ASSERT_EQUAL_UINT32(3, snapshot.blocks);
+    TEST_ASSERT_EQUAL_UINT32(1, snapshot.skipPreRoll);
+    for (uint32_t i = 0; i < snapshot.blocks; ++i) {
+        TEST_ASSERT_EQUAL_UINT32(3 + i, HistoryValue(history, i));
+    }
+
+    history.Release(6);
+    TEST_ASSERT_TRUE(history.Frozen());
+    history.Release(7);
+    TEST_ASSERT_FALSE(history.Frozen());
+    TEST_ASSERT_EQUAL_UINT32(0, history.Size());
+    PushHistory(history, 8);
+    TEST_ASSERT_EQUAL_UINT32(1, history.Size());
+}
+
+void test_history_ring_cancels_and_skips_short_history() {
+    uint8_t storage[4 * kHistoryBlock];
+    HistoryRing history(storage, kHistoryBlock, 4);
+    PushHistory(history, 0);
+    PushHistory(history, 1);
+
+    HistorySplit split;
+    split.dropNewest = 2;
+    TEST_ASSERT_FALSE(history.Freeze(3, split));
+    TEST_ASSERT_FALSE(history.Frozen());
+
+    split.dropNewest = 1;
+    TEST_ASSERT_TRUE(history.Freeze(3, split));
+    history.Cancel(2);
+    TEST_ASSERT_TRUE(history.Frozen());
+    history.Cancel(3);
+    TEST_ASSERT_FALSE(history.Frozen());
+    HistorySnapshot snapshot;
+    TEST_ASSERT_FALSE(history.Snapshot(3, snapshot));
+}
+
+void test_history_split_ends_where_preroll_begins() {
+    HistorySplit split;
+    TEST_ASSERT_FALSE(SplitHistory(4, 1, 0, split));
+    TEST_ASSERT_FALSE(SplitHistory(1, 2, 4, split));
+
+    // `added` full-rate blocks so far; history block k holds blocks
+    // [k * group, (k + 1) * group).
+    for (uint32_t group : {2u, 4u}) {
+        for (uint32_t preRoll = 0; preRoll < 12; ++preRoll) {
+            for (uint32_t added = preRoll; added < preRoll + 3 * group;
+                 ++added) {
+                const uint32_t phase = added % group;
+                if (phase > preRoll) {
+                    continue;
+                }
+                TEST_ASSERT_TRUE(SplitHistory(preRoll, phase, group, split));
+                TEST_ASSERT_TRUE(split.skipPreRoll < group);
+                const uint32_t kept = added / group - split.dropNewest;
+                TEST_ASSERT_EQUAL_UINT32(
+                    kept * group,
+                    added - preRoll + split.skipPreRoll);
+            }
+        }
+    }
+}
+
+namespace {
+
+using sensorhub::core::BlockTier;
+using sensorhub::core::CapturePlan;
+using sensorhub::core::CapturePlanner;
+using sensorhub::core::CaptureRequest;
+
+constexpr uint16_t kPlanBlockBytes = 256;
+
+CaptureRequest PlanRequest(uint32_t preRollMs) {
+    CaptureRequest request;
+    request.preRollMs = preRollMs;
+    request.fullRateMs = 2000;
+    request.jitterSlackMs = 2000;
+    return request;
+}
+
+}
+
+void test_capture_planner_splits_budget_between_tiers() {
+    const CapturePlanner planner({32000, 505}, {8000, 505}, kPlanBlockBytes);
+    const CapturePlan plan =
+        planner.Plan(PlanRequest(16000), 512 * kPlanBlockBytes);
+    TEST_ASSERT_FALSE(plan.shortened);
+    TEST_ASSERT_EQUAL_UINT32(254, plan.ringBlocks);
+    TEST_ASSERT_EQUAL_UINT32(127, plan.preRollBlocks);
+    TEST_ASSERT_EQUAL_UINT32(254, plan.historyBlocks);
+    TEST_ASSERT_EQUAL_UINT32(16000, plan.preRollMs);
+    TEST_ASSERT_EQUAL_UINT32(16286, plan.maxPreRollMs);
+}
+
+void test_capture_planner_shrinks_history_then_preroll() {
+    const CapturePlanner planner({32000, 505}, {8000, 505}, kPlanBlockBytes);
+
+    CapturePlan plan = planner.Plan(PlanRequest(16000), 300 * kPlanBlockBytes);
+    TEST_ASSERT_TRUE(plan.shortened);
+    TEST_ASSERT_EQUAL_UINT32(254, plan.ringBlocks);
+    TEST_ASSERT_EQUAL_UINT32(46, plan.historyBlocks);
+    TEST_ASSERT_EQUAL_UINT32(2903, plan.preRollMs);
+    TEST_ASSERT_EQUAL_UINT32(2903, plan.maxPreRollMs);
+
+    // A history no longer than the full-rate pre-roll is left out.
+    plan = planner.Plan(PlanRequest(16000), 280 * kPlanBlockBytes);
+    TEST_ASSERT_EQUAL_UINT32(0, plan.historyBlocks);
+    TEST_ASSERT_EQUAL_UINT32(2004, plan.preRollMs);
+
+    // The slack is kept before the full-rate pre-roll.
+    plan = planner.Plan(PlanRequest(16000), 200 * kPlanBlockBytes);
+    TEST_ASSERT_EQUAL_UINT32(200, plan.ringBlocks);
+    TEST_ASSERT_EQUAL_UINT32(73, plan.preRollBlocks);
+    TEST_ASSERT_EQUAL_UINT32(1152, plan.preRollMs);
+
+    plan = planner.Plan(PlanRequest(16000), 100 * kPlanBlockBytes);
+    TEST_ASSERT_EQUAL_UINT32(100, plan.ringBlocks);
+    TEST_ASSERT_EQUAL_UINT32(0, plan.preRollBlocks);
+    TEST_ASSERT_EQUAL_UINT32(0, plan.preRollMs);
+}
+
+void test_capture_planner_without_history_keeps_preroll_in_ring() {
+    const CapturePlanner planner({8000, 505}, {}, kPlanBlockBytes);
+
+    CapturePlan plan = planner.Plan(PlanRequest(16000), 512 * kPlanBlockBytes);
+    TEST_ASSERT_FALSE(plan.shortened);
+    TEST_ASSERT_EQUAL_UINT32(286, plan.ringBlocks);
+    TEST_ASSERT_EQUAL_UINT32(254, plan.preRollBlocks);
+    TEST_ASSERT_EQUAL_UINT32(0, plan.historyBlocks);
+    TEST_ASSERT_EQUAL_UINT32(16000, plan.preRollMs);
+    TEST_ASSERT_EQUAL_UINT32(30300, plan.maxPreRollMs);
+
+    plan = planner.Plan(PlanRequest(16000), 128 * kPlanBlockBytes);
+    TEST_ASSERT_TRUE(plan.shortened);
+    TEST_ASSERT_EQUAL_UINT32(96, plan.preRollBlocks);
+    TEST_ASSERT_EQUAL_UINT32(6060, plan.preRollMs);
+    TEST_ASSERT_EQUAL_UINT32(6060, plan.maxPreRollMs);
+}
+
+void test_flac_crcs_match_check_values() {
+    const auto* check = reinterpret_cast<const uint8_t*>("123456789");
+    TEST_ASSERT_EQUAL_HEX8(0xF4, FlacCrc8(check, 9));
+    TEST_ASSERT_EQUAL_HEX16(0xFEE8, FlacCrc16(check, 9));
+}
+
+namespace {
+
+constexpr uint32_t kFlacBlock = 505;
+
+uint32_t FlacRoundTrip(const std::vector<int16_t>& pcm) {
+    std::vector<uint8_t> coded(FlacMaxSubframeBytes(kFlacBlock));
+    const uint32_t bytes =
+        EncodeFlacSubframe(pcm.data(), kFlacBlock, coded.data());
+    TEST_ASSERT_TRUE(bytes <= FlacMaxSubframeBytes(kFlacBlock));
+
+    std::vector<int16_t> decoded(kFlacBlock);
+    TEST_ASSERT_TRUE(DecodeFlacSubframe(coded.data(),
+                                        bytes,
+                                        kFlacBlock,
+                                        decoded.data()));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(pcm.data(), decoded.data(), kFlacBlock);
+    return bytes;
+}
+
+}
+
+void test_flac_subframe_round_trips_exactly() {
+    std::vector<int16_t> pcm(kFlacBlock);
+    uint32_t lcg = 7;
+    for (uint32_t i = 0; i < kFlacBlock; ++i) {
+        lcg = lcg * 1664525u + 1013904223u;
+        pcm[i] = static_cast<int16_t>(
+            9000.0 * std::sin(i * 0.05) + static_cast<int16_t>(lcg >> 16) / 64);
+    }
+    TEST_ASSERT_TRUE(FlacRoundTrip(pcm) < kFlacBlock * 2 * 3 / 4);
+
+    std::fill(pcm.begin(), pcm.end(), int16_t{-42});
+    TEST_ASSERT_EQUAL_UINT32(3, FlacRoundTrip(pcm));
+
+    for (uint32_t i = 0; i < kFlacBlock; ++i) {
+        pcm[i] = i % 2 ? INT16_MAX : INT16_MIN;
+    }
+    FlacRoundTrip(pcm);
+}
+
+void test_flac_subframe_falls_back_to_verbatim_for_noise() {
+    std::vector<int16_t> pcm(kFlacBlock);
+    uint32_t lcg = 1;
+    for (auto& s : pcm) {
+        lcg = lcg * 1664525u + 1013904223u;
+        s = static_cast<int16_t>(lcg >> 16);
+    }
+    TEST_ASSERT_EQUAL_UINT32(FlacMaxSubframeBytes(kFlacBlock),
+                             FlacRoundTrip(pcm));
+}
+
+void test_flac_frame_header_numbers_frames_and_checks() {
+    uint8_t header[kFlacMaxFrameHeaderBytes];
+
+    std::size_t n = FlacFrameHeader(5, kFlacBlock, 16000, header);
+    TEST_ASSERT_EQUAL_UINT32(8, n);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, header[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xF8, header[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x75, header[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x05, header[4]);
+    TEST_ASSERT_EQUAL_HEX8(0, FlacCrc8(header, n));
+
+    // 0x1234 takes three UTF-8 style bytes: 1110xxxx 10xxxxxx 10xxxxxx.
+    n = FlacFrameHeader(0x1234, kFlacBlock, 8000, header);
+    TEST_ASSERT_EQUAL_UINT32(10, n);
+    TEST_ASSERT_EQUAL_HEX8(0xE1, header[4]);
+    TEST_ASSERT_EQUAL_HEX8(0x88, header[5]);
+    TEST_ASSERT_EQUAL_HEX8(0xB4, header[6]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, header[7]);
+    TEST_ASSERT_EQUAL_HEX8(0xF8, header[8]);
+    TEST_ASSERT_EQUAL_HEX8(0, FlacCrc8(header, n));
+}
+
+int main(int, char**) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_reading_default_state_accepts_negative_values);
+    RUN_TEST(test_reading_tracks_min_and_max);
+    RUN_TEST(test_reading_reset_collapses_to_current);
+
+    RUN_TEST(test_mapvalue_linear);
+    RUN_TEST(test_mapvalue_zero_range_returns_sentinel);
+
+    RUN_TEST(test_remove_trailing_whitespace_basic);
+    RUN_TEST(test_remove_trailing_whitespace_all_blank);
+    RUN_TEST(test_remove_trailing_whitespace_empty);
+
+    RUN_TEST(test_altitude_at_sea_level_is_zero);
+    RUN_TEST(test_altitude_decreases_with_lower_pressure);
+
+    RUN_TEST(test_rms_of_zeros_is_zero);
+    RUN_TEST(test_rms_of_empty_buffer_is_zero);
+    RUN_TEST(test_rms_of_constant_signal);
+    RUN_TEST(test_rms_of_alternating_signal);
+
+    RUN_TEST(test_loudness_zero_rms_returns_zero);
+    RUN_TEST(test_loudness_below_floor_returns_zero);
+    RUN_TEST(test_loudness_in_range_returns_positive_db);
+
+    RUN_TEST(test_sum_of_squares_is_exact_for_full_scale);
+    RUN_TEST(test_rms_keeps_precision_on_long_buffers);
+    RUN_TEST(test_log2_q16_matches_libm);
+    RUN_TEST(test_fixed_spl_matches_float_path);
+    RUN_TEST(test_fixed_spl_of_silence_is_zero);
+
+    RUN_TEST(test_a_weighting_matches_iec_table_at_32k);
+    RUN_TEST(test_a_weighting_matches_iec_table_at_16k);
+    RUN_TEST(test_c_weighting_matches_iec_table_at_32k);
+    RUN_TEST(test_a_weighting_fixed_point_gain_matches_design);
+    RUN_TEST(test_weighting_process_in_place_matches_sum_of_squares);
+    RUN_TEST(test_weighting_rejects_dc_and_stays_silent);
+    RUN_TEST(test_i2s_slots_split_into_24_and_16_bits);
+    RUN_TEST(test_weighting_q8_measures_below_one_lsb);
+    RUN_TEST(test_z_weighting_passes_through);
+
+    RUN_TEST(test_spl_from_mean_square_matches_sum_of_squares);
+    RUN_TEST(test_fast_level_is_block_size_independent);
+    RUN_TEST(test_slow_step_response_follows_time_constant);
+    RUN_TEST(test_impulse_rises_fast_and_decays_slowly);
+
+    RUN_TEST(test_level_statistics_percentiles_of_uniform_levels);
+    RUN_TEST(test_level_statistics_leq_is_energy_average);
+    RUN_TEST(test_level_statistics_reset_and_empty);
+
+    RUN_TEST(test_third_octave_band_layout_follows_sample_rate);
+    RUN_TEST(test_third_octave_band_edges_are_half_power);
+    RUN_TEST(test_third_octave_tone_lands_in_its_band);
+    RUN_TEST(test_third_octave_q8_keeps_quiet_bands);
+    RUN_TEST(test_band_energies_merge_and_reset);
+
+    RUN_TEST(test_decimator_response_is_flat_then_stops);
+    RUN_TEST(test_decimator_passes_tone_and_rejects_alias);
+    RUN_TEST(test_decimator_carries_partial_periods_in_place);
+
+    RUN_TEST(test_trigger_needs_consecutive_onset_blocks);
+    RUN_TEST(test_trigger_rearms_below_hysteresis_band);
+    RUN_TEST(test_trigger_cooldown_spaces_events);
+    RUN_TEST(test_trigger_floor_adapts_to_steady_noise);
+    RUN_TEST(test_trigger_floor_speed_does_not_follow_block_size);
+    RUN_TEST(test_trigger_respects_absolute_minimum);
+    RUN_TEST(test_trigger_sustains_within_hysteresis_band);
+    RUN_TEST(test_extent_runs_while_sustained_and_releases);
+    RUN_TEST(test_extent_stops_at_maximum_length);
+    RUN_TEST(test_descriptor_summarises_a_tone_event);
+    RUN_TEST(test_descriptor_counts_onsets_of_bursts);
+    RUN_TEST(test_descriptor_json_stays_under_one_kilobyte);
+
+    RUN_TEST(test_url_accepts_well_formed_https);
+    RUN_TEST(test_url_rejects_http_by_default);
+    RUN_TEST(test_url_rejects_other_schemes);
+    RUN_TEST(test_url_rejects_userinfo);
+    RUN_TEST(test_url_rejects_ip_literal_by_default);
+    RUN_TEST(test_url_accepts_ip_literal_when_allowed);
+    RUN_TEST(test_url_rejects_no_host);
+    RUN_TEST(test_url_rejects_whitespace);
+    RUN_TEST(test_url_rejects_oversized);
+    RUN_TEST(test_url_rejects_bare_localhost);
+
+    RUN_TEST(test_adpcm_round_trip_silence);
+    RUN_TEST(test_adpcm_round_trip_ramp_is_close);
+    RUN_TEST(test_adpcm_block_rejects_wrong_size);
+    RUN_TEST(test_adpcm_batch_kernel_matches_reference);
+    RUN_TEST(test_adpcm_fast_sample_matches_reference_exhaustively);
+    RUN_TEST(test_adpcm_lookahead_lowers_error_for_standard_decoder);
+    RUN_TEST(test_adpcm_lookahead_depth_zero_is_greedy);
+    RUN_TEST(test_dc_blocker_removes_offset_and_passes_audio);
+    RUN_TEST(test_agc_gain_only_moves_on_settle);
+    RUN_TEST(test_conditioning_improves_adpcm_snr_on_mic_fixtures);
+    RUN_TEST(test_adpcm_lane_decoder_matches_reference);
+    RUN_TEST(test_adpcm_parallel_decoder_splits_large_inputs);
+
+    RUN_TEST(test_wav_stream_parser_decodes_across_odd_chunks);
+    RUN_TEST(test_wav_stream_parser_reads_streamed_length_to_end);
+    RUN_TEST(test_wav_stream_parser_decodes_larger_blocks);
+    RUN_TEST(test_adpcm_block_size_must_match_sample_count);
+    RUN_TEST(test_wav_stream_parser_splits_history_from_recording);
+    RUN_TEST(test_wav_stream_parser_stops_after_empty_data_chunk);
+    RUN_TEST(test_wav_stream_parser_finish_rejects_short_fixed_length);
+    RUN_TEST(test_wav_stream_parser_rejects_pcm_format);
+    RUN_TEST(test_wav_stream_parser_rejects_data_before_fmt);
+    RUN_TEST(test_silence_gate_holds_before_leaving_out);
+    RUN_TEST(test_silence_runs_expand_to_standard_wav);
+    RUN_TEST(test_silence_runs_expand_every_wav_in_upload_body);
+    RUN_TEST(test_silence_runs_reject_bad_streams);
+
+    RUN_TEST(test_ring_idle_keeps_newest_preroll_window);
+    RUN_TEST(test_ring_recording_drops_when_full);
+    RUN_TEST(test_ring_state_transitions);
+    RUN_TEST(test_ring_reserve_commit_writes_in_place);
+    RUN_TEST(test_ring_reserve_preserve_counts_drop_when_full);
+    RUN_TEST(test_ring_spsc_stress_preserves_order);
+
+    RUN_TEST(test_event_ring_idle_keeps_preroll_window);
+    RUN_TEST(test_event_ring_streams_open_event_longer_than_ring);
+    RUN_TEST(test_event_ring_queues_event_during_upload);
+    RUN_TEST(test_event_ring_preroll_stops_at_previous_event);
+    RUN_TEST(test_event_ring_counts_drops_under_memory_pressure);
+    RUN_TEST(test_event_ring_event_ends_at_maximum_while_ring_full);
+    RUN_TEST(test_event_ring_pins_read_blocks_until_rewound);
+    RUN_TEST(test_event_ring_abandoned_event_frees_memory);
+    RUN_TEST(test_event_ring_spsc_stress_back_to_back);
+    RUN_TEST(test_chunk_queue_counts_depth_and_overruns);
+    RUN_TEST(test_chunk_queue_spsc_stress_drops_whole_chunks);
+
+    RUN_TEST(test_spool_round_trips_through_mount);
+    RUN_TEST(test_spool_sectors_span_flash_sectors_for_large_blocks);
+    RUN_TEST(test_spool_drains_oldest_first);
+    RUN_TEST(test_spool_overwrites_oldest_event_when_full);
+    RUN_TEST(test_spool_ignores_torn_sectors);
+    RUN_TEST(test_spool_truncates_event_larger_than_spool);
+
+    RUN_TEST(test_history_ring_freezes_newest_blocks_until_released);
+    RUN_TEST(test_history_ring_cancels_and_skips_short_history);
+    RUN_TEST(test_history_split_ends_where_preroll_begins);
+
+    RUN_TEST(test_capture_planner_splits_budget_between_tiers);
+    RUN_TEST(test_capture_planner_shrinks_history_then_preroll);
+    RUN_TEST(test_capture_planner_without_history_keeps_preroll_in_ring);
+
+    RUN_TEST(test_flac_crcs_match_check_values);
+    RUN_TEST(test_flac_subframe_round_trips_exactly);
+    RUN_TEST(test_flac_subframe_falls_back_to_verbatim_for_noise);
+    RUN_TEST(test_flac_frame_header_numbers_frames_and_checks);
 
     return UNITY_END();
 }